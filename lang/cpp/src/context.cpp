@@ -521,6 +521,20 @@ Key Context::nextKey(GpgME::Error &e)
     return Key(key, false);
 }
 
+std::vector<Key> Context::nextKeys(GpgME::Error &e, unsigned int maxKeys)
+{
+    d->lastop = Private::KeyList;
+    std::vector<gpgme_key_t> keys(maxKeys ? maxKeys : 1, nullptr);
+    size_t count = 0;
+    e = Error(d->lasterr = gpgme_op_keylist_next_n(d->ctx, keys.data(), keys.size(), &count));
+    std::vector<Key> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.push_back(Key(keys[i], false));
+    }
+    return result;
+}
+
 KeyListResult Context::endKeyListing()
 {
     d->lasterr = gpgme_op_keylist_end(d->ctx);
@@ -540,6 +554,38 @@ Key Context::key(const char *fingerprint, GpgME::Error &e , bool secret /*, bool
     return Key(key, false);
 }
 
+std::vector<Key> Context::keys(const std::vector<std::string> &fingerprints,
+                               std::vector<Error> &errors, Error &e)
+{
+    d->lastop = Private::KeyList;
+    const size_t count = fingerprints.size();
+    errors.clear();
+    if (!count) {
+        // gpgme_get_keys does not accept empty result arrays.
+        e = Error(d->lasterr = 0);
+        return std::vector<Key>();
+    }
+    std::vector<const char *> fprs;
+    fprs.reserve(count + 1);
+    for (const auto &fpr : fingerprints) {
+        fprs.push_back(fpr.c_str());
+    }
+    fprs.push_back(nullptr);
+
+    std::vector<gpgme_key_t> keys(count, nullptr);
+    std::vector<gpgme_error_t> errs(count, 0);
+    e = Error(d->lasterr = gpgme_get_keys(d->ctx, fprs.data(), keys.data(), errs.data()));
+
+    std::vector<Key> result;
+    result.reserve(count);
+    errors.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.push_back(Key(keys[i], false));
+        errors.push_back(Error(errs[i]));
+    }
+    return result;
+}
+
 KeyGenerationResult Context::generateKey(const char *parameters, Data &pubKey)
 {
     d->lastop = Private::KeyGen;
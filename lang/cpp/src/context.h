@@ -166,11 +166,27 @@ public:
 
     Key nextKey(GpgME::Error &e);
 
+    /** Return up to \a maxKeys keys of the running key listing.  All
+     * keys which are already available are returned at once; the call
+     * blocks only if there is none.  At the end of the listing an empty
+     * vector is returned and \a e is set to GPG_ERR_EOF.
+     */
+    std::vector<Key> nextKeys(GpgME::Error &e, unsigned int maxKeys = 64);
+
     KeyListResult endKeyListing();
     KeyListResult keyListResult() const;
 
     Key key(const char *fingerprint, GpgME::Error &e, bool secret = false);
 
+    /** Look up the keys with the given fingerprints or key IDs using a
+     * single keylist operation.  The result and \a errors have one
+     * element per fingerprint; keys which were not found are null and
+     * the reason is given by the error with the same index.  \a e is
+     * only set if the lookup failed as a whole.
+     */
+    std::vector<Key> keys(const std::vector<std::string> &fingerprints,
+                          std::vector<GpgME::Error> &errors, GpgME::Error &e);
+
     //
     // Key Generation
     //
@@ -90,6 +90,13 @@ GpgME::Data::Data(const char *filename, off_t offset, size_t length)
     d.reset(new Private(e ? nullptr : data));
 }
 
+GpgME::Data::Data(const char *filename, MapFileTag)
+{
+    gpgme_data_t data;
+    const gpgme_error_t e = gpgme_data_new_from_mmap(&data, filename);
+    d.reset(new Private(e ? nullptr : data));
+}
+
 GpgME::Data::Data(FILE *fp)
 {
     gpgme_data_t data;
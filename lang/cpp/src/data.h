@@ -52,6 +52,9 @@ public:
     explicit Data(const char *filename);
     Data(const char *filename, off_t offset, size_t length);
     Data(std::FILE *fp, off_t offset, size_t length);
+    // Read-Only Memory-Mapped File:
+    enum MapFileTag { MapFile };
+    Data(const char *filename, MapFileTag);
     // File-Based Data Buffers:
     explicit Data(std::FILE *fp);
     explicit Data(int fd);
@@ -101,8 +101,8 @@ std::vector<UserID> Key::userIDs() const
 
     std::vector<UserID> v;
     v.reserve(numUserIDs());
-    for (gpgme_user_id_t uid = key->uids ; uid ; uid = uid->next) {
-        v.push_back(UserID(key, uid));
+    for (const UserID &uid : userIDRange()) {
+        v.push_back(uid);
     }
     return v;
 }
@@ -115,12 +115,22 @@ std::vector<Subkey> Key::subkeys() const
 
     std::vector<Subkey> v;
     v.reserve(numSubkeys());
-    for (gpgme_sub_key_t subkey = key->subkeys ; subkey ; subkey = subkey->next) {
-        v.push_back(Subkey(key, subkey));
+    for (const Subkey &subkey : subkeyRange()) {
+        v.push_back(subkey);
     }
     return v;
 }
 
+KeyItemRange<UserID> Key::userIDRange() const
+{
+    return KeyItemRange<UserID>(UserID(key, 0U));
+}
+
+KeyItemRange<Subkey> Key::subkeyRange() const
+{
+    return KeyItemRange<Subkey>(Subkey(key, 0U));
+}
+
 Key::OwnerTrust Key::ownerTrust() const
 {
     if (!key) {
@@ -449,6 +459,13 @@ Subkey::Subkey(const shared_gpgme_key_t &k, gpgme_sub_key_t sk)
 
 }
 
+void Subkey::advance()
+{
+    if (subkey) {
+        subkey = subkey->next;
+    }
+}
+
 Key Subkey::parent() const
 {
     return Key(key);
@@ -628,6 +645,13 @@ UserID::UserID(const shared_gpgme_key_t &k, unsigned int idx)
 
 }
 
+void UserID::advance()
+{
+    if (uid) {
+        uid = uid->next;
+    }
+}
+
 Key UserID::parent() const
 {
     return Key(key);
@@ -658,12 +682,17 @@ std::vector<UserID::Signature> UserID::signatures() const
 
     std::vector<Signature> v;
     v.reserve(numSignatures());
-    for (gpgme_key_sig_t sig = uid->signatures ; sig ; sig = sig->next) {
-        v.push_back(Signature(key, uid, sig));
+    for (const Signature &sig : signatureRange()) {
+        v.push_back(sig);
     }
     return v;
 }
 
+KeyItemRange<UserID::Signature> UserID::signatureRange() const
+{
+    return KeyItemRange<Signature>(Signature(key, uid, 0U));
+}
+
 const char *UserID::id() const
 {
     return uid ? uid->uid : nullptr ;
@@ -853,6 +882,13 @@ UserID::Signature::Signature(const shared_gpgme_key_t &k, gpgme_user_id_t u, gpg
 
 }
 
+void UserID::Signature::advance()
+{
+    if (sig) {
+        sig = sig->next;
+    }
+}
+
 UserID UserID::Signature::parent() const
 {
     return UserID(key, uid);
@@ -34,6 +34,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <iterator>
 #include <string>
 
 namespace GpgME
@@ -45,6 +46,8 @@ class Subkey;
 class UserID;
 class TofuInfo;
 
+template <typename T> class KeyItemRange;
+
 typedef std::shared_ptr< std::remove_pointer<gpgme_key_t>::type > shared_gpgme_key_t;
 
 //
@@ -93,6 +96,11 @@ public:
     std::vector<UserID> userIDs() const;
     std::vector<Subkey> subkeys() const;
 
+    /*! Lazy views of the user IDs and subkeys.  Unlike userIDs() and
+     *  subkeys() they do not copy anything; see KeyItemRange. */
+    KeyItemRange<UserID> userIDRange() const;
+    KeyItemRange<Subkey> subkeyRange() const;
+
     bool isRevoked() const;
     bool isExpired() const;
     bool isDisabled() const;
@@ -318,6 +326,13 @@ public:
     const char *keyGrip() const;
 
 private:
+    template <typename T> friend class KeyItemRange;
+    void advance();
+    const void *listNode() const
+    {
+        return subkey;
+    }
+
     shared_gpgme_key_t key;
     gpgme_sub_key_t subkey;
 };
@@ -358,6 +373,8 @@ public:
     unsigned int numSignatures() const;
     Signature signature(unsigned int index) const;
     std::vector<Signature> signatures() const;
+    /*! Lazy view of the signatures; see KeyItemRange. */
+    KeyItemRange<Signature> signatureRange() const;
 
     const char *id() const;
     const char *name() const;
@@ -436,6 +453,13 @@ public:
                                       Error &error) const;
 
 private:
+    template <typename T> friend class KeyItemRange;
+    void advance();
+    const void *listNode() const
+    {
+        return uid;
+    }
+
     shared_gpgme_key_t key;
     gpgme_user_id_t uid;
 };
@@ -510,11 +534,111 @@ public:
     std::vector<GpgME::Notation> notations() const;
 
 private:
+    template <typename T> friend class KeyItemRange;
+    void advance();
+    const void *listNode() const
+    {
+        return sig;
+    }
+
     shared_gpgme_key_t key;
     gpgme_user_id_t uid;
     gpgme_key_sig_t sig;
 };
 
+//
+// class KeyItemRange
+//
+
+/*! A lazy view of the user IDs or subkeys of a key or of the
+ *  signatures of a user ID.
+ *
+ *  The iterators walk the lists of the underlying gpgme key and
+ *  reuse a single element.  Iterating thus neither allocates nor
+ *  changes the reference count of the key for each element, which
+ *  makes a difference when filtering many keys.  The element
+ *  returned by an iterator is only valid until the iterator is
+ *  advanced; copy it to keep it.  For this reason the iterators are
+ *  only input iterators.  The range itself keeps a reference to the
+ *  key.
+ *
+ *  \code
+ *  for (const UserID &uid : key.userIDRange()) {
+ *      ...
+ *  }
+ *  \endcode
+ */
+template <typename T>
+class KeyItemRange
+{
+public:
+    class const_iterator
+    {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T *pointer;
+        typedef const T &reference;
+
+        const_iterator() : item() {}
+        explicit const_iterator(const T &first) : item(first) {}
+
+        reference operator*() const
+        {
+            return item;
+        }
+        pointer operator->() const
+        {
+            return &item;
+        }
+
+        const_iterator &operator++()
+        {
+            item.advance();
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator old(*this);
+            item.advance();
+            return old;
+        }
+
+        bool operator==(const const_iterator &other) const
+        {
+            return item.listNode() == other.item.listNode();
+        }
+        bool operator!=(const const_iterator &other) const
+        {
+            return item.listNode() != other.item.listNode();
+        }
+
+    private:
+        T item;
+    };
+    typedef const_iterator iterator;
+
+    KeyItemRange() : first() {}
+    explicit KeyItemRange(const T &first_) : first(first_) {}
+
+    const_iterator begin() const
+    {
+        return const_iterator(first);
+    }
+    const_iterator end() const
+    {
+        return const_iterator();
+    }
+    bool empty() const
+    {
+        return !first.listNode();
+    }
+
+private:
+    T first;
+};
+
 GPGMEPP_EXPORT std::ostream &operator<<(std::ostream &os, const UserID &uid);
 GPGMEPP_EXPORT std::ostream &operator<<(std::ostream &os, const Subkey &subkey);
 GPGMEPP_EXPORT std::ostream &operator<<(std::ostream &os, const Key &key);
@@ -32,8 +32,11 @@ import { decode, atobArray, Utf8ArrayToStr } from './Helpers';
  * A Connection handles the nativeMessaging interaction via a port. As the
  * protocol only allows up to 1MB of message sent from the nativeApp to the
  * browser, the connection will stay open until all parts of a communication
- * are finished. For a new request, a new port will open, to avoid mixing
- * contexts.
+ * are finished. Each request carries an id which gpgme-json copies into
+ * all parts of its answer, so that several requests can be sent over the
+ * same port and their answers may arrive in any order. Older versions of
+ * gpgme-json do not return the id; for them the requests are sent one
+ * after the other.
  * @class
  * @private
  */
@@ -41,24 +44,35 @@ export class Connection{
 
     constructor (){
         this._connectionError = null;
+        this._lastId = 0;
+        this._requests = new Map();
+        this._queue = [];
+        this._concurrent = false;
         this._connection = chrome.runtime.connectNative('gpgmejson');
+        this._connection.onMessage.addListener((msg) => {
+            this._dispatch(msg);
+        });
         this._connection.onDisconnect.addListener(() => {
             if (chrome.runtime.lastError) {
                 this._connectionError = chrome.runtime.lastError.message;
             } else {
                 this._connectionError = 'Disconnected without error message';
             }
+            this._connection = null;
+            this._rejectAll(this._disconnectError());
         });
     }
 
     /**
-     * Immediately closes an open port.
+     * Immediately closes an open port. Pending requests are rejected.
      */
     disconnect () {
         if (this._connection){
             this._connection.disconnect();
             this._connection = null;
             this._connectionError = 'Disconnect requested by gpgmejs';
+            this._rejectAll(gpgme_error(
+                'CONN_NO_CONNECT', this._connectionError));
         }
     }
 
@@ -69,6 +83,13 @@ export class Connection{
         return this._connectionError !== null;
     }
 
+    /**
+     * Checks if an error matching browsers 'host not known' messages occurred
+     */
+    get isNativeHostUnknown () {
+        return this._connectionError === 'Specified native messaging host not found.';
+    }
+
     /**
     * @typedef {Object} backEndDetails
     * @property {String} gpgme Version number of gpgme
@@ -137,61 +158,38 @@ export class Connection{
      */
     post (message){
         if (!message || !(message instanceof GPGME_Message)){
-            this.disconnect();
             return Promise.reject(gpgme_error(
                 'PARAM_WRONG', 'Connection.post'));
         }
         if (message.isComplete() !== true){
-            this.disconnect();
             return Promise.reject(gpgme_error('MSG_INCOMPLETE'));
         }
-        let chunksize = message.chunksize;
+        if (!this._connection){
+            return Promise.reject(this._disconnectError());
+        }
         const me = this;
+        const id = ++this._lastId;
         const nativeCommunication = new Promise(function (resolve, reject){
-            let answer = new Answer(message);
-            let listener = function (msg) {
-                if (!msg){
-                    me._connection.onMessage.removeListener(listener);
-                    me._connection.disconnect();
-                    reject(gpgme_error('CONN_EMPTY_GPG_ANSWER'));
-                } else {
-                    let answer_result = answer.collect(msg);
-                    if (answer_result !== true){
-                        me._connection.onMessage.removeListener(listener);
-                        me._connection.disconnect();
-                        reject(answer_result);
-                    } else {
-                        if (msg.more === true){
-                            me._connection.postMessage({
-                                'op': 'getmore',
-                                'chunksize': chunksize
-                            });
-                        } else {
-                            me._connection.onMessage.removeListener(listener);
-                            me._connection.disconnect();
-                            const message = answer.getMessage();
-                            if (message instanceof Error){
-                                reject(message);
-                            } else {
-                                resolve(message);
-                            }
-                        }
-                    }
-                }
+            const request = {
+                id: id,
+                answer: new Answer(message),
+                chunksize: message.chunksize,
+                message: Object.assign({}, message.message, { id: id }),
+                resolve: resolve,
+                reject: reject
             };
-            me._connection.onMessage.addListener(listener);
-            me._connection.postMessage(message.message);
+            me._requests.set(id, request);
+            if (me._concurrent || me._requests.size === 1){
+                me._connection.postMessage(request.message);
+            } else {
+                me._queue.push(request);
+            }
 
             // check for browser messaging errors after a while
             // (browsers' extension permission checks take some time)
             setTimeout( () => {
                 if (me.isDisconnected) {
-                    if ( me.isNativeHostUnknown === true) {
-                        return reject(gpgme_error('CONN_NO_CONFIG'));
-                    } else {
-                        return reject(gpgme_error(
-                            'CONN_NO_CONNECT', me._connectionError));
-                    }
+                    return reject(me._disconnectError());
                 }
             }, 25);
 
@@ -203,13 +201,159 @@ export class Connection{
                 nativeCommunication,
                 new Promise(function (resolve, reject){
                     setTimeout(function (){
-                        me.disconnect();
+                        me._abandon(id);
                         reject(gpgme_error('CONN_TIMEOUT'));
                     }, 5000);
                 })
             ]);
         }
     }
+
+    /**
+     * Handles an incoming message of the port and passes it to the
+     * request it belongs to.
+     * @param {Object} msg
+     * @private
+     */
+    _dispatch (msg){
+        let request;
+        if (!msg){
+            this._rejectAll(gpgme_error('CONN_EMPTY_GPG_ANSWER'));
+            this.disconnect();
+            return;
+        }
+        if (msg.hasOwnProperty('id')){
+            if (!this._concurrent){
+                this._concurrent = true;
+                this._sendQueued();
+            }
+            request = this._requests.get(msg.id);
+        } else if (!this._concurrent){
+            // Without ids the answers arrive in the order of the requests.
+            request = this._requests.values().next().value;
+        }
+        if (!request){
+            // Answer to an abandoned request.
+            return;
+        }
+        const answer_result = request.answer.collect(msg);
+        if (answer_result !== true){
+            this._finish(request);
+            request.reject(answer_result);
+        } else if (msg.more === true){
+            this._connection.postMessage({
+                'op': 'getmore',
+                'chunksize': request.chunksize,
+                'id': request.id
+            });
+        } else {
+            this._finish(request);
+            const message = request.answer.getMessage();
+            if (message instanceof Error){
+                request.reject(message);
+            } else {
+                request.resolve(message);
+            }
+        }
+    }
+
+    /**
+     * Removes a completed request and sends the next one if the answers
+     * can't be matched to the requests.
+     * @param {Object} request
+     * @private
+     */
+    _finish (request){
+        this._requests.delete(request.id);
+        if (!this._concurrent){
+            this._sendQueued();
+        }
+    }
+
+    /**
+     * Sends the queued requests; without support for ids only the oldest
+     * one is sent.
+     * @private
+     */
+    _sendQueued (){
+        while (this._queue.length && this._connection){
+            const request = this._queue.shift();
+            if (!this._requests.has(request.id)){
+                continue;
+            }
+            this._connection.postMessage(request.message);
+            if (!this._concurrent){
+                break;
+            }
+        }
+    }
+
+    /**
+     * Forgets a request which is not of interest anymore. If the answers
+     * can't be matched to the requests, the connection is closed instead
+     * as the answer would otherwise be taken for the one of the next
+     * request.
+     * @param {Number} id
+     * @private
+     */
+    _abandon (id){
+        const request = this._requests.get(id);
+        if (!request){
+            return;
+        }
+        if (this._concurrent){
+            this._requests.delete(id);
+        } else {
+            this.disconnect();
+        }
+    }
+
+    /**
+     * Rejects all pending requests.
+     * @param {GPGME_Error} error
+     * @private
+     */
+    _rejectAll (error){
+        const requests = Array.from(this._requests.values());
+        this._requests.clear();
+        this._queue = [];
+        for (let i = 0; i < requests.length; i++){
+            requests[i].reject(error);
+        }
+    }
+
+    /**
+     * Returns the error to report for a closed connection.
+     * @returns {GPGME_Error}
+     * @private
+     */
+    _disconnectError (){
+        if (this.isNativeHostUnknown === true) {
+            return gpgme_error('CONN_NO_CONFIG');
+        }
+        return gpgme_error('CONN_NO_CONNECT', this._connectionError);
+    }
+}
+
+
+/**
+ * The connection used by {@link GPGME_Message}. It is shared by all
+ * messages and replaced by a new one after it has been closed.
+ * @type {Connection}
+ * @private
+ */
+let sharedConnection = null;
+
+/**
+ * Returns the shared connection, opening a new port if required.
+ * @returns {Connection}
+ * @private
+ */
+export function getSharedConnection (){
+    if (!sharedConnection || sharedConnection.isDisconnected){
+        sharedConnection = new Connection;
+    }
+    return sharedConnection;
 }
 
 
@@ -237,13 +381,6 @@ class Answer{
         return this._expected;
     }
 
-    /**
-     * Checks if an error matching browsers 'host not known' messages occurred
-     */
-    get isNativeHostUnknown () {
-        return this._connectionError === 'Specified native messaging host not found.';
-    }
-
     /**
      * Adds incoming base64 encoded data to the existing response
      * @param {*} msg base64 encoded data.
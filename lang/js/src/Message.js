@@ -23,7 +23,7 @@
 
 import { permittedOperations } from './permittedOperations';
 import { gpgme_error } from './Errors';
-import { Connection } from './Connection';
+import { getSharedConnection } from './Connection';
 
 /**
  * Initializes a message for gnupg, validating the message's purpose with
@@ -227,8 +227,7 @@ export class GPGME_Message {
         return new Promise(function (resolve, reject) {
             if (me.isComplete() === true) {
 
-                let conn  = new Connection;
-                conn.post(me).then(function (response) {
+                getSharedConnection().post(me).then(function (response) {
                     resolve(response);
                 }, function (reason) {
                     reject(reason);
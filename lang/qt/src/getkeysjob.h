@@ -0,0 +1,100 @@
+/*
+    getkeysjob.h
+
+    This file is part of qgpgme, the Qt API binding for gpgme
+    Copyright (c) 2020 g10 Code GmbH
+
+    QGpgME is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.
+
+    QGpgME is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+#ifndef __QGPGME_GETKEYSJOB_H__
+#define __QGPGME_GETKEYSJOB_H__
+
+#include <QString>
+
+#include "job.h"
+
+#ifdef BUILDING_QGPGME
+# include "key.h"
+#else
+# include <gpgme++/key.h>
+#endif
+
+#include <vector>
+
+class QStringList;
+
+namespace GpgME
+{
+class Error;
+}
+
+namespace QGpgME
+{
+
+/**
+   @short Look up many keys by fingerprint at once
+
+   To use the GetKeysJob, first obtain an instance from the
+   CryptoBackend and either exec it or start and connect the result()
+   signal to a suitable slot.
+
+   All keys are looked up with a single keylist operation.  The
+   result contains one key per requested fingerprint in the same
+   order; keys which were not found are null and the reason is given
+   by the error with the same index.
+
+   After result() is emitted, the GetKeysJob will schedule its own
+   destruction by calling QObject::deleteLater().
+*/
+class QGPGME_EXPORT GetKeysJob: public Job
+{
+    Q_OBJECT
+protected:
+    explicit GetKeysJob(QObject *parent);
+
+public:
+    ~GetKeysJob();
+
+    /**
+      Starts the operation. \a fingerprints are the fingerprints or
+      key IDs of the keys to look up.
+    */
+    virtual GpgME::Error start(const QStringList &fingerprints) = 0;
+
+    virtual GpgME::Error exec(const QStringList &fingerprints, std::vector<GpgME::Key> &keys, std::vector<GpgME::Error> &errors) = 0;
+
+Q_SIGNALS:
+    /** The result. \a error is only set if the lookup failed as a
+     * whole.  \a keys and \a errors have one element per requested
+     * fingerprint.
+     *
+     * The auditlog params are always null / empty.
+     */
+    void result(const GpgME::Error &error, const std::vector<GpgME::Key> &keys, const std::vector<GpgME::Error> &errors, const QString &auditLogAsHtml = QString(), const GpgME::Error &auditLogError = GpgME::Error());
+};
+
+}
+#endif
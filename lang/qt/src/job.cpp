@@ -66,6 +66,7 @@
 #include "threadedjobmixin.h"
 #include "quickjob.h"
 #include "gpgcardjob.h"
+#include "getkeysjob.h"
 
 #include <QCoreApplication>
 #include <QDebug>
@@ -143,6 +144,7 @@ make_job_subclass(WKSPublishJob)
 make_job_subclass(TofuPolicyJob)
 make_job_subclass(QuickJob)
 make_job_subclass(GpgCardJob)
+make_job_subclass(GetKeysJob)
 
 #undef make_job_subclass
 
@@ -176,3 +178,4 @@ make_job_subclass(GpgCardJob)
 #include "tofupolicyjob.moc"
 #include "quickjob.moc"
 #include "gpgcardjob.moc"
+#include "getkeysjob.moc"
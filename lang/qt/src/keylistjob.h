@@ -71,6 +71,10 @@ namespace QGpgME
    nextKey() signal as they arrive. After result() is emitted, the
    KeyListJob will schedule it's own destruction by calling
    QObject::deleteLater().
+
+   By default the keys are collected and only handed out when the
+   listing is complete.  Use setStreaming() to receive them in batches
+   through the nextKeys() signal while the listing is still running.
 */
 class QGPGME_EXPORT KeyListJob : public Job
 {
@@ -100,8 +104,29 @@ public:
     /** Add a flag to the keylistmode used. */
     virtual void addMode(GpgME::KeyListMode mode) = 0;
 
+    /**
+      Switches the job to streaming mode. This must be called before
+      start() or exec().
+
+      In streaming mode the keys are not collected. Instead they are
+      emitted with the nextKeys() signal in batches of at most
+      \a batchSize keys as soon as they have been listed. A smaller
+      batch is emitted at the end of the listing and when the next key
+      arrives more than \a maxDelay milliseconds after the previous
+      batch. nextKey() is still emitted for every key, right after the
+      batch containing it. result() and exec() return no keys.
+
+      The job lists only a few batches ahead of the receiver of
+      nextKeys(), so a slow receiver throttles the listing. Cancelling
+      the job stops the listing after the current batch.
+
+      The default implementation does nothing.
+    */
+    virtual void setStreaming(unsigned int batchSize, int maxDelay = 100);
+
 Q_SIGNALS:
     void nextKey(const GpgME::Key &key);
+    void nextKeys(const std::vector<GpgME::Key> &keys);
     void result(const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &keys = std::vector<GpgME::Key>(), const QString &auditLogAsHtml = QString(), const GpgME::Error &auditLogError = GpgME::Error());
 };
 
@@ -68,6 +68,7 @@ class WKSPublishJob;
 class TofuPolicyJob;
 class QuickJob;
 class GpgCardJob;
+class GetKeysJob;
 
 /** The main entry point for QGpgME Comes in OpenPGP and SMIME(CMS) flavors.
  *
@@ -162,6 +163,9 @@ public:
 
     /** A Job for the quick commands */
     virtual QuickJob *quickJob() const = 0;
+
+    /** Look up many keys by fingerprint with a single keylist. */
+    virtual GetKeysJob *getKeysJob() const = 0;
 };
 
 /** Obtain a reference to the OpenPGP Protocol.
@@ -59,6 +59,7 @@
 #include "qgpgmeadduseridjob.h"
 #include "qgpgmekeyformailboxjob.h"
 #include "qgpgmewkspublishjob.h"
+#include "qgpgmegetkeysjob.h"
 #include "qgpgmetofupolicyjob.h"
 #include "qgpgmequickjob.h"
 
@@ -427,6 +428,15 @@ public:
         }
         return new QGpgME::QGpgMEQuickJob(context);
     }
+
+    QGpgME::GetKeysJob *getKeysJob() const Q_DECL_OVERRIDE
+    {
+        GpgME::Context *context = GpgME::Context::createForProtocol(mProtocol);
+        if (!context) {
+            return nullptr;
+        }
+        return new QGpgME::QGpgMEGetKeysJob(context);
+    }
 };
 
 }
@@ -0,0 +1,86 @@
+/*
+    qgpgmegetkeysjob.cpp
+
+    This file is part of qgpgme, the Qt API binding for gpgme
+    Copyright (c) 2020 g10 Code GmbH
+
+    QGpgME is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.
+
+    QGpgME is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+#ifdef HAVE_CONFIG_H
+ #include "config.h"
+#endif
+
+#include "qgpgmegetkeysjob.h"
+
+#include "context.h"
+
+#include <QStringList>
+
+#include <string>
+#include <tuple>
+
+using namespace GpgME;
+using namespace QGpgME;
+
+QGpgMEGetKeysJob::QGpgMEGetKeysJob(Context *context)
+    : mixin_type(context)
+{
+    lateInitialization();
+}
+
+QGpgMEGetKeysJob::~QGpgMEGetKeysJob() {}
+
+static QGpgMEGetKeysJob::result_type do_work(Context *ctx, const QStringList &fingerprints)
+{
+    std::vector<std::string> fprs;
+    fprs.reserve(fingerprints.size());
+    Q_FOREACH (const QString &fpr, fingerprints) {
+        fprs.push_back(fpr.toStdString());
+    }
+
+    std::vector<Error> errors;
+    Error err;
+    const std::vector<Key> keys = ctx->keys(fprs, errors, err);
+    return std::make_tuple(err, keys, errors, QString(), Error());
+}
+
+Error QGpgMEGetKeysJob::start(const QStringList &fingerprints)
+{
+    run(std::bind(&do_work, std::placeholders::_1, fingerprints));
+    return Error();
+}
+
+Error QGpgMEGetKeysJob::exec(const QStringList &fingerprints, std::vector<Key> &keys, std::vector<Error> &errors)
+{
+    const result_type r = do_work(context(), fingerprints);
+    resultHook(r);
+    keys = std::get<1>(r);
+    errors = std::get<2>(r);
+    return std::get<0>(r);
+}
+
+#include "qgpgmegetkeysjob.moc"
@@ -53,17 +53,17 @@ QGpgMEKeyForMailboxJob::QGpgMEKeyForMailboxJob(Context *context)
 
 QGpgMEKeyForMailboxJob::~QGpgMEKeyForMailboxJob() {}
 
-static bool keyIsOk(const Key k)
+static bool keyIsOk(const Key &k)
 {
     return !k.isExpired() && !k.isRevoked() && !k.isInvalid() && !k.isDisabled();
 }
 
-static bool uidIsOk(const UserID uid)
+static bool uidIsOk(const UserID &uid)
 {
     return keyIsOk(uid.parent()) && !uid.isRevoked() && !uid.isInvalid();
 }
 
-static bool subkeyIsOk(const Subkey s)
+static bool subkeyIsOk(const Subkey &s)
 {
     return !s.isRevoked() && !s.isInvalid() && !s.isDisabled();
 }
@@ -91,7 +91,7 @@ static QGpgMEKeyForMailboxJob::result_type do_work(Context *ctx, const QString &
             continue;
         }
         /* First get the uid that matches the mailbox */
-        Q_FOREACH (const UserID u, k.userIDs()) {
+        for (const UserID &u : k.userIDRange()) {
             if (QString::fromUtf8(u.email()).toLower() == mailbox.toLower()) {
                 if (uidC.isNull()) {
                     keyC = k;
@@ -103,13 +103,13 @@ static QGpgMEKeyForMailboxJob::result_type do_work(Context *ctx, const QString &
                 } else if (uidC.validity() == u.validity() && uidIsOk(u)) {
                     /* Both are the same check which one is newer. */
                     time_t oldTime = 0;
-                    Q_FOREACH (const Subkey s, keyC.subkeys()) {
+                    for (const Subkey &s : keyC.subkeyRange()) {
                         if ((canEncrypt && s.canEncrypt()) && subkeyIsOk(s)) {
                             oldTime = s.creationTime();
                         }
                     }
                     time_t newTime = 0;
-                    Q_FOREACH (const Subkey s, k.subkeys()) {
+                    for (const Subkey &s : k.subkeyRange()) {
                         if ((canEncrypt && s.canEncrypt()) && subkeyIsOk(s)) {
                             newTime = s.creationTime();
                         }
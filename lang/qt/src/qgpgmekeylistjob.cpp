@@ -43,9 +43,12 @@
 #include "keylistresult.h"
 #include <gpg-error.h>
 
+#include <QElapsedTimer>
+#include <QMutexLocker>
 #include <QStringList>
 
 #include <algorithm>
+#include <functional>
 
 #include <cstdlib>
 #include <cstring>
@@ -54,16 +57,36 @@
 using namespace QGpgME;
 using namespace GpgME;
 
+// The number of batches the streaming mode lists ahead of the receiver.
+static const int maxPendingBatches = 4;
+
 QGpgMEKeyListJob::QGpgMEKeyListJob(Context *context)
     : mixin_type(context),
-      mResult(), mSecretOnly(false)
+      mResult(), mSecretOnly(false), mBatchSize(0), mMaxDelay(0),
+      mCanceled(0), mFreeBatches(maxPendingBatches)
 {
     lateInitialization();
 }
 
 QGpgMEKeyListJob::~QGpgMEKeyListJob() {}
 
-static KeyListResult do_list_keys(Context *ctx, const QStringList &pats, std::vector<Key> &keys, bool secretOnly)
+namespace
+{
+// Takes a batch of keys in streaming mode.  Returns false to stop the
+// listing.
+typedef std::function<bool(std::vector<Key> &)> KeySink;
+
+struct StreamParams {
+    unsigned int batchSize;
+    int maxDelay;
+    KeySink sink;
+    // Returns true if the job has been canceled.
+    std::function<bool()> canceled;
+};
+}
+
+static KeyListResult do_list_keys(Context *ctx, const QStringList &pats, std::vector<Key> &keys, bool secretOnly,
+                                  const StreamParams &stream)
 {
 
     const _detail::PatternConverter pc(pats);
@@ -73,22 +96,53 @@ static KeyListResult do_list_keys(Context *ctx, const QStringList &pats, std::ve
     }
 
     Error err;
-    do {
-        keys.push_back(ctx->nextKey(err));
-    } while (!err);
+    if (!stream.sink) {
+        do {
+            const std::vector<Key> batch = ctx->nextKeys(err);
+            keys.insert(keys.end(), batch.begin(), batch.end());
+        } while (!err);
+    } else {
+        // Hand the keys over as they are parsed by gpgme instead of
+        // collecting them; KEYS only holds the current batch.
+        QElapsedTimer timer;
+        timer.start();
+        keys.clear();
+        do {
+            const std::vector<Key> batch = ctx->nextKeys(err, stream.batchSize - keys.size());
+            keys.insert(keys.end(), batch.begin(), batch.end());
+            if (!keys.empty()
+                && (err || keys.size() >= stream.batchSize || timer.hasExpired(stream.maxDelay))) {
+                if (!stream.sink(keys)) {
+                    keys.clear();
+                    ctx->endKeyListing();
+                    ctx->cancelPendingOperation();
+                    return KeyListResult(nullptr, Error::fromCode(GPG_ERR_CANCELED));
+                }
+                keys.clear();
+                timer.restart();
+            }
+        } while (!err);
+    }
 
-    keys.pop_back();
+    // Cancelling the job kills the engine, which may look like a
+    // regular end of the listing.
+    if (err.isCanceled() || (stream.canceled && stream.canceled())) {
+        ctx->endKeyListing();
+        ctx->cancelPendingOperation();
+        return KeyListResult(nullptr, Error::fromCode(GPG_ERR_CANCELED));
+    }
 
     const KeyListResult result = ctx->endKeyListing();
     ctx->cancelPendingOperation();
     return result;
 }
 
-static QGpgMEKeyListJob::result_type list_keys(Context *ctx, QStringList pats, bool secretOnly)
+static QGpgMEKeyListJob::result_type list_keys(Context *ctx, QStringList pats, bool secretOnly,
+                                               const StreamParams &stream)
 {
     if (pats.size() < 2) {
         std::vector<Key> keys;
-        const KeyListResult r = do_list_keys(ctx, pats, keys, secretOnly);
+        const KeyListResult r = do_list_keys(ctx, pats, keys, secretOnly, stream);
         return std::make_tuple(r, keys, QString(), Error());
     }
 
@@ -107,7 +161,7 @@ retry:
     keys.reserve(pats.size());
     KeyListResult result;
     do {
-        const KeyListResult this_result = do_list_keys(ctx, pats.mid(0, chunkSize), keys, secretOnly);
+        const KeyListResult this_result = do_list_keys(ctx, pats.mid(0, chunkSize), keys, secretOnly, stream);
         if (this_result.error().code() == GPG_ERR_LINE_TOO_LONG) {
             // got LINE_TOO_LONG, try a smaller chunksize:
             chunkSize /= 2;
@@ -136,19 +190,98 @@ retry:
 Error QGpgMEKeyListJob::start(const QStringList &patterns, bool secretOnly)
 {
     mSecretOnly = secretOnly;
-    run(std::bind(&list_keys, std::placeholders::_1, patterns, secretOnly));
+    StreamParams stream = { mBatchSize, mMaxDelay, KeySink(), std::bind(&QGpgMEKeyListJob::isCanceled, this) };
+    if (mBatchSize) {
+        stream.sink = std::bind(&QGpgMEKeyListJob::queueKeys, this, std::placeholders::_1);
+    }
+    run(std::bind(&list_keys, std::placeholders::_1, patterns, secretOnly, stream));
     return Error();
 }
 
 KeyListResult QGpgMEKeyListJob::exec(const QStringList &patterns, bool secretOnly, std::vector<Key> &keys)
 {
     mSecretOnly = secretOnly;
-    const result_type r = list_keys(context(), patterns, secretOnly);
+    StreamParams stream = { mBatchSize, mMaxDelay, KeySink(), std::bind(&QGpgMEKeyListJob::isCanceled, this) };
+    if (mBatchSize) {
+        stream.sink = std::bind(&QGpgMEKeyListJob::emitKeys, this, std::placeholders::_1);
+    }
+    const result_type r = list_keys(context(), patterns, secretOnly, stream);
     resultHook(r);
     keys = std::get<1>(r);
     return std::get<0>(r);
 }
 
+void QGpgMEKeyListJob::setStreaming(unsigned int batchSize, int maxDelay)
+{
+    mBatchSize = batchSize;
+    mMaxDelay = maxDelay;
+}
+
+void QGpgMEKeyListJob::slotCancel()
+{
+    mCanceled.storeRelease(1);
+    mixin_type::slotCancel();
+}
+
+bool QGpgMEKeyListJob::isCanceled() const
+{
+    return mCanceled.loadAcquire();
+}
+
+// Called in the worker thread: queue a batch for slotDeliverKeys.
+bool QGpgMEKeyListJob::queueKeys(std::vector<Key> &keys)
+{
+    // Wait until the receiver has caught up.
+    while (!mFreeBatches.tryAcquire(1, 100)) {
+        if (isCanceled()) {
+            return false;
+        }
+    }
+    if (isCanceled()) {
+        mFreeBatches.release();
+        return false;
+    }
+    {
+        const QMutexLocker locker(&mPendingMutex);
+        mPendingBatches.push_back(std::move(keys));
+    }
+    QMetaObject::invokeMethod(this, "slotDeliverKeys", Qt::QueuedConnection);
+    return true;
+}
+
+// Called in the thread of the job for each queued batch.
+void QGpgMEKeyListJob::slotDeliverKeys()
+{
+    std::vector<Key> keys;
+    {
+        const QMutexLocker locker(&mPendingMutex);
+        if (mPendingBatches.empty()) {
+            return;
+        }
+        keys = std::move(mPendingBatches.front());
+        mPendingBatches.pop_front();
+    }
+    // Do not hand out batches listed ahead after a cancel.
+    if (!isCanceled()) {
+        emitKeys(keys);
+    }
+    mFreeBatches.release();
+}
+
+bool QGpgMEKeyListJob::emitKeys(std::vector<Key> &keys)
+{
+    Q_EMIT nextKeys(keys);
+    for (const Key &key : keys) {
+        Q_EMIT nextKey(key);
+    }
+    return !isCanceled();
+}
+
+/* For ABI compat not pure virtual. */
+void KeyListJob::setStreaming(unsigned int, int)
+{
+}
+
 void QGpgMEKeyListJob::resultHook(const result_type &tuple)
 {
     mResult = std::get<0>(tuple);
@@ -50,6 +50,12 @@
 #include <gpgme++/key.h>
 #endif
 
+#include <QAtomicInt>
+#include <QMutex>
+#include <QSemaphore>
+
+#include <deque>
+
 namespace QGpgME
 {
 
@@ -77,11 +83,31 @@ public:
 
     void addMode(GpgME::KeyListMode mode) Q_DECL_OVERRIDE;
 
+    /* from KeyListJob */
+    void setStreaming(unsigned int batchSize, int maxDelay) Q_DECL_OVERRIDE;
+
+    /* from Job */
+    void slotCancel() Q_DECL_OVERRIDE;
+
     /* from ThreadedJobMixin */
     void resultHook(const result_type &result) Q_DECL_OVERRIDE;
+
+private Q_SLOTS:
+    void slotDeliverKeys();
+
 private:
+    bool queueKeys(std::vector<GpgME::Key> &keys);
+    bool emitKeys(std::vector<GpgME::Key> &keys);
+    bool isCanceled() const;
+
     GpgME::KeyListResult mResult;
     bool mSecretOnly;
+    unsigned int mBatchSize;
+    int mMaxDelay;
+    QAtomicInt mCanceled;
+    QMutex mPendingMutex;
+    std::deque<std::vector<GpgME::Key> > mPendingBatches;
+    QSemaphore mFreeBatches;
 };
 
 }
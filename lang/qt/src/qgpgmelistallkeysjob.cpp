@@ -76,11 +76,10 @@ static KeyListResult do_list_keys_legacy(Context *ctx, std::vector<Key> &keys, b
 
     Error err;
     do {
-        keys.push_back(ctx->nextKey(err));
+        const std::vector<Key> batch = ctx->nextKeys(err);
+        keys.insert(keys.end(), batch.begin(), batch.end());
     } while (!err);
 
-    keys.pop_back();
-
     const KeyListResult result = ctx->endKeyListing();
     ctx->cancelPendingOperation();
     return result;
@@ -150,11 +149,10 @@ static KeyListResult do_list_keys(Context *ctx, std::vector<Key> &keys)
 
     Error err;
     do {
-        keys.push_back(ctx->nextKey(err));
+        const std::vector<Key> batch = ctx->nextKeys(err);
+        keys.insert(keys.end(), batch.begin(), batch.end());
     } while (!err);
 
-    keys.pop_back();
-
     const KeyListResult result = ctx->endKeyListing();
     ctx->setKeyListMode(keyListMode);
 
@@ -164,7 +162,8 @@ static KeyListResult do_list_keys(Context *ctx, std::vector<Key> &keys)
 
 static QGpgMEListAllKeysJob::result_type list_keys(Context *ctx, bool mergeKeys)
 {
-    if (GpgME::engineInfo(GpgME::GpgEngine).engineVersion() < "2.1.0") {
+    // Only engines older than 2.1 need a second pass for the secret keys.
+    if (GpgME::engineInfo(ctx->protocol()).engineVersion() < "2.1.0") {
         return list_keys_legacy(ctx, mergeKeys);
     }
 
@@ -173,6 +172,7 @@ static QGpgMEListAllKeysJob::result_type list_keys(Context *ctx, bool mergeKeys)
     std::sort(keys.begin(), keys.end(), ByFingerprint<std::less>());
 
     std::vector<Key> sec;
+    sec.reserve(std::count_if(keys.begin(), keys.end(), [](const Key &key) { return key.hasSecret(); }));
     std::copy_if(keys.begin(), keys.end(), std::back_inserter(sec), [](const Key &key) { return key.hasSecret(); });
 
     return std::make_tuple(r, keys, sec, QString(), Error());
@@ -0,0 +1,136 @@
+/* t-getkeys.cpp
+
+    This file is part of qgpgme, the Qt API binding for gpgme
+    Copyright (c) 2020 g10 Code GmbH
+
+    QGpgME is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.
+
+    QGpgME is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+#ifdef HAVE_CONFIG_H
+ #include "config.h"
+#endif
+
+#include <QDebug>
+#include <QTest>
+#include <QSignalSpy>
+#include <QStringList>
+#include "getkeysjob.h"
+#include "protocol.h"
+#include "error.h"
+
+#include "t-support.h"
+
+#include <cstring>
+
+using namespace QGpgME;
+using namespace GpgME;
+
+static const QStringList lookups = QStringList()
+    << QStringLiteral("A0FF4590BB6122EDEF6E3C542D727CC768697734")
+    << QStringLiteral("0000000000000000000000000000000000000000")
+    << QStringLiteral("alfa@example.net")
+    << QStringLiteral("FE180B1DA9E3B0B2")
+    << QStringLiteral("a0ff4590bb6122edef6e3c542d727cc768697734");
+
+class GetKeysTest : public QGpgMETest
+{
+    Q_OBJECT
+
+Q_SIGNALS:
+    void asyncDone();
+
+private:
+    static void checkResult(const std::vector<Key> &keys, const std::vector<Error> &errors)
+    {
+        QCOMPARE(keys.size(), 5u);
+        QCOMPARE(errors.size(), 5u);
+
+        QVERIFY(!errors[0]);
+        QVERIFY(!keys[0].isNull());
+        QVERIFY(!strcmp(keys[0].primaryFingerprint(), "A0FF4590BB6122EDEF6E3C542D727CC768697734"));
+
+        // Not in the keyring.
+        QVERIFY(keys[1].isNull());
+        QCOMPARE(errors[1].code(), static_cast<int>(GPG_ERR_EOF));
+
+        // Neither a fingerprint nor a key ID.
+        QVERIFY(keys[2].isNull());
+        QCOMPARE(errors[2].code(), static_cast<int>(GPG_ERR_INV_VALUE));
+
+        // A key ID.
+        QVERIFY(!errors[3]);
+        QVERIFY(!keys[3].isNull());
+        QVERIFY(!strcmp(keys[3].primaryFingerprint(), "D695676BDCEDCC2CDD6152BCFE180B1DA9E3B0B2"));
+
+        // The same key as the first one in lower case.
+        QVERIFY(!errors[4]);
+        QVERIFY(!keys[4].isNull());
+        QVERIFY(!strcmp(keys[4].primaryFingerprint(), keys[0].primaryFingerprint()));
+    }
+
+private Q_SLOTS:
+
+    void testGetKeysSync()
+    {
+        GetKeysJob *job = openpgp()->getKeysJob();
+        std::vector<Key> keys;
+        std::vector<Error> errors;
+        const Error err = job->exec(lookups, keys, errors);
+        delete job;
+        QVERIFY(!err);
+        checkResult(keys, errors);
+    }
+
+    void testGetKeysAsync()
+    {
+        GetKeysJob *job = openpgp()->getKeysJob();
+        connect(job, &GetKeysJob::result, this, [this](const Error &err, const std::vector<Key> &keys, const std::vector<Error> &errors)
+        {
+            QVERIFY(!err);
+            checkResult(keys, errors);
+            Q_EMIT asyncDone();
+        });
+        QSignalSpy spy (this, SIGNAL(asyncDone()));
+        QVERIFY(!job->start(lookups));
+        QVERIFY(spy.wait(QSIGNALSPY_TIMEOUT));
+    }
+
+    void testGetKeysEmpty()
+    {
+        GetKeysJob *job = openpgp()->getKeysJob();
+        std::vector<Key> keys(1);
+        std::vector<Error> errors(1);
+        const Error err = job->exec(QStringList(), keys, errors);
+        delete job;
+        QVERIFY(!err);
+        QVERIFY(keys.empty());
+        QVERIFY(errors.empty());
+    }
+};
+
+QTEST_MAIN(GetKeysTest)
+
+#include "t-getkeys.moc"
@@ -38,6 +38,7 @@
 #include <QTest>
 #include <QSignalSpy>
 #include <QMap>
+#include <QThread>
 #include "keylistjob.h"
 #include "listallkeysjob.h"
 #include "qgpgmebackend.h"
@@ -46,6 +47,7 @@
 #include "context.h"
 #include "engineinfo.h"
 
+#include <algorithm>
 #include <memory>
 
 #include "t-support.h"
@@ -107,6 +109,77 @@ private Q_SLOTS:
         QVERIFY(!strcmp(key.primaryFingerprint(), "A0FF4590BB6122EDEF6E3C542D727CC768697734"));
     }
 
+    void testKeyItemRanges()
+    {
+        auto ctx = std::unique_ptr<GpgME::Context> (GpgME::Context::createForProtocol(GpgME::OpenPGP));
+        ctx->setKeyListMode (GpgME::KeyListMode::Local |
+                GpgME::KeyListMode::Signatures);
+        GpgME::Error err;
+        const GpgME::Key key = ctx->key ("A0FF4590BB6122EDEF6E3C542D727CC768697734", err, false);
+        QVERIFY(!err);
+
+        // Compare with the key as found in pubdemo.asc
+        static const char *const expectedSubkeys[] = {
+            "A0FF4590BB6122EDEF6E3C542D727CC768697734",
+            "3B3FBC948FE59301ED629EFB6AE6D7EE46A871F8"
+        };
+        static const char *const expectedUserIDs[] = {
+            "Alfa Test (demo key) <alfa@example.net>",
+            "Alpha Test (demo key) <alpha@example.net>",
+            "Alice (demo key)"
+        };
+        QCOMPARE(key.numSubkeys(), 2u);
+        QCOMPARE(key.numUserIDs(), 3u);
+
+        unsigned int i = 0;
+        for (const Subkey &subkey : key.subkeyRange()) {
+            QVERIFY(i < key.numSubkeys());
+            QVERIFY(!strcmp(subkey.fingerprint(), expectedSubkeys[i]));
+            ++i;
+        }
+        QCOMPARE(i, key.numSubkeys());
+
+        i = 0;
+        for (const UserID &uid : key.userIDRange()) {
+            QVERIFY(i < key.numUserIDs());
+            QVERIFY(!strcmp(uid.id(), expectedUserIDs[i]));
+            QVERIFY(uid.numSignatures() >= 1);
+            unsigned int nsigs = 0;
+            for (const UserID::Signature &sig : uid.signatureRange()) {
+                QVERIFY(sig.signerKeyID());
+                ++nsigs;
+            }
+            QCOMPARE(nsigs, uid.numSignatures());
+            ++i;
+        }
+        QCOMPARE(i, key.numUserIDs());
+
+        // An element copied out of the range must stay valid after the
+        // iterator has been advanced.
+        auto sit = key.subkeyRange().begin();
+        const Subkey primary = *sit;
+        auto old = sit++;
+        QVERIFY(!strcmp(primary.fingerprint(), expectedSubkeys[0]));
+        QVERIFY(!strcmp(sit->fingerprint(), expectedSubkeys[1]));
+        ++sit;
+        QVERIFY(sit == key.subkeyRange().end());
+        QVERIFY(!strcmp(primary.fingerprint(), expectedSubkeys[0]));
+        QVERIFY(primary.parent().primaryFingerprint());
+        QVERIFY(!strcmp(old->fingerprint(), expectedSubkeys[0]));
+
+        const UserID firstUid = *key.userIDRange().begin();
+        {
+            auto uit = key.userIDRange().begin();
+            ++uit;
+            ++uit;
+        }
+        QVERIFY(!strcmp(firstUid.id(), expectedUserIDs[0]));
+        QCOMPARE(firstUid.numSignatures(), key.userID(0).numSignatures());
+
+        QVERIFY(GpgME::Key().userIDRange().empty());
+        QVERIFY(GpgME::UserID().signatureRange().empty());
+    }
+
     void testPubkeyAlgoAsString()
     {
         static const QMap<Subkey::PubkeyAlgo, QString> expected {
@@ -141,6 +214,80 @@ private Q_SLOTS:
         QVERIFY(spy.wait(QSIGNALSPY_TIMEOUT));
     }
 
+    void testKeyListStreaming()
+    {
+        KeyListJob *job = openpgp()->keyListJob();
+        job->setStreaming(5, 1000);
+        std::vector<std::string> streamed;
+        int batches = 0;
+        connect(job, &KeyListJob::nextKeys, job, [&streamed, &batches](const std::vector<Key> &keys)
+        {
+            QVERIFY(!keys.empty() && keys.size() <= 5);
+            batches++;
+            for (const Key &key : keys) {
+                streamed.push_back(std::string(key.primaryFingerprint()));
+            }
+        });
+        connect(job, &KeyListJob::result, job, [this, &streamed](KeyListResult result, std::vector<Key> keys, QString, Error)
+        {
+            QVERIFY(!result.error());
+            QVERIFY(keys.empty());
+            QCOMPARE(streamed.size(), 26u);
+            Q_EMIT asyncDone();
+        });
+        QSignalSpy spy (this, SIGNAL(asyncDone()));
+        job->start(QStringList());
+        QVERIFY(spy.wait(QSIGNALSPY_TIMEOUT));
+        QVERIFY(batches >= 6);
+    }
+
+    void testKeyListStreamingCancel()
+    {
+        KeyListJob *job = openpgp()->keyListJob();
+        job->setStreaming(1, 1000);
+        int batches = 0;
+        connect(job, &KeyListJob::nextKeys, job, [job, &batches](const std::vector<Key> &)
+        {
+            if (batches++) {
+                return;
+            }
+            // Block the receiver so that the worker fills the queue and
+            // waits for us; then cancel.
+            QThread::msleep(500);
+            job->slotCancel();
+        });
+        connect(job, &KeyListJob::result, job, [this](KeyListResult result, std::vector<Key> keys, QString, Error)
+        {
+            QVERIFY(result.error().isCanceled());
+            QVERIFY(keys.empty());
+            Q_EMIT asyncDone();
+        });
+        QSignalSpy spy (this, SIGNAL(asyncDone()));
+        job->start(QStringList());
+        QVERIFY(spy.wait(QSIGNALSPY_TIMEOUT));
+        // The batches listed ahead are dropped.
+        QCOMPARE(batches, 1);
+    }
+
+    void testKeyListStreamingSync()
+    {
+        KeyListJob *job = openpgp()->keyListJob();
+        job->setStreaming(5, 1000);
+        std::vector<std::string> streamed;
+        connect(job, &KeyListJob::nextKeys, job, [&streamed](const std::vector<Key> &keys)
+        {
+            for (const Key &key : keys) {
+                streamed.push_back(std::string(key.primaryFingerprint()));
+            }
+        });
+        std::vector<Key> keys;
+        const KeyListResult result = job->exec(QStringList(), false, keys);
+        delete job;
+        QVERIFY(!result.error());
+        QVERIFY(keys.empty());
+        QCOMPARE(streamed.size(), 26u);
+    }
+
     void testListAllKeysSync()
     {
         const auto accumulateFingerprints = [](std::vector<std::string> &v, const Key &key) { v.push_back(std::string(key.primaryFingerprint())); return v; };
@@ -202,6 +349,24 @@ private Q_SLOTS:
             QVERIFY(pubKeys[4].subkeys()[0].keyGrip());
         }
     }
+
+    void testListAllKeysAsync()
+    {
+        ListAllKeysJob *job = openpgp()->listAllKeysJob(/* includeSigs= */false, /* validate= */false);
+        connect(job, &ListAllKeysJob::result, job, [this](const KeyListResult &result, const std::vector<Key> &pubKeys, const std::vector<Key> &secKeys)
+        {
+            QVERIFY(!result.error());
+            QCOMPARE(pubKeys.size(), 26u);
+            QCOMPARE(secKeys.size(), 2u);
+            QVERIFY(!strcmp(secKeys[0].primaryFingerprint(), "23FD347A419429BACCD5E72D6BC4778054ACD246"));
+            QVERIFY(!strcmp(secKeys[1].primaryFingerprint(), "A0FF4590BB6122EDEF6E3C542D727CC768697734"));
+            QVERIFY(std::is_sorted(pubKeys.begin(), pubKeys.end(), ByFingerprint<std::less>()));
+            Q_EMIT asyncDone();
+        });
+        QSignalSpy spy (this, SIGNAL(asyncDone()));
+        QVERIFY(!job->start());
+        QVERIFY(spy.wait(QSIGNALSPY_TIMEOUT));
+    }
 };
 
 QTEST_MAIN(KeyListTest)
@@ -101,6 +101,15 @@ ath_select (int nfd, fd_set *rset, fd_set *wset, fd_set *eset,
 }
 
 
+#if defined(HAVE_POLL_H) && defined(HAVE_POLL)
+int
+ath_poll (struct pollfd *fds, nfds_t nfds, int timeout)
+{
+  return poll (fds, nfds, timeout);
+}
+#endif
+
+
 gpgme_ssize_t
 ath_waitpid (pid_t pid, int *status, int options)
 {
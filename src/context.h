@@ -29,6 +29,9 @@
 
 extern gpgme_error_t _gpgme_selftest;
 
+/* The entry of a context in the global event loop (wait-global.c).  */
+struct ctx_list_item;
+
 /* Operations might require to remember arbitrary information and data
    objects during invocations of the status handler.  The
    ctx_op_data structure provides a generic framework to hook in
@@ -43,6 +46,10 @@ typedef enum
   } ctx_op_data_id_t;
 
 
+/* The largest value accepted for the "io-buffer-size" flag.  */
+#define MAX_IO_BUFFER_SIZE (16 * 1024 * 1024)
+
+
 /* "gpgmeres" in ASCII.  */
 #define CTX_OP_DATA_MAGIC 0x736572656d677067ULL
 struct ctx_op_data
@@ -174,6 +181,10 @@ struct gpgme_context
   /* The optional trust-model override.  */
   char *trust_model;
 
+  /* The size of the buffers used to pass data to and from the engine
+   * as a decimal string or NULL for the default.  */
+  char *io_buffer_size;
+
   /* The operation data hooked into the context.  */
   ctx_op_data_t op_data;
 
@@ -193,6 +204,10 @@ struct gpgme_context
      operation.  */
   struct fd_table fdt;
   struct gpgme_io_cbs io_cbs;
+
+  /* The entry of this context in the global event loop or NULL.  This
+     is protected by the lock of the global event loop.  */
+  struct ctx_list_item *global_item;
 };
 
 #endif	/* CONTEXT_H */
@@ -403,6 +403,35 @@ _gpgme_split_fields (char *string, char **array, int arraysize)
   return n;
 }
 
+/* Split a colon delimited record as printed by GnuPG with
+ * --with-colons.  A pointer to each field is stored in ARRAY and the
+ * colons are replaced by Nuls.  Stop splitting at ARRAYSIZE fields;
+ * anything after the last stored field is ignored.  The function
+ * modifies STRING.  The number of parsed fields is returned.
+ */
+int
+_gpgme_split_colon_fields (char *string, char **array, int arraysize)
+{
+  int n = 0;
+  char *p;
+
+  if (arraysize < 1)
+    return 0;
+
+  array[n++] = string;
+  for (p = string; *p; p++)
+    if (*p == ':')
+      {
+        *p = 0;
+        if (n == arraysize)
+          break;
+        array[n++] = p + 1;
+      }
+
+  return n;
+}
+
+
 /* Convert the field STRING into an unsigned long value.  Check for
  * trailing garbage.  */
 gpgme_error_t
@@ -82,6 +82,7 @@ gpgme_data_new_from_fd (gpgme_data_t *r_dh, int fd)
     return TRACE_ERR (err);
 
   (*r_dh)->data.fd = fd;
+  (*r_dh)->direct_fd = 1;
   TRACE_SUC ("dh=%p", *r_dh);
   return 0;
 }
@@ -54,8 +54,10 @@ mem_read (gpgme_data_t dh, void *buffer, size_t size)
 }
 
 
-static gpgme_ssize_t
-mem_write (gpgme_data_t dh, const void *buffer, size_t size)
+/* Make sure that at least SIZE bytes can be stored at the current
+   offset of DH.  Returns 0 on success or -1 with errno set.  */
+static int
+mem_ensure (gpgme_data_t dh, size_t size)
 {
   size_t unused;
 
@@ -101,14 +103,55 @@ mem_write (gpgme_data_t dh, const void *buffer, size_t size)
       dh->data.mem.size = new_size;
     }
 
-  memcpy (dh->data.mem.buffer + dh->data.mem.offset, buffer, size);
-  dh->data.mem.offset += size;
+  return 0;
+}
+
+
+static void
+mem_advance (gpgme_data_t dh, size_t amt)
+{
+  dh->data.mem.offset += amt;
   if (dh->data.mem.length < dh->data.mem.offset)
     dh->data.mem.length = dh->data.mem.offset;
+}
+
+
+static gpgme_ssize_t
+mem_write (gpgme_data_t dh, const void *buffer, size_t size)
+{
+  if (mem_ensure (dh, size))
+    return -1;
+
+  memcpy (dh->data.mem.buffer + dh->data.mem.offset, buffer, size);
+  mem_advance (dh, size);
   return size;
 }
 
 
+/* Return the unread part of the buffer without copying it.  This
+   works for borrowed buffers (gpgme_data_new_from_mem with COPY set
+   to 0) as well.  */
+static const void *
+mem_peek (gpgme_data_t dh, size_t *r_len)
+{
+  const char *src;
+
+  src = dh->data.mem.buffer ? dh->data.mem.buffer : dh->data.mem.orig_buffer;
+  *r_len = dh->data.mem.length - dh->data.mem.offset;
+  return src ? src + dh->data.mem.offset : NULL;
+}
+
+
+static void *
+mem_reserve (gpgme_data_t dh, size_t size)
+{
+  if (mem_ensure (dh, size))
+    return NULL;
+
+  return dh->data.mem.buffer + dh->data.mem.offset;
+}
+
+
 static gpgme_off_t
 mem_seek (gpgme_data_t dh, gpgme_off_t offset, int whence)
 {
@@ -161,7 +204,10 @@ static struct _gpgme_data_cbs mem_cbs =
     mem_write,
     mem_seek,
     mem_release,
-    NULL
+    NULL,
+    mem_peek,
+    mem_reserve,
+    mem_advance
   };
 
 
@@ -0,0 +1,206 @@
+/* data-mmap.c - A memory mapped file based data object.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+# include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#include <fcntl.h>
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+# include <sys/mman.h>
+# define USE_MMAP 1
+#endif
+
+#include "debug.h"
+#include "data.h"
+
+
+#ifdef USE_MMAP
+
+static gpgme_ssize_t
+mapped_read (gpgme_data_t dh, void *buffer, size_t size)
+{
+  size_t amt = dh->data.mapped.length - dh->data.mapped.offset;
+
+  if (!amt)
+    return 0;
+
+  if (size < amt)
+    amt = size;
+
+  memcpy (buffer, dh->data.mapped.buffer + dh->data.mapped.offset, amt);
+  dh->data.mapped.offset += amt;
+  return amt;
+}
+
+
+static gpgme_off_t
+mapped_seek (gpgme_data_t dh, gpgme_off_t offset, int whence)
+{
+  gpgme_off_t length = dh->data.mapped.length;
+
+  switch (whence)
+    {
+    case SEEK_SET:
+      break;
+    case SEEK_CUR:
+      offset += dh->data.mapped.offset;
+      break;
+    case SEEK_END:
+      offset += length;
+      break;
+    default:
+      gpg_err_set_errno (EINVAL);
+      return -1;
+    }
+  if (offset < 0 || offset > length)
+    {
+      gpg_err_set_errno (EINVAL);
+      return -1;
+    }
+  dh->data.mapped.offset = offset;
+  return offset;
+}
+
+
+static void
+mapped_release (gpgme_data_t dh)
+{
+  if (dh->data.mapped.buffer)
+    munmap ((void *)dh->data.mapped.buffer, dh->data.mapped.length);
+}
+
+
+static const void *
+mapped_peek (gpgme_data_t dh, size_t *r_len)
+{
+  *r_len = dh->data.mapped.length - dh->data.mapped.offset;
+  return dh->data.mapped.buffer + dh->data.mapped.offset;
+}
+
+
+static void
+mapped_advance (gpgme_data_t dh, size_t amt)
+{
+  dh->data.mapped.offset += amt;
+}
+
+
+static struct _gpgme_data_cbs mapped_cbs =
+  {
+    mapped_read,
+    NULL,
+    mapped_seek,
+    mapped_release,
+    NULL,
+    mapped_peek,
+    NULL,
+    mapped_advance
+  };
+
+#endif /*USE_MMAP*/
+
+
+/* Create a new read-only data object for the file FNAME which is
+   mapped into memory instead of being read.  The file must not be
+   modified while the data object exists.  If mmap is not available
+   the file is read into memory.  */
+gpgme_error_t
+gpgme_data_new_from_mmap (gpgme_data_t *r_dh, const char *fname)
+{
+#ifdef USE_MMAP
+  gpgme_error_t err;
+  struct stat statbuf;
+  void *buffer = NULL;
+  int fd;
+  TRACE_BEG  (DEBUG_DATA, "gpgme_data_new_from_mmap", r_dh,
+	      "file_name=%s", fname);
+
+  if (!r_dh || !fname)
+    return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
+
+  fd = open (fname, O_RDONLY);
+  if (fd == -1)
+    return TRACE_ERR (gpg_error_from_syserror ());
+  if (fstat (fd, &statbuf))
+    {
+      err = gpg_error_from_syserror ();
+      close (fd);
+      return TRACE_ERR (err);
+    }
+  if (!S_ISREG (statbuf.st_mode))
+    {
+      close (fd);
+      return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
+    }
+  if ((gpgme_off_t)(size_t)statbuf.st_size != statbuf.st_size)
+    {
+      close (fd);
+      return TRACE_ERR (gpg_error (GPG_ERR_TOO_LARGE));
+    }
+
+  /* An empty file can't be mapped.  */
+  if (statbuf.st_size)
+    {
+      buffer = mmap (NULL, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (buffer == MAP_FAILED)
+        {
+          err = gpg_error_from_syserror ();
+          close (fd);
+          return TRACE_ERR (err);
+        }
+#ifdef HAVE_MADVISE
+      /* The engine reads the data from start to end; this lets the
+         kernel read ahead aggressively and drop the pages early.  */
+      madvise (buffer, statbuf.st_size, MADV_SEQUENTIAL);
+#endif
+    }
+  close (fd);
+
+  err = _gpgme_data_new (r_dh, &mapped_cbs);
+  if (err)
+    {
+      if (buffer)
+        munmap (buffer, statbuf.st_size);
+      return TRACE_ERR (err);
+    }
+
+  (*r_dh)->data.mapped.buffer = buffer;
+  (*r_dh)->data.mapped.length = statbuf.st_size;
+  (*r_dh)->size_hint = statbuf.st_size;
+
+  TRACE_SUC ("dh=%p", *r_dh);
+  return 0;
+#else /*!USE_MMAP*/
+  return gpgme_data_new_from_file (r_dh, fname, 1);
+#endif /*!USE_MMAP*/
+}
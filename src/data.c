@@ -45,15 +45,18 @@
  *
  * We use a separate table instead of linking all data objects
  * together for faster locating properties of the data object using
- * the data objects serial number.  We use 64 bit for the serial
- * number which is good enough to create a new data object every
- * nanosecond for more than 500 years.  Thus no wrap around will ever
- * happen.
+ * the data objects serial number.  The serial number has the index
+ * of the slot in its low 32 bits and a per-slot generation counter in
+ * its high 32 bits; thus a lookup by serial number is a direct index
+ * and a serial number is only used again after the same slot has
+ * been reused 2^32 times.  Unused slots are kept in a free list so
+ * that inserting and removing an object takes constant time.
  */
 struct property_s
 {
   gpgme_data_t dh;   /* The data objcet or NULL if the slot is not used.  */
   uint64_t dserial;  /* The serial number of the data object.  */
+  unsigned int next_free;  /* Index of the next free slot if unused.  */
   struct {
     unsigned int blankout : 1;  /* Void the held data.  */
   } flags;
@@ -62,46 +65,40 @@ typedef struct property_s *property_t;
 
 static property_t property_table;
 static unsigned int property_table_size;
+static unsigned int property_table_free;  /* Head of the free list.  */
 DEFINE_STATIC_LOCK (property_table_lock);
-#define PROPERTY_TABLE_ALLOCATION_CHUNK 32
+#define PROPERTY_TABLE_INITIAL_SIZE 32
+#define PROPERTY_TABLE_MAX_SIZE 0x10000000  /* 2^28 slots.  */
+#define PROPERTY_TABLE_NIL ((unsigned int)(-1))  /* End of the free list.  */
+
 
 
-
 /* Insert the newly created data object DH into the property table and
  * store the index of it at R_IDX.  An error code is returned on error
  * and the table is not changed.  */
 static gpg_error_t
 insert_into_property_table (gpgme_data_t dh, unsigned int *r_idx)
 {
-  static uint64_t last_dserial;
   gpg_error_t err;
   unsigned int idx;
 
   LOCK (property_table_lock);
-  if (!property_table)
+  if (!property_table || property_table_free == PROPERTY_TABLE_NIL)
     {
-      property_table_size = PROPERTY_TABLE_ALLOCATION_CHUNK;
-      property_table = calloc (property_table_size, sizeof *property_table);
+      /* No empty slot available.  Double the size of the table.  */
+      property_t newtbl;
+      unsigned int newsize;
+
       if (!property_table)
+        newsize = PROPERTY_TABLE_INITIAL_SIZE;
+      else if (property_table_size >= PROPERTY_TABLE_MAX_SIZE)
         {
-          err = gpg_error_from_syserror ();
+          err = gpg_error (GPG_ERR_ENOMEM);
           goto leave;
         }
-    }
-
-  /* Find an empty slot.  */
-  for (idx = 0; idx < property_table_size; idx++)
-    if (!property_table[idx].dh)
-      break;
-  if (!(idx < property_table_size))
-    {
-      /* No empty slot found.  Enlarge the table.  */
-      property_t newtbl;
-      unsigned int newsize;
-
-      newsize = property_table_size + PROPERTY_TABLE_ALLOCATION_CHUNK;;
-      if ((newsize * sizeof *property_table)
-          < (property_table_size * sizeof *property_table))
+      else
+        newsize = 2 * property_table_size;
+      if (newsize > SIZE_MAX / sizeof *property_table)
         {
           err = gpg_error (GPG_ERR_ENOMEM);
           goto leave;
@@ -113,15 +110,23 @@ insert_into_property_table (gpgme_data_t dh, unsigned int *r_idx)
           goto leave;
         }
       property_table = newtbl;
+      /* Put the new slots on the free list in ascending order.  */
       for (idx = property_table_size; idx < newsize; idx++)
-        property_table[idx].dh = NULL;
-      idx = property_table_size;
+        {
+          property_table[idx].dh = NULL;
+          property_table[idx].dserial = idx;
+          property_table[idx].next_free = idx + 1 < newsize? idx + 1
+            /**/                                           : PROPERTY_TABLE_NIL;
+        }
+      property_table_free = property_table_size;
       property_table_size = newsize;
     }
 
-  /* Slot found. */
+  /* Take the first free slot and bump its generation.  */
+  idx = property_table_free;
+  property_table_free = property_table[idx].next_free;
   property_table[idx].dh = dh;
-  property_table[idx].dserial = ++last_dserial;
+  property_table[idx].dserial += (uint64_t)1 << 32;
   memset (&property_table[idx].flags, 0, sizeof property_table[idx].flags);
   *r_idx = idx;
   err = 0;
@@ -142,6 +147,8 @@ remove_from_property_table (gpgme_data_t dh, unsigned int propidx)
   assert (propidx < property_table_size);
   assert (property_table[propidx].dh == dh);
   property_table[propidx].dh = NULL;
+  property_table[propidx].next_free = property_table_free;
+  property_table_free = propidx;
   UNLOCK (property_table_lock);
 }
 
@@ -169,6 +176,32 @@ _gpgme_data_get_dserial (gpgme_data_t dh)
 }
 
 
+/* Return the index of the slot for DH or DSERIAL in the property
+ * table or -1 if there is none.  Must be called with the
+ * property_table_lock held.  */
+static int
+lookup_property (gpgme_data_t dh, uint64_t dserial)
+{
+  unsigned int idx;
+
+  if (dh) /* Lookup via handle.  */
+    {
+      idx = dh->propidx;
+      assert (property_table);
+      assert (idx < property_table_size);
+      assert (property_table[idx].dh == dh);
+      return idx;
+    }
+
+  /* Lookup via DSERIAL.  */
+  idx = (unsigned int)(dserial & 0xffffffff);
+  if (!property_table || !(idx < property_table_size)
+      || !property_table[idx].dh || property_table[idx].dserial != dserial)
+    return -1;
+  return idx;
+}
+
+
 /* Set an internal property of a data object.  The data object may
  * either be identified by the usual DH or by using the data serial
  * number DSERIAL.  */
@@ -189,28 +222,11 @@ _gpgme_data_set_prop (gpgme_data_t dh, uint64_t dserial,
       err = gpg_error (GPG_ERR_INV_VALUE);
       goto leave;
     }
-  if (dh) /* Lookup via handle.  */
-    {
-      idx = dh->propidx;
-      assert (property_table);
-      assert (idx < property_table_size);
-      assert (property_table[idx].dh == dh);
-    }
-  else /* Lookup via DSERIAL.  */
+  idx = lookup_property (dh, dserial);
+  if (idx < 0)
     {
-      if (!property_table)
-        {
-          err = gpg_error (GPG_ERR_NOT_FOUND);
-          goto leave;
-        }
-      for (idx = 0; idx < property_table_size; idx++)
-        if (property_table[idx].dh && property_table[idx].dserial == dserial)
-          break;
-      if (!(idx < property_table_size))
-        {
-          err = gpg_error (GPG_ERR_NOT_FOUND);
-          goto leave;
-        }
+      err = gpg_error (GPG_ERR_NOT_FOUND);
+      goto leave;
     }
 
   switch (name)
@@ -254,28 +270,11 @@ _gpgme_data_get_prop (gpgme_data_t dh, uint64_t dserial,
       err = gpg_error (GPG_ERR_INV_VALUE);
       goto leave;
     }
-  if (dh) /* Lookup via handle.  */
+  idx = lookup_property (dh, dserial);
+  if (idx < 0)
     {
-      idx = dh->propidx;
-      assert (property_table);
-      assert (idx < property_table_size);
-      assert (property_table[idx].dh == dh);
-    }
-  else /* Lookup via DSERIAL.  */
-    {
-      if (!property_table)
-        {
-          err = gpg_error (GPG_ERR_NOT_FOUND);
-          goto leave;
-        }
-      for (idx = 0; idx < property_table_size; idx++)
-        if (property_table[idx].dh && property_table[idx].dserial == dserial)
-          break;
-      if (!(idx < property_table_size))
-        {
-          err = gpg_error (GPG_ERR_NOT_FOUND);
-          goto leave;
-        }
+      err = gpg_error (GPG_ERR_NOT_FOUND);
+      goto leave;
     }
 
   switch (name)
@@ -317,6 +316,8 @@ _gpgme_data_new (gpgme_data_t *r_dh, struct _gpgme_data_cbs *cbs)
     return gpg_error_from_syserror ();
 
   dh->cbs = cbs;
+  dh->pending = dh->pending_buf;
+  dh->pending_size = sizeof dh->pending_buf;
 
   err = insert_into_property_table (dh, &dh->propidx);
   if (err)
@@ -339,6 +340,8 @@ _gpgme_data_release (gpgme_data_t dh)
   remove_from_property_table (dh, dh->propidx);
   if (dh->file_name)
     free (dh->file_name);
+  if (dh->pending != dh->pending_buf)
+    free (dh->pending);
   free (dh);
 }
 
@@ -565,18 +568,61 @@ gpgme_data_set_flag (gpgme_data_t dh, const char *name, const char *value)
 
 /* Functions to support the wait interface.  */
 
+/* The number of bytes to splice at once.  Nothing is buffered, thus
+   we can use at least the default size of a Linux pipe.  */
+#define SPLICE_SIZE(dh) \
+  ((dh)->pending_size > 65536? (dh)->pending_size : 65536)
+
+
 gpgme_error_t
 _gpgme_data_inbound_handler (void *opaque, int fd)
 {
   struct io_cb_data *data = (struct io_cb_data *) opaque;
   gpgme_data_t dh = (gpgme_data_t) data->handler_value;
-  char buffer[BUFFER_SIZE];
-  char *bufp = buffer;
+  char *bufp;
   gpgme_ssize_t buflen;
+  int dh_fd;
   TRACE_BEG  (DEBUG_CTX, "_gpgme_data_inbound_handler", dh,
 	      "fd=%d", fd);
 
-  buflen = _gpgme_io_read (fd, buffer, BUFFER_SIZE);
+  dh_fd = dh->no_splice? -1 : _gpgme_data_get_direct_fd (dh);
+  if (dh_fd != -1)
+    {
+      buflen = _gpgme_io_splice (fd, dh_fd, SPLICE_SIZE (dh));
+      if (buflen == 0)
+        {
+          _gpgme_io_close (fd);
+          return TRACE_ERR (0);
+        }
+      if (buflen > 0)
+        return TRACE_ERR (0);
+      if (errno != EINVAL && errno != ENOSYS && errno != EAGAIN)
+        return TRACE_ERR (gpg_error_from_syserror ());
+      /* The fd does not support splicing or, with EAGAIN, it is a
+         full pipe on which the splice may not wait; use the buffer
+         which does a blocking write like before.  */
+      dh->no_splice = 1;
+    }
+
+  if (dh->cbs->reserve)
+    {
+      /* Read directly into the data object.  */
+      bufp = (*dh->cbs->reserve) (dh, dh->pending_size);
+      if (!bufp)
+        return TRACE_ERR (gpg_error_from_syserror ());
+      buflen = _gpgme_io_read (fd, bufp, dh->pending_size);
+      if (buflen < 0)
+        return TRACE_ERR (gpg_error_from_syserror ());
+      if (buflen == 0)
+        _gpgme_io_close (fd);
+      else
+        (*dh->cbs->advance) (dh, buflen);
+      return TRACE_ERR (0);
+    }
+
+  /* The pending buffer is not used for inbound data.  */
+  bufp = dh->pending;
+  buflen = _gpgme_io_read (fd, bufp, dh->pending_size);
   if (buflen < 0)
     return gpg_error_from_syserror ();
   if (buflen == 0)
@@ -604,12 +650,70 @@ _gpgme_data_outbound_handler (void *opaque, int fd)
   struct io_cb_data *data = (struct io_cb_data *) opaque;
   gpgme_data_t dh = (gpgme_data_t) data->handler_value;
   gpgme_ssize_t nwritten;
+  int dh_fd;
   TRACE_BEG  (DEBUG_CTX, "_gpgme_data_outbound_handler", dh,
 	      "fd=%d", fd);
 
+  dh_fd = dh->no_splice? -1 : _gpgme_data_get_direct_fd (dh);
+  if (dh_fd != -1)
+    {
+      nwritten = _gpgme_io_splice (dh_fd, fd, SPLICE_SIZE (dh));
+      if (nwritten > 0)
+        return TRACE_ERR (0);
+      if (!nwritten || (nwritten == -1 && errno == EPIPE))
+        {
+          /* EOF or the other end closed the pipe; see below.  */
+          _gpgme_io_close (fd);
+          return TRACE_ERR (0);
+        }
+      if (errno != EINVAL && errno != ENOSYS && errno != EAGAIN)
+        return TRACE_ERR (gpg_error_from_syserror ());
+      /* The fd does not support splicing or, with EAGAIN, it is a
+         pipe without data yet.  Returning would spin because our fd
+         stays writable; use the buffer which does a blocking read
+         like before.  */
+      dh->no_splice = 1;
+    }
+
+  if (!dh->pending_len && dh->cbs->peek)
+    {
+      /* Write directly from the data object.  The fd is non-blocking
+         thus we may hand over everything we have.  */
+      const void *src;
+      size_t srclen = 0;
+      int blankout;
+
+      if (_gpgme_data_get_prop (dh, 0, DATA_PROP_BLANKOUT, &blankout)
+          || blankout)
+        src = NULL;
+      else
+        src = (*dh->cbs->peek) (dh, &srclen);
+      if (!src || !srclen)
+        {
+          _gpgme_io_close (fd);
+          return TRACE_ERR (0);
+        }
+
+      nwritten = _gpgme_io_write (fd, src, srclen);
+      if (nwritten == -1 && errno == EAGAIN)
+        return TRACE_ERR (0);
+      if (nwritten == -1 && errno == EPIPE)
+        {
+          /* See below.  */
+          _gpgme_io_close (fd);
+          return TRACE_ERR (0);
+        }
+      if (nwritten <= 0)
+        return TRACE_ERR (gpg_error_from_syserror ());
+
+      (*dh->cbs->advance) (dh, nwritten);
+      return TRACE_ERR (0);
+    }
+
   if (!dh->pending_len)
     {
-      gpgme_ssize_t amt = gpgme_data_read (dh, dh->pending, BUFFER_SIZE);
+      gpgme_ssize_t amt = gpgme_data_read (dh, dh->pending,
+                                           dh->pending_size);
       if (amt < 0)
 	return TRACE_ERR (gpg_error_from_syserror ());
       if (amt == 0)
@@ -655,6 +759,57 @@ _gpgme_data_get_fd (gpgme_data_t dh)
 }
 
 
+/* Return the file descriptor of DH if the engine or the I/O handlers
+   may access it directly.  This is only the case for objects which
+   do not buffer data themselves and have no pending data.  */
+int
+_gpgme_data_get_direct_fd (gpgme_data_t dh)
+{
+#ifdef HAVE_W32_SYSTEM
+  (void)dh;
+  return -1;
+#else
+  if (!dh || !dh->direct_fd || dh->pending_len || !dh->cbs->get_fd)
+    return -1;
+  return (*dh->cbs->get_fd) (dh);
+#endif
+}
+
+
+/* Set the size of the buffer used by the I/O handlers for DH to SIZE
+   bytes.  A value of 0 or a value less than the default selects the
+   default.  The buffer is never shrunk while data is pending.  */
+gpgme_error_t
+_gpgme_data_set_io_buffer_size (gpgme_data_t dh, size_t size)
+{
+  char *buffer;
+
+  if (!dh)
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  if (size < sizeof dh->pending_buf)
+    size = sizeof dh->pending_buf;
+  if (size == dh->pending_size || size < (size_t)dh->pending_len)
+    return 0;
+
+  if (size == sizeof dh->pending_buf)
+    buffer = dh->pending_buf;
+  else
+    {
+      buffer = malloc (size);
+      if (!buffer)
+        return gpg_error_from_syserror ();
+    }
+  if (dh->pending_len)
+    memcpy (buffer, dh->pending, dh->pending_len);
+  if (dh->pending != dh->pending_buf)
+    free (dh->pending);
+  dh->pending = buffer;
+  dh->pending_size = size;
+  return 0;
+}
+
+
 /* Get the size-hint value for DH or 0 if not available.  */
 gpgme_off_t
 _gpgme_data_get_size_hint (gpgme_data_t dh)
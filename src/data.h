@@ -61,6 +61,23 @@ typedef void (*gpgme_data_release_cb) (gpgme_data_t dh);
 /* Get the FD associated with the handle DH, or -1.  */
 typedef int (*gpgme_data_get_fd_cb) (gpgme_data_t dh);
 
+/* Return a pointer to the data available for reading at the current
+   position of the data object with the handle DH and store its
+   length at R_LEN.  The data is not consumed; use the advance
+   callback for this.  */
+typedef const void *(*gpgme_data_peek_cb) (gpgme_data_t dh, size_t *r_len);
+
+/* Return a pointer to at least SIZE writable bytes at the current
+   position of the data object with the handle DH, or NULL on error
+   with errno set.  The bytes are not accounted for until the advance
+   callback is called.  */
+typedef void *(*gpgme_data_reserve_cb) (gpgme_data_t dh, size_t size);
+
+/* Move the current position of the data object with the handle DH
+   forward by AMT bytes which have been consumed via the peek callback
+   or stored via the reserve callback.  */
+typedef void (*gpgme_data_advance_cb) (gpgme_data_t dh, size_t amt);
+
 struct _gpgme_data_cbs
 {
   gpgme_data_read_cb read;
@@ -68,6 +85,14 @@ struct _gpgme_data_cbs
   gpgme_data_seek_cb seek;
   gpgme_data_release_cb release;
   gpgme_data_get_fd_cb get_fd;
+
+  /* Optional callbacks which allow the I/O handlers to transfer data
+     directly from or into the object's own memory.  Either PEEK or
+     RESERVE may be NULL; ADVANCE is required if one of them is
+     set.  */
+  gpgme_data_peek_cb peek;
+  gpgme_data_reserve_cb reserve;
+  gpgme_data_advance_cb advance;
 };
 
 struct gpgme_data
@@ -85,8 +110,14 @@ struct gpgme_data
 #define BUFFER_SIZE 512
 #endif
 #endif
-  char pending[BUFFER_SIZE];
+  /* The buffer used by the I/O handlers.  PENDING points either to
+     PENDING_BUF or to a malloced buffer of PENDING_SIZE bytes.  The
+     outbound handler keeps PENDING_LEN bytes in it which could not
+     yet be written.  */
+  char *pending;
+  size_t pending_size;
   int pending_len;
+  char pending_buf[BUFFER_SIZE];
 
   /* File name of the data object.  */
   char *file_name;
@@ -94,6 +125,13 @@ struct gpgme_data
   /* Hint on the to be expected total size of the data.  */
   gpgme_off_t size_hint;
 
+  /* True if the fd returned by the get_fd callback may be read or
+     written directly because the object does not buffer data.  */
+  unsigned int direct_fd : 1;
+
+  /* True if splice(2) can't be used with this object's fd.  */
+  unsigned int no_splice : 1;
+
   union
   {
     /* For gpgme_data_new_from_fd.  */
@@ -123,6 +161,14 @@ struct gpgme_data
       gpgme_off_t offset;
     } mem;
 
+    /* For gpgme_data_new_from_mmap.  */
+    struct
+    {
+      const char *buffer;
+      size_t length;
+      gpgme_off_t offset;
+    } mapped;
+
     /* For gpgme_data_new_from_read_cb.  */
     struct
     {
@@ -163,8 +209,15 @@ void _gpgme_data_release (gpgme_data_t dh);
    return -1.  */
 int _gpgme_data_get_fd (gpgme_data_t dh);
 
+/* Return the file descriptor of DH if it can be handed to the engine
+   or used for splicing.  Otherwise return -1.  */
+int _gpgme_data_get_direct_fd (gpgme_data_t dh);
+
 /* Get the size-hint value for DH or 0 if not available.  */
 gpgme_off_t _gpgme_data_get_size_hint (gpgme_data_t dh);
 
+/* Set the number of bytes the I/O handlers move at once for DH.  */
+gpgme_error_t _gpgme_data_set_io_buffer_size (gpgme_data_t dh, size_t size);
+
 
 #endif	/* DATA_H */
@@ -98,6 +98,10 @@ struct engine_llass
   } opt;
 
   char request_origin[10];  /* Copy from the CTX.  */
+
+  /* Set if an option was sent which RESET does not revert.  Such an
+     engine is not put into the engine pool.  */
+  int no_reuse;
 };
 typedef struct engine_llass *engine_llass_t;
 
@@ -212,6 +216,34 @@ llass_release (void *engine)
 }
 
 
+static int
+llass_idle (void *engine)
+{
+  engine_llass_t llass = engine;
+
+  return (llass->assuan_ctx
+          && llass->status_cb.fd == -1
+          && !llass->no_reuse);
+}
+
+
+/* Prepare an engine from the engine pool for a new context.  Engines
+   which got an option from the former context are not pooled.  The
+   RESET also checks that the server is still there.  */
+static gpgme_error_t
+llass_reuse (void *engine)
+{
+  engine_llass_t llass = engine;
+
+  memset (&llass->user, 0, sizeof llass->user);
+  llass->last_op_err = 0;
+  *llass->request_origin = 0;
+
+  return assuan_transact (llass->assuan_ctx, "RESET",
+                          NULL, NULL, NULL, NULL, NULL, NULL);
+}
+
+
 /* Create a new instance. If HOME_DIR is NULL standard options for use
    with gpg-agent are issued.  */
 static gpgme_error_t
@@ -697,6 +729,7 @@ start (engine_llass_t llass, const char *command)
                               llass->request_origin, NULL);
       if (!cmd)
         return gpg_error_from_syserror ();
+      llass->no_reuse = 1;
       err = assuan_transact (llass->assuan_ctx, cmd, NULL, NULL, NULL,
                              NULL, NULL, NULL);
       free (cmd);
@@ -751,6 +784,21 @@ start (engine_llass_t llass, const char *command)
 
 
 
+/* Return true if COMMAND is an Assuan OPTION command.  */
+static int
+is_option_command (const char *command)
+{
+  const char *s;
+
+  while (*command == ' ' || *command == '\t')
+    command++;
+  for (s = "OPTION"; *s; s++, command++)
+    if ((*command & ~0x20) != *s)
+      return 0;
+  return !*command || *command == ' ' || *command == '\t';
+}
+
+
 static gpgme_error_t
 llass_transact (void *engine,
                 const char *command,
@@ -767,6 +815,10 @@ llass_transact (void *engine,
   if (!llass || !command || !*command)
     return gpg_error (GPG_ERR_INV_VALUE);
 
+  /* We can't know which options the caller sets.  */
+  if (is_option_command (command))
+    llass->no_reuse = 1;
+
   llass->user.data_cb = data_cb;
   llass->user.data_cb_value = data_cb_value;
   llass->user.inq_cb = inq_cb;
@@ -849,5 +901,7 @@ struct engine_ops _gpgme_engine_ops_assuan =
     llass_cancel_op,
     NULL,               /* passwd */
     NULL,               /* set_pinentry_mode */
-    NULL                /* opspawn */
+    NULL,               /* opspawn */
+    llass_idle,
+    llass_reuse
   };
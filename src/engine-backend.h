@@ -162,6 +162,13 @@ struct engine_ops
                             gpgme_data_t dataout,
                             gpgme_data_t dataerr, unsigned int flags);
 
+  /* Return true if no operation is pending so that the engine may be
+     put into the engine pool.  */
+  int (*idle) (void *engine);
+
+  /* Prepare an engine taken from the engine pool for use by another
+     context.  Returns an error if the server is not usable anymore.  */
+  gpgme_error_t (*reuse) (void *engine);
 };
 
 
@@ -820,5 +820,7 @@ struct engine_ops _gpgme_engine_ops_g13 =
     g13_cancel_op,
     NULL,               /* passwd */
     NULL,               /* set_pinentry_mode */
-    NULL                /* opspawn */
+    NULL,               /* opspawn */
+    NULL,               /* idle */
+    NULL                /* reuse */
   };
@@ -44,6 +44,7 @@
 #include "debug.h"
 #include "data.h"
 #include "mbox-util.h"
+#include "linebuf.h"
 
 #include "engine-backend.h"
 
@@ -96,9 +97,7 @@ struct engine_gpg
   {
     int fd[2];
     int arg_loc;
-    size_t bufsize;
-    char *buffer;
-    size_t readpos;
+    struct linebuf_s lines;
     int eof;
     engine_status_handler_t fnc;
     void *fnc_value;
@@ -112,9 +111,7 @@ struct engine_gpg
   {
     int fd[2];
     int arg_loc;
-    size_t bufsize;
-    char *buffer;
-    size_t readpos;
+    struct linebuf_s lines;
     int eof;
     engine_colon_line_handler_t fnc;  /* this indicate use of this structrue */
     void *fnc_value;
@@ -143,6 +140,7 @@ struct engine_gpg
   char request_origin[10];
   char *auto_key_locate;
   char *trust_model;
+  size_t io_buffer_size;  /* 0 for the default.  */
 
   struct {
     unsigned int no_symkey_cache : 1;
@@ -450,10 +448,8 @@ gpg_release (void *engine)
       gpg->arglist = next;
     }
 
-  if (gpg->status.buffer)
-    free (gpg->status.buffer);
-  if (gpg->colon.buffer)
-    free (gpg->colon.buffer);
+  _gpgme_linebuf_release (&gpg->status.lines);
+  _gpgme_linebuf_release (&gpg->colon.lines);
   if (gpg->argv)
     free_argv (gpg->argv);
   if (gpg->cmd.keyword)
@@ -512,14 +508,9 @@ gpg_new (void **engine, const char *file_name, const char *home_dir,
   gpg->cmd.idx = -1;
 
   /* Allocate the read buffer for the status pipe.  */
-  gpg->status.bufsize = 1024;
-  gpg->status.readpos = 0;
-  gpg->status.buffer = malloc (gpg->status.bufsize);
-  if (!gpg->status.buffer)
-    {
-      rc = gpg_error_from_syserror ();
-      goto leave;
-    }
+  rc = _gpgme_linebuf_init (&gpg->status.lines, 1024);
+  if (rc)
+    goto leave;
   /* In any case we need a status pipe - create it right here and
      don't handle it with our generic gpgme_data_t mechanism.  */
   if (_gpgme_io_pipe (gpg->status.fd, 1) == -1)
@@ -688,6 +679,9 @@ gpg_set_engine_flags (void *engine, const gpgme_ctx_t ctx)
 
   gpg->flags.ignore_mdc_error = !!ctx->ignore_mdc_error;
 
+  gpg->io_buffer_size = (ctx->io_buffer_size
+                         ? strtoul (ctx->io_buffer_size, NULL, 10) : 0);
+
   if (have_gpg_version (gpg, "2.2.20"))
     {
       if (ctx->auto_key_import)
@@ -773,18 +767,16 @@ gpg_set_colon_line_handler (void *engine, engine_colon_line_handler_t fnc,
 			    void *fnc_value)
 {
   engine_gpg_t gpg = engine;
+  gpgme_error_t err;
 
-  gpg->colon.bufsize = 1024;
-  gpg->colon.readpos = 0;
-  gpg->colon.buffer = malloc (gpg->colon.bufsize);
-  if (!gpg->colon.buffer)
-    return gpg_error_from_syserror ();
+  err = _gpgme_linebuf_init (&gpg->colon.lines, 4096);
+  if (err)
+    return err;
 
   if (_gpgme_io_pipe (gpg->colon.fd, 1) == -1)
     {
       int saved_err = gpg_error_from_syserror ();
-      free (gpg->colon.buffer);
-      gpg->colon.buffer = NULL;
+      _gpgme_linebuf_release (&gpg->colon.lines);
       return saved_err;
     }
   if (_gpgme_io_set_close_notify (gpg->colon.fd[0], close_notify_handler, gpg)
@@ -1123,45 +1115,80 @@ build_argv (engine_gpg_t gpg, const char *pgmname)
 
       if (a->data)
 	{
+	  int direct_fd;
+
 	  /* Create a pipe to pass it down to gpg.  */
 	  fd_data_map[datac].inbound = a->inbound;
 
-	  /* Create a pipe.  */
-	  {
-	    int fds[2];
+	  /* If the data object is backed by a plain file descriptor we
+	     pass a duplicate of it to gpg so that we don't need to
+	     touch the data at all.  */
+	  direct_fd = -1;
+	  if (!a->print_fd
+	      && !(gpg->cmd.used && gpg->cmd.cb_data == a->data)
+	      && _gpgme_data_get_direct_fd (a->data) != -1)
+	    {
+	      direct_fd = _gpgme_io_dup (_gpgme_data_get_direct_fd (a->data));
+	      if (direct_fd != -1
+		  && _gpgme_io_set_close_notify (direct_fd,
+						 close_notify_handler, gpg))
+		{
+		  _gpgme_io_close (direct_fd);
+		  direct_fd = -1;
+		}
+	    }
+	  if (direct_fd != -1)
+	    {
+	      fd_data_map[datac].fd      = -1;
+	      fd_data_map[datac].peer_fd = direct_fd;
+	    }
+	  else
+	    {
+	      /* Create a pipe.  */
+	      int fds[2];
 
-	    if (_gpgme_io_pipe (fds, fd_data_map[datac].inbound ? 1 : 0)
-		== -1)
-	      {
-		int saved_err = gpg_error_from_syserror ();
-		free (fd_data_map);
-		free_argv (argv);
-		return saved_err;
-	      }
-	    if (_gpgme_io_set_close_notify (fds[0],
-					    close_notify_handler, gpg)
-		|| _gpgme_io_set_close_notify (fds[1],
-					       close_notify_handler,
-					       gpg))
-	      {
-                /* We leak fd_data_map and the fds.  This is not easy
-                   to avoid and given that we reach this here only
-                   after a malloc failure for a small object, it is
-                   probably better not to do anything.  */
-		return gpg_error (GPG_ERR_GENERAL);
-	      }
-	    /* If the data_type is FD, we have to do a dup2 here.  */
-	    if (fd_data_map[datac].inbound)
-	      {
-		fd_data_map[datac].fd       = fds[0];
-		fd_data_map[datac].peer_fd  = fds[1];
-	      }
-	    else
-	      {
-		fd_data_map[datac].fd       = fds[1];
-		fd_data_map[datac].peer_fd  = fds[0];
-	      }
-	  }
+	      if (_gpgme_io_pipe (fds, fd_data_map[datac].inbound ? 1 : 0)
+		  == -1)
+		{
+		  int saved_err = gpg_error_from_syserror ();
+		  free (fd_data_map);
+		  free_argv (argv);
+		  return saved_err;
+		}
+	      if (_gpgme_io_set_close_notify (fds[0],
+					      close_notify_handler, gpg)
+		  || _gpgme_io_set_close_notify (fds[1],
+						 close_notify_handler,
+						 gpg))
+		{
+		  /* We leak fd_data_map and the fds.  This is not easy
+		     to avoid and given that we reach this here only
+		     after a malloc failure for a small object, it is
+		     probably better not to do anything.  */
+		  return gpg_error (GPG_ERR_GENERAL);
+		}
+	      err = _gpgme_data_set_io_buffer_size (a->data,
+						    gpg->io_buffer_size);
+	      if (err)
+		{
+		  free (fd_data_map);
+		  free_argv (argv);
+		  return err;
+		}
+	      if (gpg->io_buffer_size)
+		_gpgme_io_set_pipe_size (fds[0], gpg->io_buffer_size);
+	      /* If the data_type is FD, we have to do a dup2 here.  */
+	      if (fd_data_map[datac].inbound)
+		{
+		  fd_data_map[datac].fd       = fds[0];
+		  fd_data_map[datac].peer_fd  = fds[1];
+		}
+	      else
+		{
+		  fd_data_map[datac].fd       = fds[1];
+		  fd_data_map[datac].peer_fd  = fds[0];
+		}
+	    }
 
 	  /* Hack to get hands on the fd later.  */
 	  if (gpg->cmd.used)
@@ -1255,25 +1282,16 @@ add_io_cb (engine_gpg_t gpg, int fd, int dir, gpgme_io_cb_t handler, void *data,
 static gpgme_error_t
 read_status (engine_gpg_t gpg)
 {
-  char *p;
+  char *buffer, *p;
+  size_t len;
   int nread;
-  size_t bufsize = gpg->status.bufsize;
-  char *buffer = gpg->status.buffer;
-  size_t readpos = gpg->status.readpos;
   gpgme_error_t err;
 
-  assert (buffer);
-  if (bufsize - readpos < 256)
-    {
-      /* Need more room for the read.  */
-      bufsize += 1024;
-      buffer = realloc (buffer, bufsize);
-      if (!buffer)
-	return gpg_error_from_syserror ();
-    }
+  buffer = _gpgme_linebuf_space (&gpg->status.lines, &len);
+  if (!buffer)
+    return gpg_error_from_syserror ();
 
-  nread = _gpgme_io_read (gpg->status.fd[0],
-			  buffer + readpos, bufsize-readpos);
+  nread = _gpgme_io_read (gpg->status.fd[0], buffer, len);
   if (nread == -1)
     return gpg_error_from_syserror ();
 
@@ -1295,96 +1313,75 @@ read_status (engine_gpg_t gpg)
       return err;
     }
 
-  while (nread > 0)
+  _gpgme_linebuf_commit (&gpg->status.lines, nread);
+
+  /* (we require that the last line is terminated by a LF) */
+  while ((buffer = _gpgme_linebuf_getline (&gpg->status.lines, &len)))
     {
-      for (p = buffer + readpos; nread; nread--, p++)
-	{
-	  if (*p == '\n')
-	    {
-	      /* (we require that the last line is terminated by a LF) */
-	      if (p > buffer && p[-1] == '\r')
-		p[-1] = 0;
-	      *p = 0;
-	      if (!strncmp (buffer, "[GNUPG:] ", 9)
-		  && buffer[9] >= 'A' && buffer[9] <= 'Z')
-		{
-		  char *rest;
-		  gpgme_status_code_t r;
-
-		  rest = strchr (buffer + 9, ' ');
-		  if (!rest)
-		    rest = p; /* Set to an empty string.  */
-		  else
-		    *rest++ = 0;
-
-		  r = _gpgme_parse_status (buffer + 9);
-                  if (gpg->status.mon_cb && r != GPGME_STATUS_PROGRESS)
-                    {
-                      /* Note that we call the monitor even if we do
-                       * not know the status code (r < 0).  */
-                      err = gpg->status.mon_cb (gpg->status.mon_cb_value,
-                                                buffer + 9, rest);
-                      if (err)
-                        return err;
-                    }
-		  if (r >= 0)
-		    {
-		      if (gpg->cmd.used
-			  && (r == GPGME_STATUS_GET_BOOL
-			      || r == GPGME_STATUS_GET_LINE
-			      || r == GPGME_STATUS_GET_HIDDEN))
-			{
-			  gpg->cmd.code = r;
-			  if (gpg->cmd.keyword)
-			    free (gpg->cmd.keyword);
-			  gpg->cmd.keyword = strdup (rest);
-			  if (!gpg->cmd.keyword)
-			    return gpg_error_from_syserror ();
-			  /* This should be the last thing we have
-			     received and the next thing will be that
-			     the command handler does its action.  */
-			  if (nread > 1)
-			    TRACE (DEBUG_CTX, "gpgme:read_status", 0,
-				    "error: unexpected data");
-
-			  add_io_cb (gpg, gpg->cmd.fd, 0,
-				     command_handler, gpg,
-				     &gpg->fd_data_map[gpg->cmd.idx].tag);
-			  gpg->fd_data_map[gpg->cmd.idx].fd = gpg->cmd.fd;
-			  gpg->cmd.fd = -1;
-                        }
-		      else if (gpg->status.fnc)
-			{
-			  err = gpg->status.fnc (gpg->status.fnc_value,
-						 r, rest);
-                          if (gpg_err_code (err) == GPG_ERR_FALSE)
-                            err = 0; /* Drop special error code.  */
-			  if (err)
-			    return err;
-                        }
-                    }
+      p = buffer + len;
+      if (len && p[-1] == '\r')
+        p[-1] = 0;
+      if (!strncmp (buffer, "[GNUPG:] ", 9)
+          && buffer[9] >= 'A' && buffer[9] <= 'Z')
+        {
+          char *rest;
+          gpgme_status_code_t r;
+
+          rest = strchr (buffer + 9, ' ');
+          if (!rest)
+            rest = p; /* Set to an empty string.  */
+          else
+            *rest++ = 0;
+
+          r = _gpgme_parse_status (buffer + 9);
+          if (gpg->status.mon_cb && r != GPGME_STATUS_PROGRESS)
+            {
+              /* Note that we call the monitor even if we do
+               * not know the status code (r < 0).  */
+              err = gpg->status.mon_cb (gpg->status.mon_cb_value,
+                                        buffer + 9, rest);
+              if (err)
+                return err;
+            }
+          if (r >= 0)
+            {
+              if (gpg->cmd.used
+                  && (r == GPGME_STATUS_GET_BOOL
+                      || r == GPGME_STATUS_GET_LINE
+                      || r == GPGME_STATUS_GET_HIDDEN))
+                {
+                  gpg->cmd.code = r;
+                  if (gpg->cmd.keyword)
+                    free (gpg->cmd.keyword);
+                  gpg->cmd.keyword = strdup (rest);
+                  if (!gpg->cmd.keyword)
+                    return gpg_error_from_syserror ();
+                  /* This should be the last thing we have
+                     received and the next thing will be that
+                     the command handler does its action.  */
+                  if (_gpgme_linebuf_pending (&gpg->status.lines))
+                    TRACE (DEBUG_CTX, "gpgme:read_status", 0,
+                           "error: unexpected data");
+
+                  add_io_cb (gpg, gpg->cmd.fd, 0,
+                             command_handler, gpg,
+                             &gpg->fd_data_map[gpg->cmd.idx].tag);
+                  gpg->fd_data_map[gpg->cmd.idx].fd = gpg->cmd.fd;
+                  gpg->cmd.fd = -1;
+                }
+              else if (gpg->status.fnc)
+                {
+                  err = gpg->status.fnc (gpg->status.fnc_value,
+                                         r, rest);
+                  if (gpg_err_code (err) == GPG_ERR_FALSE)
+                    err = 0; /* Drop special error code.  */
+                  if (err)
+                    return err;
                 }
-	      /* To reuse the buffer for the next line we have to
-		 shift the remaining data to the buffer start and
-		 restart the loop Hmmm: We can optimize this function
-		 by looking forward in the buffer to see whether a
-		 second complete line is available and in this case
-		 avoid the memmove for this line.  */
-	      nread--; p++;
-	      if (nread)
-		memmove (buffer, p, nread);
-	      readpos = 0;
-	      break; /* the for loop */
             }
-	  else
-	    readpos++;
         }
     }
 
-  /* Update the gpg object.  */
-  gpg->status.bufsize = bufsize;
-  gpg->status.buffer = buffer;
-  gpg->status.readpos = readpos;
   return 0;
 }
 
@@ -1409,23 +1406,15 @@ status_handler (void *opaque, int fd)
 static gpgme_error_t
 read_colon_line (engine_gpg_t gpg)
 {
-  char *p;
+  char *buffer;
+  size_t len;
   int nread;
-  size_t bufsize = gpg->colon.bufsize;
-  char *buffer = gpg->colon.buffer;
-  size_t readpos = gpg->colon.readpos;
 
-  assert (buffer);
-  if (bufsize - readpos < 256)
-    {
-      /* Need more room for the read.  */
-      bufsize += 1024;
-      buffer = realloc (buffer, bufsize);
-      if (!buffer)
-	return gpg_error_from_syserror ();
-    }
+  buffer = _gpgme_linebuf_space (&gpg->colon.lines, &len);
+  if (!buffer)
+    return gpg_error_from_syserror ();
 
-  nread = _gpgme_io_read (gpg->colon.fd[0], buffer+readpos, bufsize-readpos);
+  nread = _gpgme_io_read (gpg->colon.fd[0], buffer, len);
   if (nread == -1)
     return gpg_error_from_syserror ();
 
@@ -1437,74 +1426,50 @@ read_colon_line (engine_gpg_t gpg)
       return 0;
     }
 
-  while (nread > 0)
+  _gpgme_linebuf_commit (&gpg->colon.lines, nread);
+
+  /* (we require that the last line is terminated by a LF) and we
+     skip empty lines.  Note: we use UTF8 encoding and escaping of
+     special characters.  We require at least one colon to cope with
+     some other printed information.  */
+  while ((buffer = _gpgme_linebuf_getline (&gpg->colon.lines, &len)))
     {
-      for (p = buffer + readpos; nread; nread--, p++)
-	{
-	  if ( *p == '\n' )
-	    {
-	      /* (we require that the last line is terminated by a LF)
-		 and we skip empty lines.  Note: we use UTF8 encoding
-		 and escaping of special characters.  We require at
-		 least one colon to cope with some other printed
-		 information.  */
-	      *p = 0;
-	      if (*buffer && strchr (buffer, ':'))
-		{
-		  char *line = NULL;
-
-		  if (gpg->colon.preprocess_fnc)
-		    {
-		      gpgme_error_t err;
-
-		      err = gpg->colon.preprocess_fnc (buffer, &line);
-		      if (err)
-			return err;
-		    }
-
-		  assert (gpg->colon.fnc);
-                  if (line)
-                    {
-                      char *linep = line;
-                      char *endp;
-
-                      do
-                        {
-                          endp = strchr (linep, '\n');
-                          if (endp)
-                            *endp++ = 0;
-                          gpg->colon.fnc (gpg->colon.fnc_value, linep);
-                          linep = endp;
-                        }
-                      while (linep && *linep);
-
-                      gpgrt_free (line);
-                    }
-                  else
-                    gpg->colon.fnc (gpg->colon.fnc_value, buffer);
+      if (*buffer && strchr (buffer, ':'))
+        {
+          char *line = NULL;
+
+          if (gpg->colon.preprocess_fnc)
+            {
+              gpgme_error_t err;
+
+              err = gpg->colon.preprocess_fnc (buffer, &line);
+              if (err)
+                return err;
+            }
+
+          assert (gpg->colon.fnc);
+          if (line)
+            {
+              char *linep = line;
+              char *endp;
+
+              do
+                {
+                  endp = strchr (linep, '\n');
+                  if (endp)
+                    *endp++ = 0;
+                  gpg->colon.fnc (gpg->colon.fnc_value, linep);
+                  linep = endp;
                 }
+              while (linep && *linep);
 
-	      /* To reuse the buffer for the next line we have to
-		 shift the remaining data to the buffer start and
-		 restart the loop Hmmm: We can optimize this function
-		 by looking forward in the buffer to see whether a
-		 second complete line is available and in this case
-		 avoid the memmove for this line.  */
-	      nread--; p++;
-	      if (nread)
-		memmove (buffer, p, nread);
-	      readpos = 0;
-	      break; /* The for loop.  */
+              gpgrt_free (line);
             }
-	  else
-	    readpos++;
+          else
+            gpg->colon.fnc (gpg->colon.fnc_value, buffer);
         }
     }
 
-  /* Update the gpg object.  */
-  gpg->colon.bufsize = bufsize;
-  gpg->colon.buffer  = buffer;
-  gpg->colon.readpos = readpos;
   return 0;
 }
 
@@ -1635,7 +1600,7 @@ start (engine_gpg_t gpg)
 	  gpg->cmd.fd = gpg->fd_data_map[i].fd;
 	  gpg->fd_data_map[i].fd = -1;
 	}
-      else
+      else if (gpg->fd_data_map[i].fd != -1)
 	{
 	  rc = add_io_cb (gpg, gpg->fd_data_map[i].fd,
 			  gpg->fd_data_map[i].inbound,
@@ -2845,23 +2810,16 @@ gpg_keylist_preprocess (char *line, char **r_line)
 
   *r_line = NULL;
 
-  while (line && fields < NR_FIELDS)
+  fields = _gpgme_split_colon_fields (line, field, NR_FIELDS);
+
+  switch (_gpgme_colon_rectype (field[0]))
     {
-      field[fields++] = line;
-      line = strchr (line, ':');
-      if (line)
-	*(line++) = '\0';
+    case COLON_RECTYPE ('i','n','f','o'): rectype = RT_INFO; break;
+    case COLON_RECTYPE ('p','u','b',0): rectype = RT_PUB; break;
+    case COLON_RECTYPE ('u','i','d',0): rectype = RT_UID; break;
+    default: rectype = RT_NONE; break;
     }
 
-  if (!strcmp (field[0], "info"))
-    rectype = RT_INFO;
-  else if (!strcmp (field[0], "pub"))
-    rectype = RT_PUB;
-  else if (!strcmp (field[0], "uid"))
-    rectype = RT_UID;
-  else
-    rectype = RT_NONE;
-
   switch (rectype)
     {
     case RT_INFO:
@@ -3009,7 +2967,8 @@ gpg_keylist_build_options (engine_gpg_t gpg, int secret_only,
   if (!err && (mode & GPGME_KEYLIST_MODE_WITH_SECRET))
     {
       err = add_arg (gpg, "--with-secret");
-      err = add_arg (gpg, "--with-keygrip");
+      if (!err)
+        err = add_arg (gpg, "--with-keygrip");
     }
   else if (!err && (mode & GPGME_KEYLIST_MODE_WITH_KEYGRIP))
     {
@@ -3529,5 +3488,7 @@ struct engine_ops _gpgme_engine_ops_gpg =
     NULL,		/* cancel_op */
     gpg_passwd,
     gpg_set_pinentry_mode,
-    NULL                /* opspawn */
+    NULL,               /* opspawn */
+    NULL,               /* idle */
+    NULL                /* reuse */
   };
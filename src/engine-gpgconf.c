@@ -351,13 +351,7 @@ gpgconf_config_load_cb (void *hook, char *line)
   char *field[NR_FIELDS];
   int fields = 0;
 
-  while (line && fields < NR_FIELDS)
-    {
-      field[fields++] = line;
-      line = strchr (line, ':');
-      if (line)
-	*(line++) = '\0';
-    }
+  fields = _gpgme_split_colon_fields (line, field, NR_FIELDS);
 
   /* We require at least the first 3 fields.  */
   if (fields < 2)
@@ -478,13 +472,7 @@ gpgconf_config_load_cb2 (void *hook, char *line)
   char *field[NR_FIELDS];
   int fields = 0;
 
-  while (line && fields < NR_FIELDS)
-    {
-      field[fields++] = line;
-      line = strchr (line, ':');
-      if (line)
-	*(line++) = '\0';
-    }
+  fields = _gpgme_split_colon_fields (line, field, NR_FIELDS);
 
   /* We require at least the first 10 fields.  */
   if (fields < 10)
@@ -1050,13 +1038,7 @@ parse_swdb_line (char *line, gpgme_query_swdb_result_t result)
   int fields = 0;
   gpg_err_code_t ec;
 
-  while (line && fields < DIM (field))
-    {
-      field[fields++] = line;
-      line = strchr (line, ':');
-      if (line)
-	*line++ = 0;
-    }
+  fields = _gpgme_split_colon_fields (line, field, DIM (field));
   /* We require that all fields exists - gpgme emits all these fields
    * even on error.  They might be empty, though. */
   if (fields < 9)
@@ -1318,5 +1300,7 @@ struct engine_ops _gpgme_engine_ops_gpgconf =
     NULL,               /* cancel_op */
     NULL,               /* passwd */
     NULL,               /* set_pinentry_mode */
-    NULL                /* opspawn */
+    NULL,               /* opspawn */
+    NULL,               /* idle */
+    NULL                /* reuse */
   };
@@ -45,6 +45,7 @@
 #include "priv-io.h"
 #include "sema.h"
 #include "data.h"
+#include "linebuf.h"
 
 #include "assuan.h"
 #include "debug.h"
@@ -103,11 +104,18 @@ struct engine_gpgsm
       int linelen;
     } attic;
     int any; /* any data line seen */
+    int to_output;  /* The listing is read from OUTPUT_CB.  */
+    struct linebuf_s lines;  /* Used to split the data of OUTPUT_CB.  */
   } colon;
 
   gpgme_data_t inline_data;  /* Used to collect D lines.  */
 
   char request_origin[10];
+  int request_origin_sent;  /* REQUEST_ORIGIN has been sent to gpgsm.  */
+
+  /* Set if an option was sent which can't be reverted.  Such an
+     engine is not put into the engine pool.  */
+  int no_reuse;
 
   struct gpgme_io_cbs io_cbs;
 
@@ -181,6 +189,7 @@ close_notify_handler (int fd, void *opaque)
 	(*gpgsm->io_cbs.remove) (gpgsm->output_cb.tag);
       gpgsm->output_cb.fd = -1;
       gpgsm->output_cb.tag = NULL;
+      gpgsm->colon.to_output = 0;
     }
   else if (gpgsm->message_cb.fd == fd)
     {
@@ -257,6 +266,7 @@ gpgsm_release (void *engine)
   gpgme_data_release (gpgsm->diagnostics);
 
   free (gpgsm->colon.attic.line);
+  _gpgme_linebuf_release (&gpgsm->colon.lines);
   free (gpgsm);
 }
 
@@ -657,20 +667,23 @@ gpgsm_set_locale (void *engine, int category, const char *value)
 }
 
 
+/* Read the response to a command from GPGSM and pass the status
+   lines to STATUS_FNC.  Returns the error from the ERR line or the
+   callback.  If R_SYNCED is not NULL, 1 is stored there if the entire
+   response has been consumed, that is an OK or ERR line was read, so
+   that the response to another command can follow.  */
 static gpgme_error_t
-gpgsm_assuan_simple_command (engine_gpgsm_t gpgsm, const char *cmd,
-			     engine_status_handler_t status_fnc,
-			     void *status_fnc_value)
+gpgsm_assuan_read_response (engine_gpgsm_t gpgsm,
+                            engine_status_handler_t status_fnc,
+                            void *status_fnc_value, int *r_synced)
 {
   assuan_context_t ctx = gpgsm->assuan_ctx;
   gpg_error_t err, cb_err;
   char *line;
   size_t linelen;
 
-  err = assuan_write_line (ctx, cmd);
-  if (err)
-    return err;
-
+  if (r_synced)
+    *r_synced = 0;
   cb_err = 0;
   do
     {
@@ -684,7 +697,11 @@ gpgsm_assuan_simple_command (engine_gpgsm_t gpgsm, const char *cmd,
       if (linelen >= 2
 	  && line[0] == 'O' && line[1] == 'K'
 	  && (line[2] == '\0' || line[2] == ' '))
-	break;
+        {
+          if (r_synced)
+            *r_synced = 1;
+          break;
+        }
       else if (linelen >= 4
 	  && line[0] == 'E' && line[1] == 'R' && line[2] == 'R'
 	  && line[3] == ' ')
@@ -694,6 +711,8 @@ gpgsm_assuan_simple_command (engine_gpgsm_t gpgsm, const char *cmd,
              than the error returned by the engine.  */
           err = cb_err? cb_err : atoi (&line[4]);
           cb_err = 0;
+          if (r_synced)
+            *r_synced = 1;
         }
       else if (linelen >= 2
 	       && line[0] == 'S' && line[1] == ' ')
@@ -744,6 +763,69 @@ gpgsm_assuan_simple_command (engine_gpgsm_t gpgsm, const char *cmd,
 }
 
 
+static gpgme_error_t
+gpgsm_assuan_simple_command (engine_gpgsm_t gpgsm, const char *cmd,
+			     engine_status_handler_t status_fnc,
+			     void *status_fnc_value)
+{
+  gpg_error_t err;
+
+  err = assuan_write_line (gpgsm->assuan_ctx, cmd);
+  if (err)
+    return err;
+
+  return gpgsm_assuan_read_response (gpgsm, status_fnc, status_fnc_value,
+                                     NULL);
+}
+
+
+/* Send the NCMDS commands CMDS to GPGSM without waiting for the
+   response to each command before sending the next one and then
+   collect the responses in order.  The result of the I-th command is
+   stored at ERRS[I].  At most PIPELINE_DEPTH commands are outstanding
+   so that neither side can block on a full socket buffer.  The return
+   value is only set if the connection failed or got out of sync; in
+   this case the ERRS of the commands without a response are set to
+   that error too.  */
+#define PIPELINE_DEPTH 32
+static gpgme_error_t
+gpgsm_assuan_pipelined_commands (engine_gpgsm_t gpgsm,
+                                 char **cmds, int ncmds, gpgme_error_t *errs,
+                                 engine_status_handler_t status_fnc,
+                                 void *status_fnc_value)
+{
+  gpg_error_t err = 0;
+  int sent = 0;
+  int done = 0;
+  int synced;
+
+  while (done < ncmds)
+    {
+      while (sent < ncmds && sent - done < PIPELINE_DEPTH)
+        {
+          err = assuan_write_line (gpgsm->assuan_ctx, cmds[sent]);
+          if (err)
+            goto leave;
+          sent++;
+        }
+
+      errs[done] = gpgsm_assuan_read_response (gpgsm, status_fnc,
+                                               status_fnc_value, &synced);
+      if (!synced)
+        {
+          err = errs[done];
+          goto leave;
+        }
+      done++;
+    }
+
+ leave:
+  for (; done < ncmds; done++)
+    errs[done] = err;
+  return err;
+}
+
+
 typedef enum { INPUT_FD, OUTPUT_FD, MESSAGE_FD } fd_type_t;
 
 static void
@@ -935,9 +1017,8 @@ status_handler (void *opaque, int fd)
             {
               /* We must tell a colon function about the EOF. We do
                  this only when we have seen any data lines.  Note
-                 that this inlined use of colon data lines will
-                 eventually be changed into using a regular data
-                 channel. */
+                 that key listings use the output channel if gpgsm
+                 supports it; see set_colon_output.  */
               gpgsm->colon.any = 0;
               err = gpgsm->colon.fnc (gpgsm->colon.fnc_value, NULL);
             }
@@ -1121,6 +1202,49 @@ status_handler (void *opaque, int fd)
 }
 
 
+/* Read the key listing gpgsm writes to the output fd and pass it
+   line by line to the colon handler.  Unlike the D lines used
+   otherwise the data needs no unescaping.  */
+static gpgme_error_t
+colon_output_handler (void *opaque, int fd)
+{
+  struct io_cb_data *data = (struct io_cb_data *) opaque;
+  engine_gpgsm_t gpgsm = (engine_gpgsm_t) data->handler_value;
+  gpgme_error_t err = 0;
+  char *buffer;
+  size_t len;
+  int nread;
+
+  buffer = _gpgme_linebuf_space (&gpgsm->colon.lines, &len);
+  if (!buffer)
+    return gpg_error_from_syserror ();
+
+  nread = _gpgme_io_read (fd, buffer, len);
+  if (nread == -1)
+    return gpg_error_from_syserror ();
+
+  if (!nread)
+    {
+      /* Tell the colon function about the EOF.  */
+      err = gpgsm->colon.fnc (gpgsm->colon.fnc_value, NULL);
+      _gpgme_io_close (fd);
+      return err;
+    }
+
+  _gpgme_linebuf_commit (&gpgsm->colon.lines, nread);
+  while (!err && (buffer = _gpgme_linebuf_getline (&gpgsm->colon.lines,
+                                                   &len)))
+    {
+      if (len && buffer[len - 1] == '\r')
+        buffer[--len] = 0;
+      if (len)
+        err = gpgsm->colon.fnc (gpgsm->colon.fnc_value, buffer);
+    }
+
+  return err;
+}
+
+
 static gpgme_error_t
 add_io_cb (engine_gpgsm_t gpgsm, iocb_data_t *iocbd, gpgme_io_cb_t handler)
 {
@@ -1159,7 +1283,9 @@ start (engine_gpgsm_t gpgsm, const char *command)
         return gpg_error_from_syserror ();
       err = gpgsm_assuan_simple_command (gpgsm, cmd, NULL, NULL);
       free (cmd);
-      if (err && gpg_err_code (err) != GPG_ERR_UNKNOWN_OPTION)
+      if (!err)
+        gpgsm->request_origin_sent = 1;
+      else if (gpg_err_code (err) != GPG_ERR_UNKNOWN_OPTION)
         return err;
     }
 
@@ -1200,7 +1326,9 @@ start (engine_gpgsm_t gpgsm, const char *command)
   if (!err && gpgsm->input_cb.fd != -1)
     err = add_io_cb (gpgsm, &gpgsm->input_cb, _gpgme_data_outbound_handler);
   if (!err && gpgsm->output_cb.fd != -1)
-    err = add_io_cb (gpgsm, &gpgsm->output_cb, _gpgme_data_inbound_handler);
+    err = add_io_cb (gpgsm, &gpgsm->output_cb,
+                     (gpgsm->colon.to_output
+                      ? colon_output_handler : _gpgme_data_inbound_handler));
   if (!err && gpgsm->message_cb.fd != -1)
     err = add_io_cb (gpgsm, &gpgsm->message_cb, _gpgme_data_outbound_handler);
   if (!err && gpgsm->diag_cb.fd != -1)
@@ -1229,6 +1357,62 @@ gpgsm_reset (void *engine)
           ? gpgsm_assuan_simple_command (gpgsm, "RESET", NULL, NULL)
           : 0);
 }
+
+
+static int
+gpgsm_idle (void *engine)
+{
+  engine_gpgsm_t gpgsm = engine;
+
+  return (gpgsm->assuan_ctx
+          && gpgsm->status_cb.fd == -1
+          && gpgsm->input_cb.fd == -1
+          && gpgsm->output_cb.fd == -1
+          && gpgsm->message_cb.fd == -1
+          && !gpgsm->no_reuse);
+}
+
+
+/* Prepare an engine from the engine pool for a new context.  RESET
+   does not revert the options; thus the request origin is set back
+   to the default.  The RESET also checks that gpgsm is still
+   running.  */
+static gpgme_error_t
+gpgsm_reuse (void *engine)
+{
+  engine_gpgsm_t gpgsm = engine;
+  gpgme_data_t diagnostics;
+  gpgme_error_t err;
+
+  gpgsm->status.fnc = NULL;
+  gpgsm->status.fnc_value = NULL;
+  gpgsm->status.mon_cb = NULL;
+  gpgsm->status.mon_cb_value = NULL;
+  gpgsm->colon.fnc = NULL;
+  gpgsm->colon.fnc_value = NULL;
+  gpgsm->inline_data = NULL;
+  *gpgsm->request_origin = 0;
+
+  if (gpgsm->request_origin_sent)
+    {
+      err = gpgsm_assuan_simple_command (gpgsm,
+                                         "OPTION request-origin=local",
+                                         NULL, NULL);
+      if (err)
+        return err;
+      gpgsm->request_origin_sent = 0;
+    }
+
+  /* Do not hand the diagnostics to the new context.  */
+  err = gpgme_data_new (&diagnostics);
+  if (err)
+    return err;
+  gpgme_data_release (gpgsm->diagnostics);
+  gpgsm->diagnostics = diagnostics;
+  gpgsm->diag_cb.data = diagnostics;
+
+  return gpgsm_reset (gpgsm);
+}
 #endif
 
 
@@ -1346,57 +1530,63 @@ static gpgme_error_t
 set_recipients (engine_gpgsm_t gpgsm, gpgme_key_t recp[])
 {
   gpgme_error_t err = 0;
-  char *line;
-  int linelen;
+  gpgme_error_t *errs;
+  char **lines;
+  int nrecp, nlines;
   int invalid_recipients = 0;
   int i;
 
-  linelen = 10 + 40 + 1;	/* "RECIPIENT " + guess + '\0'.  */
-  line = malloc (10 + 40 + 1);
-  if (!line)
-    return gpg_error_from_syserror ();
-  strcpy (line, "RECIPIENT ");
-  for (i =0; !err && recp[i]; i++)
+  for (nrecp = 0; recp[nrecp]; nrecp++)
+    ;
+  lines = calloc (nrecp + 1, sizeof *lines);
+  errs = calloc (nrecp + 1, sizeof *errs);
+  if (!lines || !errs)
     {
-      char *fpr;
-      int newlen;
+      err = gpg_error_from_syserror ();
+      goto leave;
+    }
 
+  for (i = nlines = 0; i < nrecp; i++)
+    {
       if (!recp[i]->subkeys || !recp[i]->subkeys->fpr)
 	{
 	  invalid_recipients++;
 	  continue;
 	}
-      fpr = recp[i]->subkeys->fpr;
-
-      newlen = 11 + strlen (fpr);
-      if (linelen < newlen)
-	{
-	  char *newline = realloc (line, newlen);
-	  if (! newline)
-	    {
-	      int saved_err = gpg_error_from_syserror ();
-	      free (line);
-	      return saved_err;
-	    }
-	  line = newline;
-	  linelen = newlen;
-	}
-      strcpy (&line[10], fpr);
+      lines[nlines] = _gpgme_strconcat ("RECIPIENT ",
+                                        recp[i]->subkeys->fpr, NULL);
+      if (!lines[nlines])
+        {
+          err = gpg_error_from_syserror ();
+          goto leave;
+        }
+      nlines++;
+    }
 
-      err = gpgsm_assuan_simple_command (gpgsm, line, gpgsm->status.fnc,
-					 gpgsm->status.fnc_value);
+  /* Do not wait for the response to each RECIPIENT command.  gpgsm
+     emits the INV_RECP status for a key as part of the response to
+     its command, so the status handler still sees them in order.  */
+  err = gpgsm_assuan_pipelined_commands (gpgsm, lines, nlines, errs,
+                                         gpgsm->status.fnc,
+                                         gpgsm->status.fnc_value);
+  for (i = 0; !err && i < nlines; i++)
+    {
       /* FIXME: This requires more work.  */
-      if (gpg_err_code (err) == GPG_ERR_NO_PUBKEY)
+      if (gpg_err_code (errs[i]) == GPG_ERR_NO_PUBKEY)
 	invalid_recipients++;
-      else if (err)
-	{
-	  free (line);
-	  return err;
-	}
+      else if (errs[i])
+        err = errs[i];
     }
-  free (line);
-  return gpg_error (invalid_recipients
-		    ? GPG_ERR_UNUSABLE_PUBKEY : GPG_ERR_NO_ERROR);
+  if (!err && invalid_recipients)
+    err = gpg_error (GPG_ERR_UNUSABLE_PUBKEY);
+
+ leave:
+  if (lines)
+    for (i = 0; i < nrecp; i++)
+      free (lines[i]);
+  free (lines);
+  free (errs);
+  return err;
 }
 
 
@@ -1406,11 +1596,14 @@ static gpgme_error_t
 set_recipients_from_string (engine_gpgsm_t gpgsm, const char *string)
 {
   gpg_error_t err = 0;
-  char *line = NULL;
+  gpgme_error_t *errs = NULL;
+  char **lines = NULL;
+  int nlines = 0;
+  int size = 0;
   int ignore = 0;
   int any = 0;
   const char *s;
-  int n;
+  int n, i;
 
   do
     {
@@ -1433,25 +1626,53 @@ set_recipients_from_string (engine_gpgsm_t gpgsm, const char *string)
         err = gpg_error (GPG_ERR_UNKNOWN_OPTION);
       else if (n) /* Not empty - use it.  */
         {
-          gpgrt_free (line);
-          if (gpgrt_asprintf (&line, "RECIPIENT %.*s", n, string) < 0)
-            err = gpg_error_from_syserror ();
-          else
+          if (nlines == size)
             {
-              err = gpgsm_assuan_simple_command (gpgsm, line, gpgsm->status.fnc,
-                                                 gpgsm->status.fnc_value);
-              if (!err)
-                any = 1;
+              char **newlines;
+
+              size = size ? 2 * size : 16;
+              newlines = realloc (lines, size * sizeof *lines);
+              if (!newlines)
+                {
+                  err = gpg_error_from_syserror ();
+                  break;
+                }
+              lines = newlines;
             }
+          if (gpgrt_asprintf (&lines[nlines], "RECIPIENT %.*s", n, string) < 0)
+            err = gpg_error_from_syserror ();
+          else
+            nlines++;
         }
 
       string += n + !!s;
     }
   while (!err);
 
+  /* Send all commands at once and take the first error.  */
+  if (!err && nlines)
+    {
+      errs = calloc (nlines, sizeof *errs);
+      if (!errs)
+        err = gpg_error_from_syserror ();
+      else
+        err = gpgsm_assuan_pipelined_commands (gpgsm, lines, nlines, errs,
+                                               gpgsm->status.fnc,
+                                               gpgsm->status.fnc_value);
+      for (i = 0; !err && i < nlines; i++)
+        {
+          err = errs[i];
+          if (!err)
+            any = 1;
+        }
+    }
+
   if (!err && !any)
     err = gpg_error (GPG_ERR_MISSING_KEY);
-  gpgrt_free (line);
+  for (i = 0; i < nlines; i++)
+    gpgrt_free (lines[i]);
+  free (lines);
+  free (errs);
   return err;
 }
 
@@ -1471,6 +1692,7 @@ gpgsm_encrypt (void *engine, gpgme_key_t recp[], const char *recpstring,
 
   if ((flags & GPGME_ENCRYPT_NO_ENCRYPT_TO))
     {
+      gpgsm->no_reuse = 1;
       err = gpgsm_assuan_simple_command (gpgsm,
 					 "OPTION no-encrypt-to", NULL, NULL);
       if (err)
@@ -1795,6 +2017,49 @@ gpgsm_import (void *engine, gpgme_data_t keydata, gpgme_key_t *keyarray)
 }
 
 
+/* Let gpgsm write the key listing to a pipe instead of sending it
+   as D lines which need to be unescaped and reassembled.  If that is
+   not possible the D lines are used.  */
+static gpgme_error_t
+set_colon_output (engine_gpgsm_t gpgsm)
+{
+#if USE_DESCRIPTOR_PASSING
+  gpgme_error_t err;
+
+  gpgsm->colon.to_output = 0;
+  if (!gpgsm->colon.fnc)
+    {
+      gpgsm_clear_fd (gpgsm, OUTPUT_FD);
+      return 0;
+    }
+
+  /* RESET does not reset this option; thus we set it for each
+     listing.  Versions of gpgsm without it use the D lines.  */
+  err = gpgsm_assuan_simple_command (gpgsm, "OPTION list-to-output=1",
+                                     NULL, NULL);
+  if (err)
+    return 0;
+
+  _gpgme_linebuf_release (&gpgsm->colon.lines);
+  err = _gpgme_linebuf_init (&gpgsm->colon.lines, 16384);
+  if (err)
+    return err;
+
+  gpgsm->output_cb.data = NULL;
+  err = gpgsm_set_fd (gpgsm, OUTPUT_FD, NULL);
+  if (err)
+    return err;
+  /* The handler of the pipe needs the engine and not a data object
+     as its value.  */
+  gpgsm->output_cb.data = gpgsm;
+  gpgsm->colon.to_output = 1;
+#else
+  gpgsm_clear_fd (gpgsm, OUTPUT_FD);
+#endif
+  return 0;
+}
+
+
 static gpgme_error_t
 gpgsm_keylist (void *engine, const char *pattern, int secret_only,
 	       gpgme_keylist_mode_t mode, int engine_flags)
@@ -1876,7 +2141,12 @@ gpgsm_keylist (void *engine, const char *pattern, int secret_only,
     }
 
   gpgsm_clear_fd (gpgsm, INPUT_FD);
-  gpgsm_clear_fd (gpgsm, OUTPUT_FD);
+  err = set_colon_output (gpgsm);
+  if (err)
+    {
+      free (line);
+      return err;
+    }
   gpgsm_clear_fd (gpgsm, MESSAGE_FD);
   gpgsm->inline_data = NULL;
 
@@ -2008,7 +2278,12 @@ gpgsm_keylist_ext (void *engine, const char *pattern[], int secret_only,
   *linep = '\0';
 
   gpgsm_clear_fd (gpgsm, INPUT_FD);
-  gpgsm_clear_fd (gpgsm, OUTPUT_FD);
+  err = set_colon_output (gpgsm);
+  if (err)
+    {
+      free (line);
+      return err;
+    }
   gpgsm_clear_fd (gpgsm, MESSAGE_FD);
   gpgsm->inline_data = NULL;
 
@@ -2026,7 +2301,7 @@ gpgsm_sign (void *engine, gpgme_data_t in, gpgme_data_t out,
   engine_gpgsm_t gpgsm = engine;
   gpgme_error_t err;
   char *assuan_cmd;
-  int i;
+  int i, nsigners;
   gpgme_key_t key;
 
   (void)use_textmode;
@@ -2045,27 +2320,53 @@ gpgsm_sign (void *engine, gpgme_data_t in, gpgme_data_t out,
       if (gpgrt_asprintf (&assuan_cmd,
                           "OPTION include-certs %i", include_certs) < 0)
 	return gpg_error_from_syserror ();
+      gpgsm->no_reuse = 1;
       err = gpgsm_assuan_simple_command (gpgsm, assuan_cmd, NULL, NULL);
       gpgrt_free (assuan_cmd);
       if (err)
 	return err;
     }
 
-  for (i = 0; (key = gpgme_signers_enum (ctx, i)); i++)
+  /* As with the recipients the SIGNER commands are sent at once.  */
+  nsigners = gpgme_signers_count (ctx);
+  if (nsigners)
     {
-      const char *s = key->subkeys ? key->subkeys->fpr : NULL;
-      if (s && strlen (s) < 80)
-	{
-          char buf[100];
+      char **lines;
+      gpgme_error_t *errs;
 
-          strcpy (stpcpy (buf, "SIGNER "), s);
-          err = gpgsm_assuan_simple_command (gpgsm, buf,
-                                             gpgsm->status.fnc,
-                                             gpgsm->status.fnc_value);
-	}
+      lines = calloc (nsigners, sizeof *lines);
+      errs = calloc (nsigners, sizeof *errs);
+      if (!lines || !errs)
+        err = gpg_error_from_syserror ();
       else
-        err = gpg_error (GPG_ERR_INV_VALUE);
-      gpgme_key_unref (key);
+        err = 0;
+      for (i = 0; !err && i < nsigners; i++)
+        {
+          const char *s;
+
+          key = gpgme_signers_enum (ctx, i);
+          s = key && key->subkeys ? key->subkeys->fpr : NULL;
+          if (s && strlen (s) < 80)
+            {
+              lines[i] = _gpgme_strconcat ("SIGNER ", s, NULL);
+              if (!lines[i])
+                err = gpg_error_from_syserror ();
+            }
+          else
+            err = gpg_error (GPG_ERR_INV_VALUE);
+          gpgme_key_unref (key);
+        }
+      if (!err)
+        err = gpgsm_assuan_pipelined_commands (gpgsm, lines, nsigners, errs,
+                                               gpgsm->status.fnc,
+                                               gpgsm->status.fnc_value);
+      for (i = 0; !err && i < nsigners; i++)
+        err = errs[i];
+      if (lines)
+        for (i = 0; i < nsigners; i++)
+          free (lines[i]);
+      free (lines);
+      free (errs);
       if (err)
         return err;
     }
@@ -2338,5 +2639,12 @@ struct engine_ops _gpgme_engine_ops_gpgsm =
     NULL,		/* cancel_op */
     gpgsm_passwd,
     NULL,               /* set_pinentry_mode */
-    NULL                /* opspawn */
+    NULL,               /* opspawn */
+#if USE_DESCRIPTOR_PASSING
+    gpgsm_idle,
+    gpgsm_reuse
+#else
+    NULL,               /* idle */
+    NULL                /* reuse */
+#endif
   };
@@ -469,19 +469,21 @@ uiserver_set_protocol (void *engine, gpgme_protocol_t protocol)
 }
 
 
+/* Read the response to a command from the UI server and pass the
+   status lines to STATUS_FNC.  If R_SYNCED is not NULL, 1 is stored
+   there if the entire response has been consumed.  */
 static gpgme_error_t
-uiserver_assuan_simple_command (engine_uiserver_t uiserver, const char *cmd,
-                                engine_status_handler_t status_fnc,
-                                void *status_fnc_value)
+uiserver_assuan_read_response (engine_uiserver_t uiserver,
+                               engine_status_handler_t status_fnc,
+                               void *status_fnc_value, int *r_synced)
 {
   assuan_context_t ctx = uiserver->assuan_ctx;
   gpg_error_t err;
   char *line;
   size_t linelen;
 
-  err = assuan_write_line (ctx, cmd);
-  if (err)
-    return err;
+  if (r_synced)
+    *r_synced = 0;
 
   do
     {
@@ -495,11 +497,19 @@ uiserver_assuan_simple_command (engine_uiserver_t uiserver, const char *cmd,
       if (linelen >= 2
 	  && line[0] == 'O' && line[1] == 'K'
 	  && (line[2] == '\0' || line[2] == ' '))
-	return 0;
+        {
+          if (r_synced)
+            *r_synced = 1;
+          return 0;
+        }
       else if (linelen >= 4
 	  && line[0] == 'E' && line[1] == 'R' && line[2] == 'R'
 	  && line[3] == ' ')
-	err = atoi (&line[4]);
+        {
+          err = atoi (&line[4]);
+          if (r_synced)
+            *r_synced = 1;
+        }
       else if (linelen >= 2
 	       && line[0] == 'S' && line[1] == ' ')
 	{
@@ -537,6 +547,68 @@ uiserver_assuan_simple_command (engine_uiserver_t uiserver, const char *cmd,
 }
 
 
+static gpgme_error_t
+uiserver_assuan_simple_command (engine_uiserver_t uiserver, const char *cmd,
+                                engine_status_handler_t status_fnc,
+                                void *status_fnc_value)
+{
+  gpg_error_t err;
+
+  err = assuan_write_line (uiserver->assuan_ctx, cmd);
+  if (err)
+    return err;
+
+  return uiserver_assuan_read_response (uiserver, status_fnc,
+                                        status_fnc_value, NULL);
+}
+
+
+/* Send the NCMDS commands CMDS to the UI server without waiting for
+   the response to each command before sending the next one and
+   collect the responses in order at ERRS.  At most PIPELINE_DEPTH
+   commands are outstanding.  If the connection failed or got out of
+   sync, the error is returned and stored for all commands without a
+   response.  */
+#define PIPELINE_DEPTH 32
+static gpgme_error_t
+uiserver_assuan_pipelined_commands (engine_uiserver_t uiserver,
+                                    char **cmds, int ncmds,
+                                    gpgme_error_t *errs,
+                                    engine_status_handler_t status_fnc,
+                                    void *status_fnc_value)
+{
+  gpg_error_t err = 0;
+  int sent = 0;
+  int done = 0;
+  int synced;
+
+  while (done < ncmds)
+    {
+      while (sent < ncmds && sent - done < PIPELINE_DEPTH)
+        {
+          err = assuan_write_line (uiserver->assuan_ctx, cmds[sent]);
+          if (err)
+            goto leave;
+          sent++;
+        }
+
+      errs[done] = uiserver_assuan_read_response (uiserver, status_fnc,
+                                                  status_fnc_value, &synced);
+      if (!synced)
+        {
+          err = errs[done];
+          goto leave;
+        }
+      done++;
+    }
+
+ leave:
+  for (; done < ncmds; done++)
+    errs[done] = err;
+  return err;
+}
+
+
 typedef enum { INPUT_FD, OUTPUT_FD, MESSAGE_FD } fd_type_t;
 
 #define COMMANDLINELEN 40
@@ -1019,20 +1091,25 @@ static gpgme_error_t
 set_recipients (engine_uiserver_t uiserver, gpgme_key_t recp[])
 {
   gpgme_error_t err = 0;
-  char *line;
-  int linelen;
+  gpgme_error_t *errs;
+  char **lines;
+  int nrecp, nlines;
   int invalid_recipients = 0;
   int i;
 
-  linelen = 10 + 40 + 1;	/* "RECIPIENT " + guess + '\0'.  */
-  line = malloc (10 + 40 + 1);
-  if (!line)
-    return gpg_error_from_syserror ();
-  strcpy (line, "RECIPIENT ");
-  for (i=0; !err && recp[i]; i++)
+  for (nrecp = 0; recp[nrecp]; nrecp++)
+    ;
+  lines = calloc (nrecp + 1, sizeof *lines);
+  errs = calloc (nrecp + 1, sizeof *errs);
+  if (!lines || !errs)
+    {
+      err = gpg_error_from_syserror ();
+      goto leave;
+    }
+
+  for (i = nlines = 0; i < nrecp; i++)
     {
       char *uid;
-      int newlen;
 
       /* We use only the first user ID of the key.  */
       if (!recp[i]->uids || !(uid=recp[i]->uids->uid) || !*uid)
@@ -1041,37 +1118,38 @@ set_recipients (engine_uiserver_t uiserver, gpgme_key_t recp[])
 	  continue;
 	}
 
-      newlen = 11 + strlen (uid);
-      if (linelen < newlen)
-	{
-	  char *newline = realloc (line, newlen);
-	  if (! newline)
-	    {
-	      int saved_err = gpg_error_from_syserror ();
-	      free (line);
-	      return saved_err;
-	    }
-	  line = newline;
-	  linelen = newlen;
-	}
       /* FIXME: need to do proper escaping  */
-      strcpy (&line[10], uid);
+      lines[nlines] = _gpgme_strconcat ("RECIPIENT ", uid, NULL);
+      if (!lines[nlines])
+        {
+          err = gpg_error_from_syserror ();
+          goto leave;
+        }
+      nlines++;
+    }
 
-      err = uiserver_assuan_simple_command (uiserver, line,
+  /* Send all RECIPIENT commands at once.  */
+  err = uiserver_assuan_pipelined_commands (uiserver, lines, nlines, errs,
                                             uiserver->status.fnc,
                                             uiserver->status.fnc_value);
+  for (i = 0; !err && i < nlines; i++)
+    {
       /* FIXME: This might requires more work.  */
-      if (gpg_err_code (err) == GPG_ERR_NO_PUBKEY)
+      if (gpg_err_code (errs[i]) == GPG_ERR_NO_PUBKEY)
 	invalid_recipients++;
-      else if (err)
-	{
-	  free (line);
-	  return err;
-	}
+      else if (errs[i])
+        err = errs[i];
     }
-  free (line);
-  return gpg_error (invalid_recipients
-		    ? GPG_ERR_UNUSABLE_PUBKEY : GPG_ERR_NO_ERROR);
+  if (!err && invalid_recipients)
+    err = gpg_error (GPG_ERR_UNUSABLE_PUBKEY);
+
+ leave:
+  if (lines)
+    for (i = 0; i < nrecp; i++)
+      free (lines[i]);
+  free (lines);
+  free (errs);
+  return err;
 }
 
 
@@ -1081,10 +1159,13 @@ static gpgme_error_t
 set_recipients_from_string (engine_uiserver_t uiserver, const char *string)
 {
   gpg_error_t err = 0;
-  char *line = NULL;
+  gpgme_error_t *errs = NULL;
+  char **lines = NULL;
+  int nlines = 0;
+  int size = 0;
   int no_pubkey = 0;
   const char *s;
-  int n;
+  int n, i;
 
   for (;;)
     {
@@ -1101,25 +1182,51 @@ set_recipients_from_string (engine_uiserver_t uiserver, const char *string)
       while (n && (string[n-1] == ' ' || string[n-1] == '\t'))
         n--;
 
-      gpgrt_free (line);
-      if (gpgrt_asprintf (&line, "RECIPIENT %.*s", n, string) < 0)
+      if (nlines == size)
+        {
+          char **newlines;
+
+          size = size ? 2 * size : 16;
+          newlines = realloc (lines, size * sizeof *lines);
+          if (!newlines)
+            {
+              err = gpg_error_from_syserror ();
+              break;
+            }
+          lines = newlines;
+        }
+      if (gpgrt_asprintf (&lines[nlines], "RECIPIENT %.*s", n, string) < 0)
         {
           err = gpg_error_from_syserror ();
           break;
         }
+      nlines++;
       string += n + !!s;
+    }
 
-      err = uiserver_assuan_simple_command (uiserver, line,
-                                            uiserver->status.fnc,
-                                            uiserver->status.fnc_value);
-
+  if (!err && nlines)
+    {
+      errs = calloc (nlines, sizeof *errs);
+      if (!errs)
+        err = gpg_error_from_syserror ();
+      else
+        err = uiserver_assuan_pipelined_commands (uiserver, lines, nlines,
+                                                  errs, uiserver->status.fnc,
+                                                  uiserver->status.fnc_value);
       /* Fixme: Improve error reporting.  */
-      if (gpg_err_code (err) == GPG_ERR_NO_PUBKEY)
-	no_pubkey++;
-      else if (err)
-        break;
+      for (i = 0; !err && i < nlines; i++)
+        {
+          if (gpg_err_code (errs[i]) == GPG_ERR_NO_PUBKEY)
+            no_pubkey++;
+          else
+            err = errs[i];
+        }
     }
-  gpgrt_free (line);
+
+  for (i = 0; i < nlines; i++)
+    gpgrt_free (lines[i]);
+  free (lines);
+  free (errs);
   return err? err : no_pubkey? gpg_error (GPG_ERR_NO_PUBKEY) : 0;
 }
 
@@ -1451,5 +1558,7 @@ struct engine_ops _gpgme_engine_ops_uiserver =
     NULL,		/* cancel_op */
     NULL,               /* passwd */
     NULL,               /* set_pinentry_mode */
-    NULL                /* opspawn */
+    NULL,               /* opspawn */
+    NULL,               /* idle */
+    NULL                /* reuse */
   };
@@ -26,6 +26,9 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#ifdef HAVE_LOCALE_H
+#include <locale.h>
+#endif
 
 #include "gpgme.h"
 #include "util.h"
@@ -41,6 +44,15 @@ struct engine
 {
   struct engine_ops *ops;
   void *engine;
+
+  /* The following fields are only used for engines which may be put
+     into the engine pool; FILE_NAME is NULL for all others.  */
+  struct engine *next_idle;
+  gpgme_protocol_t protocol;
+  char *file_name;
+  char *home_dir;
+  char *lc_ctype;
+  char *lc_messages;
 };
 
 
@@ -67,6 +79,15 @@ DEFINE_STATIC_LOCK (engine_info_lock);
 /* If non-NULL, the minimal version required for all engines.  */
 static char *engine_minimal_version;
 
+/* The pool of idle engines which may be taken over by another
+   context.  The pool is disabled by default; it is enabled by setting
+   the global flag "engine-pool" to the maximum number of idle
+   engines.  */
+static engine_t engine_pool;
+static unsigned int engine_pool_count;
+static unsigned int engine_pool_max;
+DEFINE_STATIC_LOCK (engine_pool_lock);
+
 
 
 /* Get the file name of the engine for PROTOCOL.  */
@@ -538,11 +559,159 @@ _gpgme_engine_new (gpgme_engine_info_t info, engine_t *r_engine)
   else
     engine->engine = NULL;
 
+  /* Remember what is needed to find the engine in the pool.  If that
+     fails the engine is simply not pooled.  */
+  if (engine->ops->idle && engine->ops->reuse)
+    {
+      engine->protocol = info->protocol;
+      engine->file_name = strdup (info->file_name);
+      if (engine->file_name && info->home_dir)
+        {
+          engine->home_dir = strdup (info->home_dir);
+          if (!engine->home_dir)
+            {
+              free (engine->file_name);
+              engine->file_name = NULL;
+            }
+        }
+    }
+
   *r_engine = engine;
   return 0;
 }
 
 
+/* Return true if the strings A and B, each of which may be NULL, are
+   equal.  */
+static int
+same_string (const char *a, const char *b)
+{
+  if (!a || !b)
+    return a == b;
+  return !strcmp (a, b);
+}
+
+
+static void
+engine_free (engine_t engine)
+{
+  if (engine->ops->release)
+    (*engine->ops->release) (engine->engine);
+  free (engine->file_name);
+  free (engine->home_dir);
+  free (engine->lc_ctype);
+  free (engine->lc_messages);
+  free (engine);
+}
+
+
+/* Set the maximum number of idle engines in the pool to the number
+   given by VALUE.  0 disables the pool.  Returns 0 on success.  */
+int
+_gpgme_engine_pool_set_max (const char *value)
+{
+  unsigned long max;
+  engine_t engine, drop = NULL;
+  char *endp;
+
+  errno = 0;
+  max = strtoul (value, &endp, 10);
+  if (errno || endp == value || *endp || max > 1024)
+    return -1;
+
+  LOCK (engine_pool_lock);
+  engine_pool_max = max;
+  while (engine_pool_count > engine_pool_max)
+    {
+      engine = engine_pool;
+      engine_pool = engine->next_idle;
+      engine_pool_count--;
+      engine->next_idle = drop;
+      drop = engine;
+    }
+  UNLOCK (engine_pool_lock);
+
+  /* Releasing an engine may wait for the server; thus do it without
+     holding the lock.  */
+  while ((engine = drop))
+    {
+      drop = engine->next_idle;
+      engine_free (engine);
+    }
+  return 0;
+}
+
+
+/* Take an engine matching INFO with the locale LC_CTYPE and
+   LC_MESSAGES from the pool and return it.  Returns NULL if there is
+   no such engine.  Engines whose server has terminated meanwhile are
+   released.  */
+engine_t
+_gpgme_engine_pool_get (gpgme_engine_info_t info,
+                        const char *lc_ctype, const char *lc_messages)
+{
+  engine_t engine, *enginep;
+  gpgme_error_t err;
+
+  if (!info->file_name)
+    return NULL;
+
+  for (;;)
+    {
+      LOCK (engine_pool_lock);
+      for (enginep = &engine_pool; (engine = *enginep);
+           enginep = &engine->next_idle)
+        if (engine->protocol == info->protocol
+            && !strcmp (engine->file_name, info->file_name)
+            && same_string (engine->home_dir, info->home_dir)
+            && same_string (engine->lc_ctype, lc_ctype)
+            && same_string (engine->lc_messages, lc_messages))
+          {
+            *enginep = engine->next_idle;
+            engine_pool_count--;
+            break;
+          }
+      UNLOCK (engine_pool_lock);
+      if (!engine)
+        return NULL;
+
+      engine->next_idle = NULL;
+      err = (*engine->ops->reuse) (engine->engine);
+      if (!err)
+        {
+          TRACE (DEBUG_ENGINE, "_gpgme_engine_pool_get", engine,
+                 "reusing engine for %s", engine->file_name);
+          return engine;
+        }
+      TRACE (DEBUG_ENGINE, "_gpgme_engine_pool_get", engine,
+             "dropping engine: %s", gpg_strerror (err));
+      engine_free (engine);
+    }
+}
+
+
+/* Put ENGINE into the pool if possible.  Returns true on success.  */
+static int
+engine_pool_put (engine_t engine)
+{
+  int okay;
+
+  if (!engine->file_name || !(*engine->ops->idle) (engine->engine))
+    return 0;
+
+  LOCK (engine_pool_lock);
+  okay = engine_pool_count < engine_pool_max;
+  if (okay)
+    {
+      engine->next_idle = engine_pool;
+      engine_pool = engine;
+      engine_pool_count++;
+    }
+  UNLOCK (engine_pool_lock);
+  return okay;
+}
+
+
 gpgme_error_t
 _gpgme_engine_reset (engine_t engine)
 {
@@ -562,9 +731,11 @@ _gpgme_engine_release (engine_t engine)
   if (!engine)
     return;
 
-  if (engine->ops->release)
-    (*engine->ops->release) (engine->engine);
-  free (engine);
+  /* An idle engine is kept for use by another context.  */
+  if (engine_pool_put (engine))
+    return;
+
+  engine_free (engine);
 }
 
 
@@ -628,13 +799,40 @@ gpgme_error_t
 _gpgme_engine_set_locale (engine_t engine, int category,
 			  const char *value)
 {
+  gpgme_error_t err;
+  char **slot = NULL;
+
   if (!engine)
     return gpg_error (GPG_ERR_INV_VALUE);
 
   if (!engine->ops->set_locale)
     return gpg_error (GPG_ERR_NOT_IMPLEMENTED);
 
-  return (*engine->ops->set_locale) (engine->engine, category, value);
+  err = (*engine->ops->set_locale) (engine->engine, category, value);
+
+  /* Track the locale of engines which may be pooled because it can't
+     be reset to the default.  */
+#ifdef LC_CTYPE
+  if (category == LC_CTYPE)
+    slot = &engine->lc_ctype;
+#endif
+#ifdef LC_MESSAGES
+  if (category == LC_MESSAGES)
+    slot = &engine->lc_messages;
+#endif
+  if (!err && value && slot && engine->file_name
+      && !same_string (*slot, value))
+    {
+      free (*slot);
+      *slot = strdup (value);
+      if (!*slot)
+        {
+          /* We do not know the locale anymore; thus do not pool.  */
+          free (engine->file_name);
+          engine->file_name = NULL;
+        }
+    }
+  return err;
 }
 
 
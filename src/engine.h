@@ -63,6 +63,10 @@ gpgme_error_t _gpgme_set_engine_info (gpgme_engine_info_t info,
 
 gpgme_error_t _gpgme_engine_new (gpgme_engine_info_t info,
 				 engine_t *r_engine);
+int _gpgme_engine_pool_set_max (const char *value);
+engine_t _gpgme_engine_pool_get (gpgme_engine_info_t info,
+                                 const char *lc_ctype,
+                                 const char *lc_messages);
 gpgme_error_t _gpgme_engine_reset (engine_t engine);
 
 gpgme_error_t _gpgme_engine_set_locale (engine_t engine, int category,
@@ -28,11 +28,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <errno.h>
 #ifdef HAVE_LOCALE_H
 #include <locale.h>
 #endif
 #include <stdint.h>
 #include <sys/stat.h>
+#ifdef HAVE_PTHREAD
+# include <pthread.h>
+# include <unistd.h>
+#endif
 
 #define GPGRT_ENABLE_ES_MACROS 1
 #define GPGRT_ENABLE_LOG_MACROS 1
@@ -57,6 +62,21 @@ int main (void){fputs ("Build with Libgpg-error >= 1.28!\n", stderr);return 1;}
 #define DEF_REPLY_CHUNK_SIZE  0
 #define MAX_REPLY_CHUNK_SIZE (10 * 1024 * 1024)
 
+/* The maximum number of requests with an id for which chunked data
+ * is kept for getmore.  */
+#define MAX_PENDING_DATA 64
+
+/* The range of the number of threads used to process requests with
+ * an id and the number of requests which may be queued for them.  */
+#define MIN_WORKERS 4
+#define MAX_WORKERS 16
+#define MAX_QUEUED_REQUESTS 64
+
+/* The default size of the data chunks sent by a streaming operation
+ * and the maximum amount of input data queued for a stream.  */
+#define DEF_STREAM_CHUNK_SIZE (64 * 1024)
+#define MAX_STREAM_QUEUED (16 * 1024 * 1024)
+
 
 static void xoutofcore (const char *type) GPGRT_ATTR_NORETURN;
 static cjson_t error_object_v (cjson_t json, const char *message,
@@ -67,20 +87,48 @@ static cjson_t error_object (cjson_t json, const char *message,
 static char *error_object_string (const char *message,
                                   ...) GPGRT_ATTR_PRINTF(1,2);
 static char *process_request (const char *request);
+static char *process_json_request (cjson_t json);
+static gpg_error_t write_response (const char *response);
 
 
 /* True if interactive mode is active.  */
 static int opt_interactive;
 /* True is debug mode is active.  */
 static int opt_debug;
+/* The number of worker threads, 0 to process all requests in order,
+ * or -1 to use the default.  */
+static int opt_workers = -1;
 
 /* Pending data to be returned by a getmore command.  */
-static struct
+struct pending_data_s
 {
+  struct pending_data_s *next;  /* Link for PENDING_LIST.  */
+  char  *id;       /* Malloced id of the request or NULL.  */
   char  *buffer;   /* Malloced data or NULL if not used.  */
   size_t length;   /* Length of that data.  */
   size_t written;  /* # of already written bytes from BUFFER.  */
-} pending_data;
+};
+
+/* The pending data of the last request without an id.  */
+static struct pending_data_s pending_data;
+
+/* The pending data of requests with an id.  Requests with an id may
+ * be processed concurrently and thus each has its own pending data.
+ * The list is protected by PENDING_LOCK.  */
+static struct pending_data_s *pending_list;
+GPGRT_LOCK_DEFINE (pending_lock);
+
+/* The contexts used for the operations.  Each worker thread has its
+ * own set of contexts.  */
+struct context_cache_s
+{
+  gpgme_ctx_t openpgp;
+  gpgme_ctx_t cms;
+  gpgme_ctx_t conf;
+};
+
+/* The contexts used by the main thread.  */
+static struct context_cache_s main_contexts;
 
 
 /*
@@ -474,6 +522,445 @@ get_chunksize (cjson_t json, size_t *r_chunksize)
 }
 
 
+/* Return the "id" item of the request JSON or NULL if the request has
+ * no valid id.  An id is a number or a string chosen by the client to
+ * match the response to the request.  */
+static cjson_t
+get_request_id_item (cjson_t json)
+{
+  cjson_t j_item;
+
+  if (!json)
+    return NULL;
+  j_item = cJSON_GetObjectItem (json, "id");
+  if (!j_item || !(cjson_is_number (j_item) || cjson_is_string (j_item)))
+    return NULL;
+  return j_item;
+}
+
+
+/* Return the id of the request JSON in its JSON representation as a
+ * malloced string or NULL if the request has no valid id.  */
+static char *
+get_request_id (cjson_t json)
+{
+  cjson_t j_item;
+  char *id;
+
+  j_item = get_request_id_item (json);
+  if (!j_item)
+    return NULL;
+  id = cJSON_PrintUnformatted (j_item);
+  if (!id)
+    xoutofcore ("cJSON_PrintUnformatted");
+  return id;
+}
+
+
+/* Copy the id of the request JSON, if any, to the response RESULT.  */
+static void
+add_request_id (cjson_t result, cjson_t json)
+{
+  cjson_t j_item;
+  cjson_t j_copy;
+
+  j_item = get_request_id_item (json);
+  if (!j_item || cJSON_GetObjectItem (result, "id"))
+    return;
+  j_copy = cJSON_Duplicate (j_item, 0);
+  if (!j_copy)
+    xoutofcore ("cJSON_Duplicate");
+  xjson_AddItemToObject (result, "id", j_copy);
+}
+
+
+
+/*
+ * Pending data of requests with an id.
+ */
+
+static void
+release_pending_data (struct pending_data_s *pd)
+{
+  if (!pd)
+    return;
+  xfree (pd->buffer);
+  xfree (pd->id);
+  xfree (pd);
+}
+
+
+/* Insert PD into the list of pending data.  An older entry with the
+ * same id is replaced.  To limit the memory used by clients which do
+ * not retrieve all chunks the oldest entries are dropped.  */
+static void
+put_pending_data (struct pending_data_s *pd)
+{
+  struct pending_data_s *item, **itemp;
+  int count;
+
+  gpgrt_lock_lock (&pending_lock);
+  pd->next = pending_list;
+  pending_list = pd;
+  for (count = 0, itemp = &pd->next; (item = *itemp); )
+    {
+      if (!strcmp (item->id, pd->id) || ++count >= MAX_PENDING_DATA)
+        {
+          *itemp = item->next;
+          release_pending_data (item);
+        }
+      else
+        itemp = &item->next;
+    }
+  gpgrt_lock_unlock (&pending_lock);
+}
+
+
+/* Remove the pending data with ID from the list and return it.
+ * Returns NULL if there is no such entry.  */
+static struct pending_data_s *
+take_pending_data (const char *id)
+{
+  struct pending_data_s *item, **itemp;
+
+  gpgrt_lock_lock (&pending_lock);
+  for (itemp = &pending_list; (item = *itemp); itemp = &item->next)
+    if (!strcmp (item->id, id))
+      {
+        *itemp = item->next;
+        item->next = NULL;
+        break;
+      }
+  gpgrt_lock_unlock (&pending_lock);
+  return item;
+}
+
+
+
+/*
+ * Streaming of the data of encrypt and decrypt operations.
+ */
+
+#ifdef HAVE_PTHREAD
+/* A chunk of input data sent with "putdata".  */
+struct stream_chunk_s
+{
+  struct stream_chunk_s *next;
+  size_t length;   /* Length of DATA.  */
+  size_t nread;    /* # of bytes already passed to gpgme.  */
+  char data[1];
+};
+
+/* The state of a streaming operation.  The input is queued by the
+ * main thread and read by the worker which runs the operation.  The
+ * output is sent by the worker in chunks as soon as enough data has
+ * been collected.  */
+struct stream_s
+{
+  struct stream_s *next;        /* Link for STREAM_LIST.  */
+  char *id;                     /* The printed id of the request.  */
+  cjson_t j_id;                 /* A copy of the id.  */
+  struct stream_chunk_s *head;  /* The queued input chunks.  */
+  struct stream_chunk_s **tail;
+  size_t queued;                /* # of queued input bytes.  */
+  int eof;                      /* The last input chunk has been queued.  */
+  int aborted;                  /* No more input will arrive.  */
+
+  const char *type;             /* The type of the output chunks.  */
+  char *outbuf;                 /* Buffer for the next output chunk.  */
+  size_t outlen;                /* # of bytes in OUTBUF.  */
+  size_t outsize;               /* Allocated size of OUTBUF.  */
+};
+
+/* The open streams.  They are protected by STREAM_LOCK and
+ * STREAM_COND is signaled on changes.  */
+static struct stream_s *stream_list;
+static int stream_count;
+static pthread_mutex_t stream_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t stream_cond = PTHREAD_COND_INITIALIZER;
+
+
+/* Return the open stream with ID.  Must be called with STREAM_LOCK
+ * held.  */
+static struct stream_s *
+find_stream (const char *id)
+{
+  struct stream_s *st;
+
+  for (st = stream_list; st; st = st->next)
+    if (!strcmp (st->id, id))
+      break;
+  return st;
+}
+
+
+/* Close the stream ST and release it.  Called by the worker after
+ * the request has been processed.  Input sent later for the same id
+ * is rejected.  */
+static void
+close_stream (struct stream_s *st)
+{
+  struct stream_s **stp;
+  struct stream_chunk_s *chunk;
+
+  if (!st)
+    return;
+
+  pthread_mutex_lock (&stream_lock);
+  for (stp = &stream_list; *stp; stp = &(*stp)->next)
+    if (*stp == st)
+      {
+        *stp = st->next;
+        stream_count--;
+        break;
+      }
+  pthread_mutex_unlock (&stream_lock);
+
+  while ((chunk = st->head))
+    {
+      st->head = chunk->next;
+      xfree (chunk);
+    }
+  cJSON_Delete (st->j_id);
+  xfree (st->outbuf);
+  xfree (st->id);
+  xfree (st);
+}
+
+
+/* Send an object of TYPE for the stream ST.  If DATA is not NULL
+ * the DATALEN bytes at DATA are added base64 encoded.  */
+static gpg_error_t
+send_stream_object (struct stream_s *st, const char *type,
+                    const void *data, size_t datalen)
+{
+  gpg_error_t err = 0;
+  cjson_t j_obj;
+  cjson_t j_copy;
+  char *buffer;
+
+  j_obj = xjson_CreateObject ();
+  xjson_AddStringToObject (j_obj, "type", type);
+  if (data)
+    {
+      xjson_AddBoolToObject (j_obj, "base64", 1);
+      err = add_base64_to_object (j_obj, "data", data, datalen);
+      xjson_AddBoolToObject (j_obj, "partial", 1);
+    }
+  else
+    xjson_AddNumberToObject (j_obj, "queued", st->queued);
+  j_copy = cJSON_Duplicate (st->j_id, 0);
+  if (!j_copy)
+    xoutofcore ("cJSON_Duplicate");
+  xjson_AddItemToObject (j_obj, "id", j_copy);
+
+  if (!err)
+    {
+      buffer = cJSON_PrintUnformatted (j_obj);
+      if (!buffer)
+        xoutofcore ("cJSON_PrintUnformatted");
+      if (opt_debug)
+        log_debug ("response='%s'\n", buffer);
+      err = write_response (buffer);
+      xfree (buffer);
+    }
+  cJSON_Delete (j_obj);
+  return err;
+}
+
+
+/* The read callback for the input of a streaming operation.  It
+ * waits for the next chunk and acknowledges each chunk once it has
+ * been read completely, so that the client knows when to send more
+ * data.  */
+static gpgme_ssize_t
+stream_read_cb (void *handle, void *buffer, size_t size)
+{
+  struct stream_s *st = handle;
+  struct stream_chunk_s *chunk;
+  size_t n;
+  int ack = 0;
+
+  pthread_mutex_lock (&stream_lock);
+  while (!st->head && !st->eof && !st->aborted)
+    pthread_cond_wait (&stream_cond, &stream_lock);
+  if (st->aborted)
+    {
+      /* Do not let a truncated input look complete.  */
+      pthread_mutex_unlock (&stream_lock);
+      gpg_err_set_errno (ECANCELED);
+      return -1;
+    }
+  chunk = st->head;
+  if (!chunk)
+    {
+      pthread_mutex_unlock (&stream_lock);
+      return 0;  /* EOF */
+    }
+  n = chunk->length - chunk->nread;
+  if (n > size)
+    n = size;
+  memcpy (buffer, chunk->data + chunk->nread, n);
+  chunk->nread += n;
+  st->queued -= n;
+  if (chunk->nread == chunk->length)
+    {
+      st->head = chunk->next;
+      if (!st->head)
+        st->tail = &st->head;
+      xfree (chunk);
+      ack = 1;
+    }
+  pthread_mutex_unlock (&stream_lock);
+
+  if (ack && send_stream_object (st, "putdata", NULL, 0))
+    {
+      gpg_err_set_errno (EIO);
+      return -1;
+    }
+  return n;
+}
+
+
+/* The write callback for the output of a streaming operation.  */
+static gpgme_ssize_t
+stream_write_cb (void *handle, const void *buffer, size_t size)
+{
+  struct stream_s *st = handle;
+  size_t nleft = size;
+  size_t n;
+
+  while (nleft)
+    {
+      n = st->outsize - st->outlen;
+      if (n > nleft)
+        n = nleft;
+      memcpy (st->outbuf + st->outlen, buffer, n);
+      st->outlen += n;
+      buffer = (const char *)buffer + n;
+      nleft -= n;
+      if (st->outlen == st->outsize)
+        {
+          if (send_stream_object (st, st->type, st->outbuf, st->outlen))
+            {
+              gpg_err_set_errno (EIO);
+              return -1;
+            }
+          st->outlen = 0;
+        }
+    }
+  return size;
+}
+
+
+static struct gpgme_data_cbs stream_input_cbs = { stream_read_cb };
+static struct gpgme_data_cbs stream_output_cbs = { NULL, stream_write_cb };
+
+
+/* Set up the streaming operation of REQUEST.  The input is then read
+ * from the chunks sent with "putdata" and the output is sent in
+ * chunks of TYPE.  On success the stream is stored at R_STREAM and
+ * the data objects at R_INPUT and R_OUTPUT.  */
+static gpg_error_t
+get_stream_data (cjson_t request, cjson_t result, const char *type,
+                 struct stream_s **r_stream,
+                 gpgme_data_t *r_input, gpgme_data_t *r_output)
+{
+  gpg_error_t err;
+  struct stream_s *st;
+  size_t chunksize, n;
+  char *id;
+
+  *r_stream = NULL;
+  *r_input = *r_output = NULL;
+
+  id = get_request_id (request);
+  pthread_mutex_lock (&stream_lock);
+  st = id? find_stream (id) : NULL;
+  pthread_mutex_unlock (&stream_lock);
+  if (!st)
+    {
+      err = gpg_error (GPG_ERR_NOT_SUPPORTED);
+      gpg_error_object (result, err, "Streaming requires an id and"
+                        " concurrent processing in Native Messaging mode");
+      xfree (id);
+      return err;
+    }
+
+  /* Each output chunk shall fit into CHUNKSIZE including the meta
+   * data and the base64 encoding.  */
+  if ((err = get_chunksize (request, &chunksize)))
+    chunksize = 0;
+  if (!chunksize)
+    chunksize = DEF_STREAM_CHUNK_SIZE;
+  n = 100 + strlen (id);
+  st->outsize = chunksize > n + 4? (chunksize - n) / 4 * 3 : 3;
+  st->outbuf = xmalloc (st->outsize);
+  st->type = type;
+  xfree (id);
+
+  err = gpgme_data_new_from_cbs (r_input, &stream_input_cbs, st);
+  if (!err)
+    err = gpgme_data_new_from_cbs (r_output, &stream_output_cbs, st);
+  if (err)
+    {
+      gpgme_data_release (*r_input);
+      *r_input = NULL;
+      gpg_error_object (result, err, "Error creating data objects: %s",
+                        gpg_strerror (err));
+      return err;
+    }
+
+  *r_stream = st;
+  return 0;
+}
+
+
+/* Send the remaining output of the stream ST and add the type and
+ * base64 flag of the data to RESULT.  */
+static gpg_error_t
+finish_stream (struct stream_s *st, cjson_t result)
+{
+  gpg_error_t err = 0;
+
+  if (st->outlen)
+    err = send_stream_object (st, st->type, st->outbuf, st->outlen);
+  st->outlen = 0;
+  xjson_AddStringToObject (result, "type", st->type);
+  xjson_AddBoolToObject (result, "base64", 1);
+  return err;
+}
+
+
+#else /*!HAVE_PTHREAD*/
+
+struct stream_s;
+
+static gpg_error_t
+get_stream_data (cjson_t request, cjson_t result, const char *type,
+                 struct stream_s **r_stream,
+                 gpgme_data_t *r_input, gpgme_data_t *r_output)
+{
+  gpg_error_t err = gpg_error (GPG_ERR_NOT_SUPPORTED);
+
+  (void)request;
+  (void)type;
+  *r_stream = NULL;
+  *r_input = *r_output = NULL;
+  gpg_error_object (result, err, "Streaming is not supported");
+  return err;
+}
+
+static gpg_error_t
+finish_stream (struct stream_s *st, cjson_t result)
+{
+  (void)st;
+  (void)result;
+  return gpg_error (GPG_ERR_NOT_SUPPORTED);
+}
+#endif /*!HAVE_PTHREAD*/
+
+
 /* Extract the keys from the array or string with the name "name"
  * in the JSON object.  On success a string with the keys identifiers
  * is stored at R_KEYS.
@@ -566,31 +1053,46 @@ _create_new_context (gpgme_protocol_t proto)
 }
 
 
-/* Return a context object for protocol PROTO.  This is currently a
- * statically allocated context initialized for PROTO.  Terminates
- * process on failure.  */
+#ifdef HAVE_PTHREAD
+/* The key to get the contexts of a worker thread.  */
+static pthread_key_t worker_contexts_key;
+/* True if WORKER_CONTEXTS_KEY has been created.  */
+static int worker_contexts_key_valid;
+#endif /*HAVE_PTHREAD*/
+
+
+/* Return a context object for protocol PROTO.  This is a context
+ * initialized for PROTO which is kept for the lifetime of the calling
+ * thread.  Terminates process on failure.  */
 static gpgme_ctx_t
 get_context (gpgme_protocol_t proto)
 {
-  static gpgme_ctx_t ctx_openpgp, ctx_cms, ctx_conf;
+  struct context_cache_s *cache = NULL;
+
+#ifdef HAVE_PTHREAD
+  if (worker_contexts_key_valid)
+    cache = pthread_getspecific (worker_contexts_key);
+#endif
+  if (!cache)
+    cache = &main_contexts;
 
   if (proto == GPGME_PROTOCOL_OpenPGP)
     {
-      if (!ctx_openpgp)
-        ctx_openpgp = _create_new_context (proto);
-      return ctx_openpgp;
+      if (!cache->openpgp)
+        cache->openpgp = _create_new_context (proto);
+      return cache->openpgp;
     }
   else if (proto == GPGME_PROTOCOL_CMS)
     {
-      if (!ctx_cms)
-        ctx_cms = _create_new_context (proto);
-      return ctx_cms;
+      if (!cache->cms)
+        cache->cms = _create_new_context (proto);
+      return cache->cms;
     }
   else if (proto == GPGME_PROTOCOL_GPGCONF)
     {
-      if (!ctx_conf)
-        ctx_conf = _create_new_context (proto);
-      return ctx_conf;
+      if (!cache->conf)
+        cache->conf = _create_new_context (proto);
+      return cache->conf;
     }
   else
     log_bug ("invalid protocol %d requested\n", proto);
@@ -1517,15 +2019,29 @@ make_data_object (cjson_t result, gpgme_data_t data,
  * Chunking is only done if the response is larger then the
  * chunksize.
  *
+ * If the request has an id, the id is added to the response or, if
+ * the response is chunked, to each chunk.
+ *
  * caller has to xfree the return value.
  */
 static char *
 encode_and_chunk (cjson_t request, cjson_t response)
 {
-  char *data;
+  char *data = NULL;
   gpg_error_t err = 0;
   size_t chunksize = 0;
   char *getmore_request = NULL;
+  struct pending_data_s *pd;
+  char *id = NULL;
+
+  if (request && (err = get_chunksize (request, &chunksize)))
+    {
+      err = GPG_ERR_INV_VALUE;
+      goto leave;
+    }
+
+  if (!chunksize)
+    add_request_id (response, request);
 
   if (opt_interactive)
     data = cJSON_Print (response);
@@ -1538,31 +2054,32 @@ encode_and_chunk (cjson_t request, cjson_t response)
       goto leave;
     }
 
-  if (!request)
-    {
-      goto leave;
-    }
-
-  if ((err = get_chunksize (request, &chunksize)))
-    {
-      err = GPG_ERR_INV_VALUE;
-      goto leave;
-    }
-
   if (!chunksize)
     goto leave;
 
-  pending_data.buffer = data;
+  id = get_request_id (request);
+  if (id)
+    {
+      pd = xcalloc (1, sizeof *pd);
+      pd->id = xstrdup (id);
+    }
+  else
+    pd = &pending_data;
+  pd->buffer = data;
   /* Data should already be encoded so that it does not
      contain 0.*/
-  pending_data.length = strlen (data);
-  pending_data.written = 0;
+  pd->length = strlen (data);
+  pd->written = 0;
+  if (id)
+    put_pending_data (pd);
 
   if (gpgrt_asprintf (&getmore_request,
-                  "{ \"op\":\"getmore\", \"chunksize\": %i }",
-                  (int) chunksize) == -1)
+                      "{ \"op\":\"getmore\", \"chunksize\": %i%s%s }",
+                      (int) chunksize,
+                      id? ", \"id\": " : "", id? id : "") == -1)
     {
       err = gpg_error_from_syserror ();
+      data = NULL;
       goto leave;
     }
 
@@ -1570,6 +2087,7 @@ encode_and_chunk (cjson_t request, cjson_t response)
 
 leave:
   xfree (getmore_request);
+  xfree (id);
 
   if (!err && !data)
     {
@@ -1581,6 +2099,7 @@ leave:
       cjson_t err_obj = gpg_error_object (NULL, err,
                                           "Encode and chunk failed: %s",
                                           gpgme_strerror (err));
+      add_request_id (err_obj, request);
       xfree (data);
       if (opt_interactive)
         data = cJSON_Print (err_obj);
@@ -1621,13 +2140,22 @@ static const char hlp_encrypt[] =
   "throw-keyids:  Request the --throw-keyids option.\n"
   "want-address:  Require that the keys include a mail address.\n"
   "wrap:          Assume the input is an OpenPGP message.\n"
+  "stream:        Stream the data; see below.\n"
   "\n"
   "Response on success:\n"
   "type:   \"ciphertext\"\n"
   "data:   Unless armor mode is used a Base64 encoded binary\n"
   "        ciphertext.  In armor mode a string with an armored\n"
   "        OpenPGP or a PEM message.\n"
-  "base64: Boolean indicating whether data is base64 encoded.";
+  "base64: Boolean indicating whether data is base64 encoded.\n"
+  "\n"
+  "In stream mode, which requires an id and the Native Messaging\n"
+  "mode, the request has no data.  The input is sent in chunks with\n"
+  "\"putdata\" requests carrying the same id; each chunk is\n"
+  "acknowledged by an object of type \"putdata\".  The ciphertext is\n"
+  "sent as it is produced in base64 encoded objects of type\n"
+  "\"ciphertext\" with the flag \"partial\" set; their size is\n"
+  "limited by \"chunksize\".  The final response has no data.";
 static gpg_error_t
 op_encrypt (cjson_t request, cjson_t result)
 {
@@ -1645,6 +2173,8 @@ op_encrypt (cjson_t request, cjson_t result)
   gpgme_ctx_t keylist_ctx = NULL;
   gpgme_key_t key = NULL;
   cjson_t j_tmp = NULL;
+  struct stream_s *stream = NULL;
+  int opt_stream;
 
   if ((err = get_protocol (request, &protocol)))
     goto leave;
@@ -1652,6 +2182,8 @@ op_encrypt (cjson_t request, cjson_t result)
 
   if ((err = get_boolean_flag (request, "mime", 0, &opt_mime)))
     goto leave;
+  if ((err = get_boolean_flag (request, "stream", 0, &opt_stream)))
+    goto leave;
 
   if ((err = get_boolean_flag (request, "armor", 0, &abool)))
     goto leave;
@@ -1734,8 +2266,13 @@ op_encrypt (cjson_t request, cjson_t result)
       keylist_ctx = NULL;
     }
 
-  if ((err = get_string_data (request, result, "data", &input)))
-      goto leave;
+  if (opt_stream)
+    err = get_stream_data (request, result, "ciphertext",
+                           &stream, &input, &output);
+  else
+    err = get_string_data (request, result, "data", &input);
+  if (err)
+    goto leave;
 
   if (opt_mime)
     gpgme_data_set_encoding (input, GPGME_DATA_ENCODING_MIME);
@@ -1746,7 +2283,8 @@ op_encrypt (cjson_t request, cjson_t result)
     }
 
   /* Create an output data object.  */
-  err = gpgme_data_new (&output);
+  if (!stream)
+    err = gpgme_data_new (&output);
   if (err)
     {
       gpg_error_object (result, err, "Error creating output data object: %s",
@@ -1776,10 +2314,16 @@ op_encrypt (cjson_t request, cjson_t result)
   gpgme_data_release (input);
   input = NULL;
 
-  /* We need to base64 if armoring has not been requested.  */
-  err = make_data_object (result, output,
-                          "ciphertext", !gpgme_get_armor (ctx));
-  output = NULL;
+  /* We need to base64 if armoring has not been requested.  The
+   * streamed data is always base64 encoded.  */
+  if (stream)
+    err = finish_stream (stream, result);
+  else
+    {
+      err = make_data_object (result, output,
+                              "ciphertext", !gpgme_get_armor (ctx));
+      output = NULL;
+    }
 
  leave:
   xfree_array (signing_patterns);
@@ -1806,10 +2350,13 @@ static const char hlp_decrypt[] =
   "\n"
   "Optional boolean flags (default is false):\n"
   "base64:        Input data is base64 encoded.\n"
+  "stream:        Stream the data as described for \"encrypt\".\n"
   "\n"
   "Response on success:\n"
   "type:     \"plaintext\"\n"
   "data:     The decrypted data.  This may be base64 encoded.\n"
+  "          In stream mode the data is sent in objects of type\n"
+  "          \"plaintext\" before this response.\n"
   "base64:   Boolean indicating whether data is base64 encoded.\n"
   "mime:     deprecated - use dec_info is_mime instead\n"
   "dec_info: An object with decryption information. (gpgme_decrypt_result_t)\n"
@@ -1889,16 +2436,26 @@ op_decrypt (cjson_t request, cjson_t result)
   gpgme_data_t output = NULL;
   gpgme_decrypt_result_t decrypt_result;
   gpgme_verify_result_t verify_result;
+  struct stream_s *stream = NULL;
+  int opt_stream;
 
   if ((err = get_protocol (request, &protocol)))
     goto leave;
   ctx = get_context (protocol);
 
-  if ((err = get_string_data (request, result, "data", &input)))
-      goto leave;
+  if ((err = get_boolean_flag (request, "stream", 0, &opt_stream)))
+    goto leave;
+  if (opt_stream)
+    err = get_stream_data (request, result, "plaintext",
+                           &stream, &input, &output);
+  else
+    err = get_string_data (request, result, "data", &input);
+  if (err)
+    goto leave;
 
   /* Create an output data object.  */
-  err = gpgme_data_new (&output);
+  if (!stream)
+    err = gpgme_data_new (&output);
   if (err)
     {
       gpg_error_object (result, err,
@@ -1933,8 +2490,13 @@ op_decrypt (cjson_t request, cjson_t result)
                              verify_result_to_json (verify_result));
     }
 
-  err = make_data_object (result, output, "plaintext", -1);
-  output = NULL;
+  if (stream)
+    err = finish_stream (stream, result);
+  else
+    {
+      err = make_data_object (result, output, "plaintext", -1);
+      output = NULL;
+    }
 
   if (err)
     {
@@ -3075,10 +3637,15 @@ leave:
 static const char hlp_getmore[] =
   "op:     \"getmore\"\n"
   "\n"
+  "Optional parameters:\n"
+  "id:             The id of the request whose response shall be\n"
+  "                retrieved.\n"
+  "\n"
   "Response on success:\n"
   "response:       base64 encoded json response.\n"
   "more:           Another getmore is required.\n"
-  "base64:         boolean if the response is base64 encoded.\n";
+  "base64:         boolean if the response is base64 encoded.\n"
+  "id:             The id of the request if given.\n";
 static gpg_error_t
 op_getmore (cjson_t request, cjson_t result)
 {
@@ -3086,19 +3653,29 @@ op_getmore (cjson_t request, cjson_t result)
   int c;
   size_t n;
   size_t chunksize;
+  size_t overhead;
+  struct pending_data_s *pd;
+  char *id;
 
   if ((err = get_chunksize (request, &chunksize)))
-    goto leave;
+    return err;
 
   /* For the meta data we need 41 bytes:
-     {"more":true,"base64":true,"response":""} */
-  chunksize -= 41;
+     {"more":true,"base64":true,"response":""}
+     and for an id another 6 bytes plus the id: ,"id":  */
+  id = get_request_id (request);
+  overhead = 41 + (id? 6 + strlen (id) : 0);
+  if (chunksize > overhead + 4)
+    chunksize -= overhead;
+  else
+    chunksize = 4;
 
   /* Adjust the chunksize for the base64 conversion.  */
   chunksize = (chunksize / 4) * 3;
 
   /* Do we have anything pending?  */
-  if (!pending_data.buffer)
+  pd = id? take_pending_data (id) : &pending_data;
+  if (!pd || !pd->buffer)
     {
       err = gpg_error (GPG_ERR_NO_DATA);
       gpg_error_object (result, err, "Operation not possible: %s",
@@ -3109,18 +3686,18 @@ op_getmore (cjson_t request, cjson_t result)
   /* We currently always use base64 encoding for simplicity. */
   xjson_AddBoolToObject (result, "base64", 1);
 
-  if (pending_data.written >= pending_data.length)
+  if (pd->written >= pd->length)
     {
       /* EOF reached.  This should not happen but we return an empty
        * string once in case of client errors.  */
-      gpgme_free (pending_data.buffer);
-      pending_data.buffer = NULL;
+      gpgme_free (pd->buffer);
+      pd->buffer = NULL;
       xjson_AddBoolToObject (result, "more", 0);
       err = cjson_AddStringToObject (result, "response", "");
     }
   else
     {
-      n = pending_data.length - pending_data.written;
+      n = pd->length - pd->written;
       if (n > chunksize)
         {
           n = chunksize;
@@ -3129,24 +3706,58 @@ op_getmore (cjson_t request, cjson_t result)
       else
         xjson_AddBoolToObject (result, "more", 0);
 
-      c = pending_data.buffer[pending_data.written + n];
-      pending_data.buffer[pending_data.written + n] = 0;
+      c = pd->buffer[pd->written + n];
+      pd->buffer[pd->written + n] = 0;
       err = add_base64_to_object (result, "response",
-                                  (pending_data.buffer
-                                   + pending_data.written), n);
-      pending_data.buffer[pending_data.written + n] = c;
+                                  (pd->buffer + pd->written), n);
+      pd->buffer[pd->written + n] = c;
       if (!err)
         {
-          pending_data.written += n;
-          if (pending_data.written >= pending_data.length)
+          pd->written += n;
+          if (pd->written >= pd->length)
             {
-              xfree (pending_data.buffer);
-              pending_data.buffer = NULL;
+              xfree (pd->buffer);
+              pd->buffer = NULL;
             }
         }
     }
 
  leave:
+  if (pd && pd != &pending_data)
+    {
+      /* Keep the rest for the next getmore of this request.  */
+      if (pd->buffer)
+        put_pending_data (pd);
+      else
+        release_pending_data (pd);
+    }
+  xfree (id);
+  return err;
+}
+
+
+
+static const char hlp_putdata[] =
+  "op:     \"putdata\"\n"
+  "id:     The id of the streaming request the data is for.\n"
+  "data:   The next chunk of the input data, base64 encoded.\n"
+  "\n"
+  "Optional boolean flags (default is false):\n"
+  "more:   More chunks will follow.\n"
+  "\n"
+  "There is no response on success.  Each chunk is acknowledged by an\n"
+  "object with the same id once it has been processed:\n"
+  "type:   \"putdata\"\n"
+  "queued: The number of bytes still queued for the request.";
+static gpg_error_t
+op_putdata (cjson_t request, cjson_t result)
+{
+  gpg_error_t err = gpg_error (GPG_ERR_NOT_SUPPORTED);
+
+  /* Data for streams is handled by the Native Messaging loop before
+   * a request is dispatched.  */
+  (void)request;
+  gpg_error_object (result, err, "No streaming operation active");
   return err;
 }
 
@@ -3173,6 +3784,7 @@ static const char hlp_help[] =
   "  verify      Verify data.\n"
   "  version     Get engine information.\n"
   "  getmore     Retrieve remaining data if chunksize was used.\n"
+  "  putdata     Send input data for a streaming operation.\n"
   "  help        Help overview.\n"
   "\n"
   "If the data needs to be transferred in smaller chunks the\n"
@@ -3180,7 +3792,14 @@ static const char hlp_help[] =
   "When \"chunksize\" is set the response (including json) will\n"
   "not be larger then \"chunksize\" but might be smaller.\n"
   "The chunked result will be transferred in base64 encoded chunks\n"
-  "using the \"getmore\" operation. See help getmore for more info.";
+  "using the \"getmore\" operation. See help getmore for more info.\n"
+  "\n"
+  "A request may carry the property \"id\" with a number or string\n"
+  "value which is then also put into the response and into each\n"
+  "chunk of it.  In Native Messaging mode requests with an id are\n"
+  "processed concurrently and their responses are returned as soon as\n"
+  "they are ready; thus the id must be used to match them.  To get the\n"
+  "remaining chunks the id has to be passed to \"getmore\".";
 static gpg_error_t
 op_help (cjson_t request, cjson_t result)
 {
@@ -3207,18 +3826,83 @@ op_help (cjson_t request, cjson_t result)
  * Dispatcher
  */
 
-/* Process a request and return the response.  The response is a newly
- * allocated string or NULL in case of an error.  */
+/* Print the RESPONSE to the request JSON.  */
 static char *
-process_request (const char *request)
+print_response (cjson_t json, cjson_t response, int is_getmore)
 {
-  static struct {
-    const char *op;
-    gpg_error_t (*handler)(cjson_t request, cjson_t result);
-    const char * const helpstr;
-  } optbl[] = {
-    { "config",     op_config,     hlp_config },
-    { "config_opt", op_config_opt, hlp_config_opt },
+  char *res;
+
+  if (is_getmore)
+    {
+      /* For getmore we bypass the encode_and_chunk. */
+      add_request_id (response, json);
+      if (opt_interactive)
+        res = cJSON_Print (response);
+      else
+        res = cJSON_PrintUnformatted (response);
+    }
+  else
+    res = encode_and_chunk (json, response);
+  if (!res)
+    {
+      cjson_t err_obj;
+
+      log_error ("printing JSON data failed\n");
+
+      err_obj = error_object (NULL, "Printing JSON data failed");
+      add_request_id (err_obj, json);
+      if (opt_interactive)
+        res = cJSON_Print (err_obj);
+      res = cJSON_PrintUnformatted (err_obj);
+      cJSON_Delete (err_obj);
+    }
+
+  if (!res)
+    {
+      /* Can't happen unless we created a broken error_object above */
+      return xtrystrdup ("Bug: Fatal error in process request\n");
+    }
+  return res;
+}
+
+
+/* Process a request and return the response.  The response is a newly
+ * allocated string or NULL in case of an error.  */
+static char *
+process_request (const char *request)
+{
+  size_t erroff;
+  cjson_t json;
+  cjson_t response;
+  char *res;
+
+  json = cJSON_Parse (request, &erroff);
+  if (json)
+    return process_json_request (json);
+
+  log_string (GPGRT_LOGLVL_INFO, request);
+  log_info ("invalid JSON object at offset %zu\n", erroff);
+  response = xjson_CreateObject ();
+  error_object (response, "invalid JSON object at offset %zu\n", erroff);
+  res = print_response (NULL, response, 0);
+  cJSON_Delete (response);
+  return res;
+}
+
+
+/* Process the parsed request JSON and return the response.  JSON is
+ * released by this function.  The response is a newly allocated
+ * string or NULL in case of an error.  */
+static char *
+process_json_request (cjson_t json)
+{
+  static struct {
+    const char *op;
+    gpg_error_t (*handler)(cjson_t request, cjson_t result);
+    const char * const helpstr;
+  } optbl[] = {
+    { "config",     op_config,     hlp_config },
+    { "config_opt", op_config_opt, hlp_config_opt },
     { "encrypt",    op_encrypt,    hlp_encrypt },
     { "export",     op_export,     hlp_export },
     { "decrypt",    op_decrypt,    hlp_decrypt },
@@ -3230,11 +3914,10 @@ process_request (const char *request)
     { "verify",     op_verify,     hlp_verify },
     { "version",    op_version,    hlp_version },
     { "getmore",    op_getmore,    hlp_getmore },
+    { "putdata",    op_putdata,    hlp_putdata },
     { "help",       op_help,       hlp_help },
     { NULL }
   };
-  size_t erroff;
-  cjson_t json;
   cjson_t j_tmp, j_op;
   cjson_t response;
   int helpmode;
@@ -3245,12 +3928,10 @@ process_request (const char *request)
 
   response = xjson_CreateObject ();
 
-  json = cJSON_Parse (request, &erroff);
-  if (!json)
+  j_tmp = cJSON_GetObjectItem (json, "id");
+  if (j_tmp && !get_request_id_item (json))
     {
-      log_string (GPGRT_LOGLVL_INFO, request);
-      log_info ("invalid JSON object at offset %zu\n", erroff);
-      error_object (response, "invalid JSON object at offset %zu\n", erroff);
+      error_object (response, "Property \"id\" must be a number or a string");
       goto leave;
     }
 
@@ -3286,8 +3967,10 @@ process_request (const char *request)
           gpg_error_t err;
           is_getmore = optbl[idx].handler == op_getmore;
           /* If this is not the "getmore" command and we have any
-           * pending data release that data.  */
-          if (pending_data.buffer && optbl[idx].handler != op_getmore)
+           * pending data release that data.  Requests with an id
+           * have their own pending data.  */
+          if (pending_data.buffer && optbl[idx].handler != op_getmore
+              && !get_request_id_item (json))
             {
               gpgme_free (pending_data.buffer);
               pending_data.buffer = NULL;
@@ -3316,37 +3999,9 @@ process_request (const char *request)
     }
 
  leave:
-  if (is_getmore)
-    {
-      /* For getmore we bypass the encode_and_chunk. */
-      if (opt_interactive)
-        res = cJSON_Print (response);
-      else
-        res = cJSON_PrintUnformatted (response);
-    }
-  else
-    res = encode_and_chunk (json, response);
-  if (!res)
-    {
-      cjson_t err_obj;
-
-      log_error ("printing JSON data failed\n");
-
-      err_obj = error_object (NULL, "Printing JSON data failed");
-      if (opt_interactive)
-        res = cJSON_Print (err_obj);
-      res = cJSON_PrintUnformatted (err_obj);
-      cJSON_Delete (err_obj);
-    }
-
+  res = print_response (json, response, is_getmore);
   cJSON_Delete (json);
   cJSON_Delete (response);
-
-  if (!res)
-    {
-      /* Can't happen unless we created a broken error_object above */
-      return xtrystrdup ("Bug: Fatal error in process request\n");
-    }
   return res;
 }
 
@@ -3677,14 +4332,482 @@ read_and_process_single_request (void)
 }
 
 
-/* The Native Messaging processing loop.  */
+/* Lock to serialize the responses of the main thread and the worker
+ * threads.  */
+GPGRT_LOCK_DEFINE (output_lock);
+
+/* Set if writing a response failed.  */
+static int output_failed;
+
+
+/* Write RESPONSE with the length header of the Native Messaging
+ * protocol to stdout.  */
+static gpg_error_t
+write_response (const char *response)
+{
+  gpg_error_t err = 0;
+  uint32_t nresponse;
+  size_t n;
+
+  nresponse = strlen (response);
+
+  gpgrt_lock_lock (&output_lock);
+  if (es_write (es_stdout, &nresponse, sizeof nresponse, &n))
+    {
+      err = gpg_error_from_syserror ();
+      log_error ("error writing request header: %s\n", gpg_strerror (err));
+      goto leave;
+    }
+  if (n != sizeof nresponse)
+    {
+      err = gpg_error (GPG_ERR_EIO);
+      log_error ("error writing request header: short write\n");
+      goto leave;
+    }
+  if (es_write (es_stdout, response, nresponse, &n))
+    {
+      err = gpg_error_from_syserror ();
+      log_error ("error writing request: %s\n", gpg_strerror (err));
+      goto leave;
+    }
+  if (n != nresponse)
+    {
+      err = gpg_error (GPG_ERR_EIO);
+      log_error ("error writing request: short write\n");
+      goto leave;
+    }
+  if (es_fflush (es_stdout) || es_ferror (es_stdout))
+    {
+      err = gpg_error_from_syserror ();
+      log_error ("error writing request: %s\n", gpg_strerror (err));
+      goto leave;
+    }
+
+ leave:
+  if (err)
+    output_failed = 1;
+  gpgrt_lock_unlock (&output_lock);
+  return err;
+}
+
+
+#ifdef HAVE_PTHREAD
+/* A request queued for the worker threads.  */
+struct work_item_s
+{
+  struct work_item_s *next;
+  cjson_t json;    /* The parsed request.  */
+  struct stream_s *stream;  /* The stream of the request or NULL.  */
+};
+
+/* The worker threads and their queue of requests.  */
+static struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;          /* Signaled on changes of the queue.  */
+  struct work_item_s *head;
+  struct work_item_s **tail;
+  unsigned int queued;          /* # of items in the queue.  */
+  int eof;                      /* Set if no more items are queued.  */
+  int nthreads;                 /* # of running threads.  */
+  pthread_t threads[MAX_WORKERS];
+} workers = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+
+/* Release the contexts in CACHE.  */
+static void
+release_contexts (struct context_cache_s *cache)
+{
+  gpgme_release (cache->openpgp);
+  gpgme_release (cache->cms);
+  gpgme_release (cache->conf);
+  memset (cache, 0, sizeof *cache);
+}
+
+
+/* The worker thread.  It processes queued requests with its own set
+ * of contexts and writes the responses as soon as they are ready.  */
+static void *
+worker_thread (void *arg)
+{
+  struct context_cache_s contexts;
+  struct work_item_s *item;
+  char *response;
+
+  (void)arg;
+
+  memset (&contexts, 0, sizeof contexts);
+  pthread_setspecific (worker_contexts_key, &contexts);
+
+  for (;;)
+    {
+      pthread_mutex_lock (&workers.lock);
+      while (!workers.head && !workers.eof)
+        pthread_cond_wait (&workers.cond, &workers.lock);
+      item = workers.head;
+      if (item)
+        {
+          workers.head = item->next;
+          if (!workers.head)
+            workers.tail = &workers.head;
+          workers.queued--;
+          pthread_cond_broadcast (&workers.cond);
+        }
+      pthread_mutex_unlock (&workers.lock);
+      if (!item)
+        break;
+
+      response = process_json_request (item->json);
+      if (opt_debug)
+        log_debug ("response='%s'\n", response);
+      if (!output_failed)
+        write_response (response);
+      xfree (response);
+      close_stream (item->stream);
+      xfree (item);
+    }
+
+  release_contexts (&contexts);
+  return NULL;
+}
+
+
+/* Start the worker threads unless they are already running.  Returns
+ * 0 on success.  */
+static int
+start_workers (void)
+{
+  int nthreads;
+  long ncpu;
+  int rc;
+
+  if (workers.nthreads)
+    return 0;
+
+  nthreads = opt_workers;
+  if (nthreads < 0)
+    {
+      /* The workers mostly wait for the engines and thus we use more
+       * threads than there are processors.  */
+      ncpu = sysconf (_SC_NPROCESSORS_ONLN);
+      nthreads = ncpu > MIN_WORKERS? (int)ncpu : MIN_WORKERS;
+    }
+  if (nthreads > MAX_WORKERS)
+    nthreads = MAX_WORKERS;
+
+  if (!worker_contexts_key_valid)
+    {
+      rc = pthread_key_create (&worker_contexts_key, NULL);
+      if (rc)
+        {
+          log_error ("error creating thread key: %s\n",
+                     gpg_strerror (gpg_error_from_errno (rc)));
+          return -1;
+        }
+      worker_contexts_key_valid = 1;
+    }
+
+  workers.tail = &workers.head;
+  while (workers.nthreads < nthreads)
+    {
+      rc = pthread_create (&workers.threads[workers.nthreads], NULL,
+                           worker_thread, NULL);
+      if (rc)
+        {
+          log_error ("error creating worker thread: %s\n",
+                     gpg_strerror (gpg_error_from_errno (rc)));
+          break;
+        }
+      workers.nthreads++;
+    }
+  if (opt_debug)
+    log_debug ("started %d worker threads\n", workers.nthreads);
+
+  return workers.nthreads? 0 : -1;
+}
+
+
+/* Queue the parsed request JSON with its STREAM, which may be NULL,
+ * for the worker threads.  Waits if too many requests are already
+ * queued.  */
+static void
+queue_request (cjson_t json, struct stream_s *stream)
+{
+  struct work_item_s *item;
+
+  item = xcalloc (1, sizeof *item);
+  item->json = json;
+  item->stream = stream;
+
+  pthread_mutex_lock (&workers.lock);
+  while (workers.queued >= MAX_QUEUED_REQUESTS)
+    pthread_cond_wait (&workers.cond, &workers.lock);
+  *workers.tail = item;
+  workers.tail = &item->next;
+  workers.queued++;
+  pthread_cond_broadcast (&workers.cond);
+  pthread_mutex_unlock (&workers.lock);
+}
+
+
+/* Abort all open streams whose input is not complete because no more
+ * input will arrive.  */
+static void
+abort_streams (void)
+{
+  struct stream_s *st;
+
+  pthread_mutex_lock (&stream_lock);
+  for (st = stream_list; st; st = st->next)
+    if (!st->eof)
+      st->aborted = 1;
+  pthread_cond_broadcast (&stream_cond);
+  pthread_mutex_unlock (&stream_lock);
+}
+
+
+/* Let the worker threads finish the queued requests and wait for
+ * them.  Streams still waiting for input are aborted.  */
+static void
+stop_workers (void)
+{
+  int i;
+
+  if (!workers.nthreads)
+    return;
+
+  abort_streams ();
+
+  pthread_mutex_lock (&workers.lock);
+  workers.eof = 1;
+  pthread_cond_broadcast (&workers.cond);
+  pthread_mutex_unlock (&workers.lock);
+
+  for (i = 0; i < workers.nthreads; i++)
+    pthread_join (workers.threads[i], NULL);
+  workers.nthreads = 0;
+}
+
+
+/* Return true if the parsed request JSON is for the operation OP.  */
+static int
+is_op_request (cjson_t json, const char *op)
+{
+  cjson_t j_op;
+
+  j_op = cJSON_GetObjectItem (json, "op");
+  return j_op && cjson_is_string (j_op) && !strcmp (j_op->valuestring, op);
+}
+
+
+/* Return true if the parsed request JSON shall be processed by a
+ * worker thread.  These are all requests with an id except for
+ * getmore, which only returns already computed data, and putdata,
+ * which only queues data for a stream.  */
+static int
+is_concurrent_request (cjson_t json)
+{
+  if (!opt_workers || !get_request_id_item (json))
+    return 0;
+  return !is_op_request (json, "getmore") && !is_op_request (json, "putdata");
+}
+
+
+/* Return true if the parsed request JSON starts a streaming
+ * operation.  */
+static int
+is_stream_request (cjson_t json)
+{
+  cjson_t j_item;
+
+  j_item = cJSON_GetObjectItem (json, "stream");
+  return j_item && cjson_is_true (j_item);
+}
+
+
+/* Open the stream for the parsed request JSON and store it at
+ * R_STREAM.  This is done by the main thread before the request is
+ * queued so that the input sent right after the request finds the
+ * stream.  Returns NULL on success or an error response; in the
+ * latter case JSON is released.  A stream occupies a worker thread
+ * while it waits for input and thus one worker is always kept free
+ * for other requests.  */
+static char *
+open_stream (cjson_t json, struct stream_s **r_stream)
+{
+  gpg_error_t err = 0;
+  struct stream_s *st;
+  cjson_t j_op;
+  cjson_t response;
+  char *res;
+
+  st = xcalloc (1, sizeof *st);
+  st->id = get_request_id (json);
+  st->j_id = cJSON_Duplicate (get_request_id_item (json), 0);
+  if (!st->j_id)
+    xoutofcore ("cJSON_Duplicate");
+  st->tail = &st->head;
+
+  pthread_mutex_lock (&stream_lock);
+  if (find_stream (st->id))
+    err = gpg_error (GPG_ERR_CONFLICT);
+  else if (stream_count + 1 >= workers.nthreads)
+    err = gpg_error (GPG_ERR_TOO_MANY);
+  else
+    {
+      st->next = stream_list;
+      stream_list = st;
+      stream_count++;
+    }
+  pthread_mutex_unlock (&stream_lock);
+
+  if (err)
+    {
+      response = xjson_CreateObject ();
+      if (gpg_err_code (err) == GPG_ERR_CONFLICT)
+        gpg_error_object (response, err,
+                          "A stream with this id is already open");
+      else
+        gpg_error_object (response, err, "Too many open streams");
+      j_op = cJSON_GetObjectItem (json, "op");
+      if (j_op && cjson_is_string (j_op))
+        xjson_AddStringToObject (response, "op", j_op->valuestring);
+      add_request_id (response, json);
+      res = print_response (NULL, response, 0);
+      cJSON_Delete (response);
+      cJSON_Delete (json);
+      cJSON_Delete (st->j_id);
+      xfree (st->id);
+      xfree (st);
+      *r_stream = NULL;
+      return res;
+    }
+
+  *r_stream = st;
+  return NULL;
+}
+
+
+/* Queue the input data of the "putdata" request JSON.  Returns NULL
+ * on success or an error response.  This is run by the main thread
+ * and does not wait because the worker which is supposed to read the
+ * data may not yet be running.  */
+static char *
+put_stream_data (cjson_t json)
+{
+  gpg_error_t err = 0;
+  struct stream_s *st;
+  struct stream_chunk_s *chunk = NULL;
+  gpgrt_b64state_t state;
+  cjson_t j_data;
+  cjson_t response;
+  size_t len = 0;
+  int more;
+  char *id;
+  char *res;
+
+  id = get_request_id (json);
+  if ((err = get_boolean_flag (json, "more", 0, &more)))
+    goto leave;
+
+  j_data = cJSON_GetObjectItem (json, "data");
+  if (j_data && !cjson_is_string (j_data))
+    {
+      err = gpg_error (GPG_ERR_INV_VALUE);
+      goto leave;
+    }
+  if (j_data)
+    {
+      /* Decode in place.  */
+      state = gpgrt_b64dec_start (NULL);
+      if (!state)
+        {
+          err = gpg_error_from_syserror ();
+          goto leave;
+        }
+      err = gpg_error (gpgrt_b64dec_proc (state, j_data->valuestring,
+                                          strlen (j_data->valuestring),
+                                          &len));
+      if (!err)
+        err = gpg_error (gpgrt_b64dec_finish (state));
+      else
+        gpgrt_b64dec_finish (state);
+      if (err)
+        goto leave;
+      chunk = xtrymalloc (sizeof *chunk + len);
+      if (!chunk)
+        {
+          err = gpg_error_from_syserror ();
+          goto leave;
+        }
+      memcpy (chunk->data, j_data->valuestring, len);
+      chunk->length = len;
+    }
+
+  pthread_mutex_lock (&stream_lock);
+  st = id? find_stream (id) : NULL;
+  if (!st || st->eof)
+    err = gpg_error (GPG_ERR_NO_DATA);
+  else if (st->queued && st->queued + len > MAX_STREAM_QUEUED)
+    err = gpg_error (GPG_ERR_TOO_LARGE);
+  else
+    {
+      if (chunk && len)
+        {
+          *st->tail = chunk;
+          st->tail = &chunk->next;
+          st->queued += len;
+          chunk = NULL;
+        }
+      if (!more)
+        st->eof = 1;
+      pthread_cond_broadcast (&stream_cond);
+    }
+  pthread_mutex_unlock (&stream_lock);
+
+ leave:
+  xfree (chunk);
+  xfree (id);
+  if (!err)
+    {
+      cJSON_Delete (json);
+      return NULL;
+    }
+
+  response = xjson_CreateObject ();
+  if (gpg_err_code (err) == GPG_ERR_NO_DATA)
+    gpg_error_object (response, err, "No open stream for this id");
+  else if (gpg_err_code (err) == GPG_ERR_TOO_LARGE)
+    gpg_error_object (response, err, "Too much data queued;"
+                      " wait for the acknowledgement of the last chunk");
+  else
+    gpg_error_object (response, err, "Error processing data: %s",
+                      gpg_strerror (err));
+  xjson_AddStringToObject (response, "op", "putdata");
+  add_request_id (response, json);
+  res = print_response (NULL, response, 0);
+  cJSON_Delete (response);
+  cJSON_Delete (json);
+  return res;
+}
+#endif /*HAVE_PTHREAD*/
+
+
+/* The Native Messaging processing loop.  Requests with an id are
+ * processed concurrently and their responses are written as soon as
+ * they are ready, carrying the same id.  All other requests are
+ * processed in order.  */
 static void
 native_messaging_repl (void)
 {
   gpg_error_t err;
-  uint32_t nrequest, nresponse;
+  uint32_t nrequest;
   char *request = NULL;
   char *response = NULL;
+  cjson_t json;
+#ifdef HAVE_PTHREAD
+  struct stream_s *stream;
+#endif
   size_t n;
 
   /* Due to the length octets we need to switch the I/O stream into
@@ -3751,47 +4874,43 @@ native_messaging_repl (void)
           if (opt_debug)
             log_debug ("request='%s'\n", request);
           xfree (response);
-          response = process_request (request);
-          if (opt_debug)
+          response = NULL;
+          json = cJSON_Parse (request, NULL);
+#ifdef HAVE_PTHREAD
+          if (json && opt_workers && is_op_request (json, "putdata"))
+            response = put_stream_data (json);
+          else if (json && is_concurrent_request (json) && !start_workers ())
+            {
+              stream = NULL;
+              if (is_stream_request (json))
+                response = open_stream (json, &stream);
+              if (!response)
+                queue_request (json, stream);
+            }
+          else
+#endif
+          if (json)
+            response = process_json_request (json);
+          else
+            response = process_request (request);
+          if (opt_debug && response)
             log_debug ("response='%s'\n", response);
         }
-      nresponse = strlen (response);
 
       /* Write response */
-      if (es_write (es_stdout, &nresponse, sizeof nresponse, &n))
-        {
-          err = gpg_error_from_syserror ();
-          log_error ("error writing request header: %s\n", gpg_strerror (err));
-          break;
-        }
-      if (n != sizeof nresponse)
-        {
-          log_error ("error writing request header: short write\n");
-          break;
-        }
-      if (es_write (es_stdout, response, nresponse, &n))
-        {
-          err = gpg_error_from_syserror ();
-          log_error ("error writing request: %s\n", gpg_strerror (err));
-          break;
-        }
-      if (n != nresponse)
-        {
-          log_error ("error writing request: short write\n");
-          break;
-        }
-      if (es_fflush (es_stdout) || es_ferror (es_stdout))
-        {
-          err = gpg_error_from_syserror ();
-          log_error ("error writing request: %s\n", gpg_strerror (err));
-          break;
-        }
+      if (response && write_response (response))
+        break;
+      if (output_failed)
+        break;
       xfree (response);
       response = NULL;
       xfree (request);
       request = NULL;
     }
 
+#ifdef HAVE_PTHREAD
+  stop_workers ();
+#endif
   xfree (response);
   xfree (request);
 }
@@ -3841,7 +4960,8 @@ main (int argc, char *argv[])
          CMD_LIBVERSION  = 501,
   } cmd = CMD_DEFAULT;
   enum {
-    OPT_DEBUG = 600
+    OPT_DEBUG = 600,
+    OPT_WORKERS
   };
 
   static gpgrt_opt_t opts[] = {
@@ -3849,6 +4969,8 @@ main (int argc, char *argv[])
     ARGPARSE_c  (CMD_SINGLE,      "single",      "Single request mode"),
     ARGPARSE_c  (CMD_LIBVERSION,  "lib-version", "Show library version"),
     ARGPARSE_s_n(OPT_DEBUG,       "debug",       "Flyswatter"),
+    ARGPARSE_s_i(OPT_WORKERS,     "workers",
+                 "|N|process requests with an id using N threads"),
 
     ARGPARSE_end()
   };
@@ -3882,6 +5004,7 @@ main (int argc, char *argv[])
           break;
 
         case OPT_DEBUG: opt_debug = 1; break;
+        case OPT_WORKERS: opt_workers = pargs.r.ret_int; break;
 
         default:
           pargs.err = ARGPARSE_PRINT_WARNING;
@@ -50,9 +50,12 @@ static char *def_lc_messages;
 
 gpgme_error_t _gpgme_selftest = GPG_ERR_NOT_OPERATIONAL;
 
-/* Protects all reference counters in result structures.  All other
-   accesses to a result structure are read only.  */
+/* Protects all reference counters in result structures if the
+   compiler does not provide atomic operations.  All other accesses to
+   a result structure are read only.  */
+#ifndef HAVE_ATOMIC_BUILTINS
 DEFINE_STATIC_LOCK (result_ref_lock);
+#endif
 
 
 /* Set the global flag NAME to VALUE.  Return 0 on success.  Note that
@@ -81,6 +84,10 @@ gpgme_set_global_flag (const char *name, const char *value)
     return _gpgme_set_default_gpg_name (value);
   else if (!strcmp (name, "w32-inst-dir"))
     return _gpgme_set_override_inst_dir (value);
+  else if (!strcmp (name, "key-cache"))
+    return _gpgme_keycache_set_ttl (value);
+  else if (!strcmp (name, "engine-pool"))
+    return _gpgme_engine_pool_set_max (value);
   else
     return -1;
 }
@@ -253,6 +260,7 @@ gpgme_release (gpgme_ctx_t ctx)
   free (ctx->request_origin);
   free (ctx->auto_key_locate);
   free (ctx->trust_model);
+  free (ctx->io_buffer_size);
   _gpgme_engine_info_release (ctx->engine_info);
   ctx->engine_info = NULL;
   DESTROY_LOCK (ctx->lock);
@@ -272,9 +280,7 @@ gpgme_result_ref (void *result)
 
   assert (data->magic == CTX_OP_DATA_MAGIC);
 
-  LOCK (result_ref_lock);
-  data->references++;
-  UNLOCK (result_ref_lock);
+  REFCOUNT_INC (result_ref_lock, &data->references);
 }
 
 
@@ -282,6 +288,7 @@ void
 gpgme_result_unref (void *result)
 {
   struct ctx_op_data *data;
+  int refs;
 
   if (! result)
     return;
@@ -290,13 +297,9 @@ gpgme_result_unref (void *result)
 
   assert (data->magic == CTX_OP_DATA_MAGIC);
 
-  LOCK (result_ref_lock);
-  if (--data->references)
-    {
-      UNLOCK (result_ref_lock);
-      return;
-    }
-  UNLOCK (result_ref_lock);
+  REFCOUNT_DEC (result_ref_lock, &data->references, refs);
+  if (refs)
+    return;
 
   if (data->cleanup)
     (*data->cleanup) (data->hook);
@@ -578,6 +581,22 @@ gpgme_set_ctx_flag (gpgme_ctx_t ctx, const char *name, const char *value)
     {
       ctx->extended_edit = abool;
     }
+  else if (!strcmp (name, "io-buffer-size"))
+    {
+      char *endp;
+      unsigned long n;
+
+      n = *value? strtoul (value, &endp, 10) : 0;
+      if (*value && (*endp || n > MAX_IO_BUFFER_SIZE))
+        err = gpg_error (GPG_ERR_INV_VALUE);
+      else
+        {
+          free (ctx->io_buffer_size);
+          ctx->io_buffer_size = n? strdup (value) : NULL;
+          if (n && !ctx->io_buffer_size)
+            err = gpg_error_from_syserror ();
+        }
+    }
   else
     err = gpg_error (GPG_ERR_UNKNOWN_NAME);
 
@@ -647,6 +666,10 @@ gpgme_get_ctx_flag (gpgme_ctx_t ctx, const char *name)
     {
       return ctx->extended_edit ? "1":"";
     }
+  else if (!strcmp (name, "io-buffer-size"))
+    {
+      return ctx->io_buffer_size? ctx->io_buffer_size : "";
+    }
   else
     return NULL;
 }
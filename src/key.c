@@ -22,7 +22,9 @@
 #if HAVE_CONFIG_H
 #include <config.h>
 #endif
+#include <stddef.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
@@ -35,23 +37,116 @@
 
 
 
-/* Protects all reference counters in keys.  All other accesses to a
-   key are read only.  */
+/* Protects all reference counters in keys if the compiler does not
+   provide atomic operations.  All other accesses to a key are read
+   only.  */
+#ifndef HAVE_ATOMIC_BUILTINS
 DEFINE_STATIC_LOCK (key_ref_lock);
+#endif
+
+
+/* All subkeys, user IDs, signatures and strings of a key are
+   allocated from an arena owned by the key.  The arena is stored in
+   front of the public key object, so that releasing a key takes one
+   call to free for the key and one for each additional chunk.  */
+#define KEY_ARENA_ALIGN 8
+#define KEY_ARENA_INITIAL_SIZE 1024
+#define KEY_ARENA_MIN_CHUNK_SIZE 512
+#define KEY_ARENA_MAX_CHUNK_SIZE (16 * 1024)
+
+struct key_arena_chunk_s
+{
+  struct key_arena_chunk_s *next;
+};
+
+struct key_block_s
+{
+  /* Additional chunks of the arena.  */
+  struct key_arena_chunk_s *chunks;
+
+  /* The free space of the current chunk.  */
+  char *ptr;
+  size_t avail;
+
+  /* The size of the next chunk.  */
+  size_t next_size;
+
+  struct _gpgme_key key;
+};
+
+#define KEY_BLOCK(key) \
+  ((struct key_block_s *) ((char *) (key) \
+                           - offsetof (struct key_block_s, key)))
+
+
+/* Return SIZE zeroed bytes from the arena of KEY or NULL with ERRNO
+   set.  The memory is released along with the key.  */
+void *
+_gpgme_key_alloc (gpgme_key_t key, size_t size)
+{
+  struct key_block_s *block = KEY_BLOCK (key);
+  struct key_arena_chunk_s *chunk;
+  size_t pad, chunk_size;
+  char *p;
+
+  pad = (KEY_ARENA_ALIGN - ((uintptr_t) block->ptr % KEY_ARENA_ALIGN))
+    % KEY_ARENA_ALIGN;
+  if (block->avail < pad || block->avail - pad < size)
+    {
+      chunk_size = block->next_size;
+      if (chunk_size < KEY_ARENA_MAX_CHUNK_SIZE)
+        block->next_size *= 2;
+      /* The header of a chunk is smaller than the alignment.  */
+      if (chunk_size < size + KEY_ARENA_ALIGN)
+        chunk_size = size + KEY_ARENA_ALIGN;
+      chunk = malloc (chunk_size);
+      if (!chunk)
+        return NULL;
+      chunk->next = block->chunks;
+      block->chunks = chunk;
+      block->ptr = (char *) chunk + KEY_ARENA_ALIGN;
+      block->avail = chunk_size - KEY_ARENA_ALIGN;
+      pad = 0;
+    }
+
+  p = block->ptr + pad;
+  block->ptr = p + size;
+  block->avail -= pad + size;
+  memset (p, 0, size);
+  return p;
+}
+
+
+/* Return a copy of STRING allocated from the arena of KEY or NULL
+   with ERRNO set.  */
+char *
+_gpgme_key_strdup (gpgme_key_t key, const char *string)
+{
+  size_t len = strlen (string) + 1;
+  char *p;
+
+  p = _gpgme_key_alloc (key, len);
+  if (p)
+    memcpy (p, string, len);
+  return p;
+}
 
 
 /* Create a new key.  */
 gpgme_error_t
 _gpgme_key_new (gpgme_key_t *r_key)
 {
-  gpgme_key_t key;
+  struct key_block_s *block;
 
-  key = calloc (1, sizeof *key);
-  if (!key)
+  block = calloc (1, KEY_ARENA_INITIAL_SIZE);
+  if (!block)
     return gpg_error_from_syserror ();
-  key->_refs = 1;
+  block->ptr = (char *) (block + 1);
+  block->avail = KEY_ARENA_INITIAL_SIZE - sizeof *block;
+  block->next_size = KEY_ARENA_MIN_CHUNK_SIZE;
+  block->key._refs = 1;
 
-  *r_key = key;
+  *r_key = &block->key;
   return 0;
 }
 
@@ -61,7 +156,7 @@ _gpgme_key_add_subkey (gpgme_key_t key, gpgme_subkey_t *r_subkey)
 {
   gpgme_subkey_t subkey;
 
-  subkey = calloc (1, sizeof *subkey);
+  subkey = _gpgme_key_alloc (key, sizeof *subkey);
   if (!subkey)
     return gpg_error_from_syserror ();
   subkey->keyid = subkey->_keyid;
@@ -209,16 +304,17 @@ _gpgme_key_append_name (gpgme_key_t key, const char *src, int convert)
 {
   gpgme_user_id_t uid;
   char *dst;
+  char *address;
   int src_len = strlen (src);
 
   assert (key);
-  /* We can malloc a buffer of the same length, because the converted
-     string will never be larger. Actually we allocate it twice the
-     size, so that we are able to store the parsed stuff there too.  */
-  uid = malloc (sizeof (*uid) + 2 * src_len + 3);
+  /* We can allocate a buffer of the same length, because the
+     converted string will never be larger. Actually we allocate it
+     twice the size, so that we are able to store the parsed stuff
+     there too.  */
+  uid = _gpgme_key_alloc (key, sizeof (*uid) + 2 * src_len + 3);
   if (!uid)
     return gpg_error_from_syserror ();
-  memset (uid, 0, sizeof *uid);
 
   uid->uid = ((char *) uid) + sizeof (*uid);
   dst = uid->uid;
@@ -235,7 +331,14 @@ _gpgme_key_append_name (gpgme_key_t key, const char *src, int convert)
     parse_user_id (uid->uid, &uid->name, &uid->email,
 		   &uid->comment, dst);
 
-  uid->address = _gpgme_mailbox_from_userid (uid->uid);
+  address = _gpgme_mailbox_from_userid (uid->uid);
+  if (address)
+    {
+      uid->address = _gpgme_key_strdup (key, address);
+      free (address);
+      if (!uid->address)
+        return gpg_error_from_syserror ();
+    }
   if ((!uid->email || !*uid->email) && uid->address && uid->name
       && !strcmp (uid->name, uid->address))
     {
@@ -267,13 +370,13 @@ _gpgme_key_add_sig (gpgme_key_t key, char *src)
   uid = key->_last_uid;
   assert (uid);	/* XXX */
 
-  /* We can malloc a buffer of the same length, because the converted
-     string will never be larger.  Actually we allocate it twice the
-     size, so that we are able to store the parsed stuff there too.  */
-  sig = malloc (sizeof (*sig) + 2 * src_len + 3);
+  /* We can allocate a buffer of the same length, because the
+     converted string will never be larger.  Actually we allocate it
+     twice the size, so that we are able to store the parsed stuff
+     there too.  */
+  sig = _gpgme_key_alloc (key, sizeof (*sig) + 2 * src_len + 3);
   if (!sig)
     return NULL;
-  memset (sig, 0, sizeof *sig);
 
   sig->keyid = sig->_keyid;
   sig->_keyid[16] = '\0';
@@ -308,9 +411,7 @@ _gpgme_key_add_sig (gpgme_key_t key, char *src)
 void
 gpgme_key_ref (gpgme_key_t key)
 {
-  LOCK (key_ref_lock);
-  key->_refs++;
-  UNLOCK (key_ref_lock);
+  REFCOUNT_INC (key_ref_lock, &key->_refs);
 }
 
 
@@ -322,80 +423,43 @@ gpgme_key_ref (gpgme_key_t key)
 void
 gpgme_key_unref (gpgme_key_t key)
 {
+  struct key_block_s *block;
+  struct key_arena_chunk_s *chunk;
   gpgme_user_id_t uid;
-  gpgme_subkey_t subkey;
+  gpgme_key_sig_t keysig;
+  unsigned int refs;
 
   if (!key)
     return;
 
-  LOCK (key_ref_lock);
   assert (key->_refs > 0);
-  if (--key->_refs)
-    {
-      UNLOCK (key_ref_lock);
-      return;
-    }
-  UNLOCK (key_ref_lock);
-
-  subkey = key->subkeys;
-  while (subkey)
-    {
-      gpgme_subkey_t next = subkey->next;
-      free (subkey->fpr);
-      free (subkey->curve);
-      free (subkey->keygrip);
-      free (subkey->card_number);
-      free (subkey);
-      subkey = next;
-    }
+  REFCOUNT_DEC (key_ref_lock, &key->_refs, refs);
+  if (refs)
+    return;
 
-  uid = key->uids;
-  while (uid)
-    {
-      gpgme_user_id_t next_uid = uid->next;
-      gpgme_key_sig_t keysig = uid->signatures;
-      gpgme_tofu_info_t tofu = uid->tofu;
+  /* Notations are created by the generic notation parser and are
+     thus not part of the arena.  */
+  for (uid = key->uids; uid; uid = uid->next)
+    for (keysig = uid->signatures; keysig; keysig = keysig->next)
+      {
+        gpgme_sig_notation_t notation = keysig->notations;
 
-      while (keysig)
-	{
-	  gpgme_key_sig_t next_keysig = keysig->next;
-	  gpgme_sig_notation_t notation = keysig->notations;
+        while (notation)
+          {
+            gpgme_sig_notation_t next_notation = notation->next;
 
-	  while (notation)
-	    {
-	      gpgme_sig_notation_t next_notation = notation->next;
+            _gpgme_sig_notation_free (notation);
+            notation = next_notation;
+          }
+      }
 
-	      _gpgme_sig_notation_free (notation);
-	      notation = next_notation;
-	    }
-
-          free (keysig);
-	  keysig = next_keysig;
-        }
-
-      while (tofu)
-        {
-          /* NB: The ->next is currently not used but we are prepared
-           * for it.  */
-          gpgme_tofu_info_t tofu_next = tofu->next;
-
-          free (tofu->description);
-          free (tofu);
-          tofu = tofu_next;
-        }
-
-      free (uid->address);
-      free (uid->uidhash);
-      free (uid);
-      uid = next_uid;
+  block = KEY_BLOCK (key);
+  while ((chunk = block->chunks))
+    {
+      block->chunks = chunk->next;
+      free (chunk);
     }
-
-  free (key->issuer_serial);
-  free (key->issuer_name);
-  free (key->chain_id);
-  free (key->fpr);
-
-  free (key);
+  free (block);
 }
 
 
@@ -0,0 +1,358 @@
+/* keycache.c - A process wide cache for gpgme_get_key.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "util.h"
+#include "ops.h"
+#include "context.h"
+#include "sema.h"
+#include "debug.h"
+
+
+/* The key cache is disabled by default.  It is enabled by setting the
+   global flag "key-cache" to the number of seconds an entry may be
+   used.  Entries are also invalidated as soon as one of the files
+   below in the home directory of the engine changes.  Only lookups by
+   fingerprint are cached.  */
+#define KEYCACHE_BUCKETS 256
+#define KEYCACHE_MAX_ENTRIES 4096
+
+static const char *stamp_files[] =
+  {
+    "pubring.kbx",
+    "pubring.gpg",
+    "trustdb.gpg",
+    "trustlist.txt",
+    "public-keys.d/pubring.db",
+    "private-keys-v1.d"
+  };
+
+/* The state of one of the STAMP_FILES.  A file which does not exist
+   has all fields set to zero.  */
+struct stamp_s
+{
+  time_t mtime;
+  time_t ctime;
+  off_t size;
+  ino_t ino;
+};
+
+struct keycache_item_s
+{
+  struct keycache_item_s *next;
+  unsigned int hash;
+  gpgme_protocol_t protocol;
+  gpgme_keylist_mode_t mode;
+  int secret;
+  time_t expires;
+  struct stamp_s stamps[DIM (stamp_files)];
+  gpgme_key_t key;
+  char *homedir;
+  char fpr[1];
+};
+
+DEFINE_STATIC_LOCK (keycache_lock);
+
+/* The time to live of an entry in seconds; 0 disables the cache.  */
+static unsigned int keycache_ttl;
+
+static struct keycache_item_s *keycache[KEYCACHE_BUCKETS];
+static unsigned int keycache_entries;
+static unsigned long keycache_hits;
+static unsigned long keycache_misses;
+
+
+static void
+release_item (struct keycache_item_s *item)
+{
+  gpgme_key_unref (item->key);
+  free (item);
+}
+
+
+/* Remove all entries.  Must be called with KEYCACHE_LOCK held.  */
+static void
+flush_cache (void)
+{
+  struct keycache_item_s *item;
+  int i;
+
+  for (i = 0; i < KEYCACHE_BUCKETS; i++)
+    while ((item = keycache[i]))
+      {
+        keycache[i] = item->next;
+        release_item (item);
+      }
+  keycache_entries = 0;
+}
+
+
+/* Set the time to live of cache entries to the number of seconds
+   given by VALUE and flush the cache.  A value of 0 disables the
+   cache.  Returns 0 on success.  */
+int
+_gpgme_keycache_set_ttl (const char *value)
+{
+  unsigned long ttl;
+  char *endp;
+
+  errno = 0;
+  ttl = strtoul (value, &endp, 10);
+  if (errno || endp == value || *endp || ttl > 86400 * 365)
+    return -1;
+
+  LOCK (keycache_lock);
+  flush_cache ();
+  keycache_ttl = ttl;
+  UNLOCK (keycache_lock);
+  return 0;
+}
+
+
+/* Store the state of the STAMP_FILES in HOMEDIR at STAMPS.  */
+static void
+get_stamps (const char *homedir, struct stamp_s *stamps)
+{
+  struct stat st;
+  char *fname;
+  int i;
+
+  for (i = 0; i < DIM (stamp_files); i++)
+    {
+      memset (&stamps[i], 0, sizeof stamps[i]);
+      fname = _gpgme_strconcat (homedir, "/", stamp_files[i], NULL);
+      if (fname && !stat (fname, &st))
+        {
+          stamps[i].mtime = st.st_mtime;
+          stamps[i].ctime = st.st_ctime;
+          stamps[i].size = st.st_size;
+          stamps[i].ino = st.st_ino;
+        }
+      free (fname);
+    }
+}
+
+
+static int
+stamps_equal (const struct stamp_s *a, const struct stamp_s *b)
+{
+  int i;
+
+  for (i = 0; i < DIM (stamp_files); i++)
+    if (a[i].mtime != b[i].mtime || a[i].ctime != b[i].ctime
+        || a[i].size != b[i].size || a[i].ino != b[i].ino)
+      return 0;
+  return 1;
+}
+
+
+/* Return true if FPR looks like a fingerprint.  */
+static int
+is_fingerprint (const char *fpr)
+{
+  size_t n;
+
+  for (n = 0; fpr[n]; n++)
+    if (!strchr ("0123456789ABCDEFabcdef", fpr[n]))
+      return 0;
+  return n == 32 || n == 40 || n == 64;
+}
+
+
+/* Return true if A and B describe the same lookup.  */
+static int
+same_lookup (struct keycache_item_s *a, struct keycache_item_s *b)
+{
+  return (a->hash == b->hash
+          && a->protocol == b->protocol
+          && a->mode == b->mode
+          && a->secret == b->secret
+          && !strcmp (a->fpr, b->fpr)
+          && !strcmp (a->homedir, b->homedir));
+}
+
+
+/* Look up the key FPR for the protocol, keylist mode and home
+   directory of CTX in the cache.  On a hit the key is stored with an
+   additional reference at R_KEY.  On a miss NULL is stored at R_KEY
+   and if the lookup can be cached a new item is stored at R_ITEM;
+   this must be passed to _gpgme_keycache_put after the key has been
+   listed.  The state of the keyring files is recorded before the
+   listing so that a concurrent change invalidates the entry.  */
+gpgme_error_t
+_gpgme_keycache_get (gpgme_ctx_t ctx, const char *fpr, int secret,
+                     gpgme_key_t *r_key, struct keycache_item_s **r_item)
+{
+  struct keycache_item_s *item, **itemp;
+  gpgme_engine_info_t info;
+  const char *homedir;
+  unsigned int hash;
+  size_t fprlen;
+  int enabled;
+  time_t now;
+  size_t i;
+
+  *r_key = NULL;
+  *r_item = NULL;
+
+  LOCK (keycache_lock);
+  enabled = !!keycache_ttl;
+  UNLOCK (keycache_lock);
+  if (!enabled || !is_fingerprint (fpr)
+      || (ctx->keylist_mode & GPGME_KEYLIST_MODE_EXTERN))
+    return 0;
+
+  for (info = ctx->engine_info; info; info = info->next)
+    if (info->protocol == ctx->protocol)
+      break;
+  if (info && info->home_dir)
+    homedir = info->home_dir;
+  else
+    homedir = _gpgme_get_default_homedir ();
+  if (!homedir)
+    return 0;
+
+  fprlen = strlen (fpr);
+  item = calloc (1, sizeof *item + fprlen + strlen (homedir) + 1);
+  if (!item)
+    return gpg_error_from_syserror ();
+  for (i = 0, hash = 0; i < fprlen; i++)
+    {
+      item->fpr[i] = fpr[i];
+      if (item->fpr[i] >= 'a' && item->fpr[i] <= 'f')
+        item->fpr[i] -= 'a' - 'A';
+      hash = hash * 31 + item->fpr[i];
+    }
+  item->homedir = item->fpr + fprlen + 1;
+  strcpy (item->homedir, homedir);
+  item->hash = hash;
+  item->protocol = ctx->protocol;
+  item->mode = ctx->keylist_mode;
+  item->secret = !!secret;
+  get_stamps (homedir, item->stamps);
+  now = time (NULL);
+
+  LOCK (keycache_lock);
+  if (!keycache_ttl)
+    {
+      /* Disabled in the meantime.  */
+      UNLOCK (keycache_lock);
+      free (item);
+      return 0;
+    }
+  itemp = &keycache[hash % KEYCACHE_BUCKETS];
+  while (*itemp)
+    {
+      struct keycache_item_s *old = *itemp;
+
+      if (same_lookup (old, item))
+        {
+          if (old->expires > now && stamps_equal (old->stamps, item->stamps))
+            {
+              gpgme_key_ref (old->key);
+              *r_key = old->key;
+              keycache_hits++;
+              UNLOCK (keycache_lock);
+              free (item);
+              TRACE (DEBUG_CTX, "_gpgme_keycache_get", ctx,
+                     "hit for %s", fpr);
+              return 0;
+            }
+          /* Outdated.  */
+          *itemp = old->next;
+          keycache_entries--;
+          release_item (old);
+          break;
+        }
+      itemp = &old->next;
+    }
+  keycache_misses++;
+  item->expires = now + keycache_ttl;
+  UNLOCK (keycache_lock);
+
+  *r_item = item;
+  return 0;
+}
+
+
+/* Insert ITEM as returned by _gpgme_keycache_get with KEY into the
+   cache.  If KEY is NULL ITEM is released.  */
+void
+_gpgme_keycache_put (struct keycache_item_s *item, gpgme_key_t key)
+{
+  struct keycache_item_s *old;
+
+  if (!item)
+    return;
+  if (!key)
+    {
+      free (item);
+      return;
+    }
+
+  gpgme_key_ref (key);
+  item->key = key;
+
+  LOCK (keycache_lock);
+  if (!keycache_ttl)
+    {
+      UNLOCK (keycache_lock);
+      release_item (item);
+      return;
+    }
+  /* Another thread may have inserted the same key meanwhile.  */
+  for (old = keycache[item->hash % KEYCACHE_BUCKETS]; old; old = old->next)
+    if (same_lookup (old, item))
+      {
+        UNLOCK (keycache_lock);
+        release_item (item);
+        return;
+      }
+  /* Keep the cache bounded in a simple way.  */
+  if (keycache_entries >= KEYCACHE_MAX_ENTRIES)
+    flush_cache ();
+  item->next = keycache[item->hash % KEYCACHE_BUCKETS];
+  keycache[item->hash % KEYCACHE_BUCKETS] = item;
+  keycache_entries++;
+  UNLOCK (keycache_lock);
+}
+
+
+/* Return the number of cache hits and misses of gpgme_get_key since
+   the start of the process.  */
+void
+gpgme_key_cache_stats (unsigned long *r_hits, unsigned long *r_misses)
+{
+  LOCK (keycache_lock);
+  if (r_hits)
+    *r_hits = keycache_hits;
+  if (r_misses)
+    *r_misses = keycache_misses;
+  UNLOCK (keycache_lock);
+}
@@ -45,11 +45,9 @@
 #include "debug.h"
 
 
-struct key_queue_item_s
-{
-  struct key_queue_item_s *next;
-  gpgme_key_t key;
-};
+/* The initial number of slots of the key queue.  Must be a power of
+   two.  */
+#define KEY_QUEUE_INITIAL_SIZE 64
 
 typedef struct
 {
@@ -68,7 +66,13 @@ typedef struct
 
   /* Something new is available.  */
   int key_cond;
-  struct key_queue_item_s *key_queue;
+
+  /* The queue of listed keys is a ring buffer of KEY_QUEUE_SIZE
+     slots with KEY_QUEUE_LEN keys starting at KEY_QUEUE_HEAD.  */
+  gpgme_key_t *key_queue;
+  size_t key_queue_size;
+  size_t key_queue_head;
+  size_t key_queue_len;
 } *op_data_t;
 
 
@@ -76,7 +80,7 @@ static void
 release_op_data (void *hook)
 {
   op_data_t opd = (op_data_t) hook;
-  struct key_queue_item_s *key = opd->key_queue;
+  size_t i;
 
   if (opd->tmp_key)
     gpgme_key_unref (opd->tmp_key);
@@ -84,13 +88,56 @@ release_op_data (void *hook)
   /* opd->tmp_uid and opd->tmp_keysig are actually part of opd->tmp_key,
      so we do not need to release them here.  */
 
-  while (key)
+  for (i = 0; i < opd->key_queue_len; i++)
+    gpgme_key_unref (opd->key_queue[(opd->key_queue_head + i)
+                                     & (opd->key_queue_size - 1)]);
+  free (opd->key_queue);
+}
+
+
+/* Append KEY to the key queue of OPD.  */
+static gpg_error_t
+key_queue_push (op_data_t opd, gpgme_key_t key)
+{
+  if (opd->key_queue_len == opd->key_queue_size)
     {
-      struct key_queue_item_s *next = key->next;
+      size_t newsize, i;
+      gpgme_key_t *newqueue;
 
-      gpgme_key_unref (key->key);
-      key = next;
+      newsize = opd->key_queue_size? 2 * opd->key_queue_size
+        /**/                         : KEY_QUEUE_INITIAL_SIZE;
+      newqueue = malloc (newsize * sizeof *newqueue);
+      if (!newqueue)
+        return gpg_error_from_syserror ();
+      for (i = 0; i < opd->key_queue_len; i++)
+        newqueue[i] = opd->key_queue[(opd->key_queue_head + i)
+                                     & (opd->key_queue_size - 1)];
+      free (opd->key_queue);
+      opd->key_queue = newqueue;
+      opd->key_queue_size = newsize;
+      opd->key_queue_head = 0;
     }
+
+  opd->key_queue[(opd->key_queue_head + opd->key_queue_len)
+                 & (opd->key_queue_size - 1)] = key;
+  opd->key_queue_len++;
+  return 0;
+}
+
+
+/* Remove the first key from the key queue of OPD and return it.  The
+   queue must not be empty.  */
+static gpgme_key_t
+key_queue_pop (op_data_t opd)
+{
+  gpgme_key_t key;
+
+  assert (opd->key_queue_len);
+  key = opd->key_queue[opd->key_queue_head];
+  opd->key_queue_head = (opd->key_queue_head + 1) & (opd->key_queue_size - 1);
+  if (!--opd->key_queue_len)
+    opd->key_queue_head = 0;
+  return key;
 }
 
 
@@ -418,7 +465,7 @@ parse_sec_field15 (gpgme_key_t key, gpgme_subkey_t subkey, char *field)
       /* Fields starts with a hex digit; thus it is a serial number.  */
       key->secret = 1;
       subkey->is_cardkey = 1;
-      subkey->card_number = strdup (field);
+      subkey->card_number = _gpgme_key_strdup (key, field);
       if (!subkey->card_number)
         return gpg_error_from_syserror ();
     }
@@ -438,10 +485,12 @@ parse_sec_field15 (gpgme_key_t key, gpgme_subkey_t subkey, char *field)
 
 /* Parse a tfs record.  */
 static gpg_error_t
-parse_tfs_record (gpgme_user_id_t uid, char **field, int nfield)
+parse_tfs_record (gpgme_key_t key, gpgme_user_id_t uid,
+                  char **field, int nfield)
 {
   gpg_error_t err;
-  gpgme_tofu_info_t ti;
+  struct _gpgme_tofu_info tibuf;
+  gpgme_tofu_info_t ti = &tibuf;
   unsigned long uval;
 
   /* We add only the first TOFU record in case future versions emit
@@ -453,9 +502,7 @@ parse_tfs_record (gpgme_user_id_t uid, char **field, int nfield)
   if (nfield < 8 || atoi(field[1]) != 1)
     return trace_gpg_error (GPG_ERR_INV_ENGINE);
 
-  ti = calloc (1, sizeof *ti);
-  if (!ti)
-    return gpg_error_from_syserror ();
+  memset (&tibuf, 0, sizeof tibuf);
 
   /* Note that we allow a value of up to 7 which is what we can store
    * in the ti->validity.  */
@@ -519,11 +566,14 @@ parse_tfs_record (gpgme_user_id_t uid, char **field, int nfield)
     }
 
   /* Ready.  */
+  ti = _gpgme_key_alloc (key, sizeof *ti);
+  if (!ti)
+    return gpg_error_from_syserror ();
+  *ti = tibuf;
   uid->tofu = ti;
   return 0;
 
  inv_engine:
-  free (ti);
   return trace_gpg_error (GPG_ERR_INV_ENGINE);
 }
 
@@ -582,41 +632,29 @@ keylist_colon_handler (void *priv, char *line)
       return 0;
     }
 
-  while (line && fields < NR_FIELDS)
+  fields = _gpgme_split_colon_fields (line, field, NR_FIELDS);
+
+  switch (_gpgme_colon_rectype (field[0]))
     {
-      field[fields++] = line;
-      line = strchr (line, ':');
-      if (line)
-	*(line++) = '\0';
+    case COLON_RECTYPE ('s','i','g',0): rectype = RT_SIG; break;
+    case COLON_RECTYPE ('r','e','v',0): rectype = RT_REV; break;
+    case COLON_RECTYPE ('p','u','b',0): rectype = RT_PUB; break;
+    case COLON_RECTYPE ('s','e','c',0): rectype = RT_SEC; break;
+    case COLON_RECTYPE ('c','r','t',0): rectype = RT_CRT; break;
+    case COLON_RECTYPE ('c','r','s',0): rectype = RT_CRS; break;
+    case COLON_RECTYPE ('f','p','r',0): rectype = RT_FPR; break;
+    case COLON_RECTYPE ('g','r','p',0): rectype = RT_GRP; break;
+    case COLON_RECTYPE ('u','i','d',0): rectype = RT_UID; break;
+    case COLON_RECTYPE ('t','f','s',0): rectype = RT_TFS; break;
+    case COLON_RECTYPE ('s','u','b',0): rectype = RT_SUB; break;
+    case COLON_RECTYPE ('s','s','b',0): rectype = RT_SSB; break;
+    case COLON_RECTYPE ('s','p','k',0): rectype = RT_SPK; break;
+    default: rectype = RT_NONE; break;
     }
 
-  if (!strcmp (field[0], "sig"))
-    rectype = RT_SIG;
-  else if (!strcmp (field[0], "rev"))
-    rectype = RT_REV;
-  else if (!strcmp (field[0], "pub"))
-    rectype = RT_PUB;
-  else if (!strcmp (field[0], "sec"))
-    rectype = RT_SEC;
-  else if (!strcmp (field[0], "crt"))
-    rectype = RT_CRT;
-  else if (!strcmp (field[0], "crs"))
-    rectype = RT_CRS;
-  else if (!strcmp (field[0], "fpr") && key)
-    rectype = RT_FPR;
-  else if (!strcmp (field[0], "grp") && key)
-    rectype = RT_GRP;
-  else if (!strcmp (field[0], "uid") && key)
-    rectype = RT_UID;
-  else if (!strcmp (field[0], "tfs") && key)
-    rectype = RT_TFS;
-  else if (!strcmp (field[0], "sub") && key)
-    rectype = RT_SUB;
-  else if (!strcmp (field[0], "ssb") && key)
-    rectype = RT_SSB;
-  else if (!strcmp (field[0], "spk") && key)
-    rectype = RT_SPK;
-  else
+  /* All records but those starting a keyblock need a key.  */
+  if (!key && rectype != RT_SIG && rectype != RT_REV && rectype != RT_PUB
+      && rectype != RT_SEC && rectype != RT_CRT && rectype != RT_CRS)
     rectype = RT_NONE;
 
   /* Only look at signature and trust info records immediately
@@ -694,7 +732,7 @@ keylist_colon_handler (void *priv, char *line)
       /* Field 8 has the X.509 serial number.  */
       if (fields >= 8 && (rectype == RT_CRT || rectype == RT_CRS))
 	{
-	  key->issuer_serial = strdup (field[7]);
+	  key->issuer_serial = _gpgme_key_strdup (key, field[7]);
 	  if (!key->issuer_serial)
 	    return gpg_error_from_syserror ();
 	}
@@ -706,8 +744,16 @@ keylist_colon_handler (void *priv, char *line)
       /* Field 10 is not used for gpg due to --fixed-list-mode option
 	 but GPGSM stores the issuer name.  */
       if (fields >= 10 && (rectype == RT_CRT || rectype == RT_CRS))
-	if (_gpgme_decode_c_string (field[9], &key->issuer_name, 0))
-	  return gpg_error (GPG_ERR_ENOMEM);	/* FIXME */
+	{
+	  size_t len = strlen (field[9]) + 1;
+
+	  key->issuer_name = _gpgme_key_alloc (key, len);
+	  if (!key->issuer_name)
+	    return gpg_error_from_syserror ();
+	  err = _gpgme_decode_c_string (field[9], &key->issuer_name, len);
+	  if (err)
+	    return err;
+	}
 
       /* Field 11 has the signature class.  */
 
@@ -728,7 +774,7 @@ keylist_colon_handler (void *priv, char *line)
       /* Field 17 has the curve name for ECC.  */
       if (fields >= 17 && *field[16])
         {
-          subkey->curve = strdup (field[16]);
+          subkey->curve = _gpgme_key_strdup (key, field[16]);
           if (!subkey->curve)
             return gpg_error_from_syserror ();
         }
@@ -811,7 +857,7 @@ keylist_colon_handler (void *priv, char *line)
       /* Field 17 has the curve name for ECC.  */
       if (fields >= 17 && *field[16])
         {
-          subkey->curve = strdup (field[16]);
+          subkey->curve = _gpgme_key_strdup (key, field[16]);
           if (!subkey->curve)
             return gpg_error_from_syserror ();
         }
@@ -835,7 +881,7 @@ keylist_colon_handler (void *priv, char *line)
             {
               gpgme_user_id_t uid = key->_last_uid;
               assert (uid);
-              uid->uidhash = strdup (field[7]);
+              uid->uidhash = _gpgme_key_strdup (key, field[7]);
             }
           opd->tmp_uid = key->_last_uid;
           if (fields >= 20)
@@ -849,7 +895,7 @@ keylist_colon_handler (void *priv, char *line)
     case RT_TFS:
       if (opd->tmp_uid)
 	{
-          err = parse_tfs_record (opd->tmp_uid, field, fields);
+          err = parse_tfs_record (key, opd->tmp_uid, field, fields);
           if (err)
             return err;
         }
@@ -864,7 +910,7 @@ keylist_colon_handler (void *priv, char *line)
           subkey = key->_last_subkey;
           if (!subkey->fpr)
             {
-              subkey->fpr = strdup (field[9]);
+              subkey->fpr = _gpgme_key_strdup (key, field[9]);
               if (!subkey->fpr)
                 return gpg_error_from_syserror ();
             }
@@ -879,7 +925,7 @@ keylist_colon_handler (void *priv, char *line)
                 }
               if (!key->fpr)
                 {
-                  key->fpr = strdup (subkey->fpr);
+                  key->fpr = _gpgme_key_strdup (key, subkey->fpr);
                   if (!key->fpr)
                     return gpg_error_from_syserror ();
                 }
@@ -889,7 +935,7 @@ keylist_colon_handler (void *priv, char *line)
       /* Field 13 has the gpgsm chain ID (take only the first one).  */
       if (fields >= 13 && !key->chain_id && *field[12])
 	{
-	  key->chain_id = strdup (field[12]);
+	  key->chain_id = _gpgme_key_strdup (key, field[12]);
 	  if (!key->chain_id)
 	    return gpg_error_from_syserror ();
 	}
@@ -904,7 +950,7 @@ keylist_colon_handler (void *priv, char *line)
           subkey = key->_last_subkey;
           if (!subkey->keygrip)
             {
-              subkey->keygrip = strdup (field[9]);
+              subkey->keygrip = _gpgme_key_strdup (key, field[9]);
               if (!subkey->keygrip)
                 return gpg_error_from_syserror ();
             }
@@ -1043,7 +1089,6 @@ _gpgme_op_keylist_event_cb (void *data, gpgme_event_io_t type, void *type_data)
   gpgme_key_t key = (gpgme_key_t) type_data;
   void *hook;
   op_data_t opd;
-  struct key_queue_item_s *q, *q2;
 
   assert (type == GPGME_EVENT_NEXT_KEY);
 
@@ -1052,24 +1097,12 @@ _gpgme_op_keylist_event_cb (void *data, gpgme_event_io_t type, void *type_data)
   if (err)
     return;
 
-  q = malloc (sizeof *q);
-  if (!q)
+  if (key_queue_push (opd, key))
     {
       gpgme_key_unref (key);
       /* FIXME       return GPGME_Out_Of_Core; */
       return;
     }
-  q->key = key;
-  q->next = NULL;
-  /* FIXME: Use a tail pointer?  */
-  if (!(q2 = opd->key_queue))
-    opd->key_queue = q;
-  else
-    {
-      for (; q2->next; q2 = q2->next)
-	;
-      q2->next = q;
-    }
   opd->key_cond = 1;
 }
 
@@ -1197,12 +1230,35 @@ gpgme_op_keylist_from_data_start (gpgme_ctx_t ctx, gpgme_data_t data,
 }
 
 
+/* Wait until at least one key is in the key queue of OPD.  Returns
+   GPG_ERR_EOF at the end of the keylist.  */
+static gpgme_error_t
+wait_for_keys (gpgme_ctx_t ctx, op_data_t opd)
+{
+  gpgme_error_t err;
+
+  if (!opd->key_queue_len)
+    {
+      err = _gpgme_wait_on_condition (ctx, &opd->key_cond, NULL);
+      if (err)
+	return err;
+
+      if (!opd->key_cond)
+	return opd->keydb_search_err? opd->keydb_search_err
+          /**/                      : gpg_error (GPG_ERR_EOF);
+
+      opd->key_cond = 0;
+      assert (opd->key_queue_len);
+    }
+  return 0;
+}
+
+
 /* Return the next key from the keylist in R_KEY.  */
 gpgme_error_t
 gpgme_op_keylist_next (gpgme_ctx_t ctx, gpgme_key_t *r_key)
 {
   gpgme_error_t err;
-  struct key_queue_item_s *queue_item;
   void *hook;
   op_data_t opd;
 
@@ -1221,27 +1277,14 @@ gpgme_op_keylist_next (gpgme_ctx_t ctx, gpgme_key_t *r_key)
   if (opd == NULL)
     return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
 
-  if (!opd->key_queue)
-    {
-      err = _gpgme_wait_on_condition (ctx, &opd->key_cond, NULL);
-      if (err)
-	return TRACE_ERR (err);
-
-      if (!opd->key_cond)
-	return TRACE_ERR (opd->keydb_search_err? opd->keydb_search_err
-                          /**/                 : gpg_error (GPG_ERR_EOF));
+  err = wait_for_keys (ctx, opd);
+  if (err)
+    return TRACE_ERR (err);
 
-      opd->key_cond = 0;
-      assert (opd->key_queue);
-    }
-  queue_item = opd->key_queue;
-  opd->key_queue = queue_item->next;
-  if (!opd->key_queue)
+  *r_key = key_queue_pop (opd);
+  if (!opd->key_queue_len)
     opd->key_cond = 0;
 
-  *r_key = queue_item->key;
-  free (queue_item);
-
   TRACE_SUC ("key=%p (%s)", *r_key,
              ((*r_key)->subkeys && (*r_key)->subkeys->fpr) ?
              (*r_key)->subkeys->fpr : "invalid");
@@ -1249,6 +1292,47 @@ gpgme_op_keylist_next (gpgme_ctx_t ctx, gpgme_key_t *r_key)
 }
 
 
+/* Return up to MAX keys from the keylist in the array KEYS and store
+   their number at R_COUNT.  This returns all keys which are already
+   available and blocks only if there is none.  */
+gpgme_error_t
+gpgme_op_keylist_next_n (gpgme_ctx_t ctx, gpgme_key_t *keys, size_t max,
+                         size_t *r_count)
+{
+  gpgme_error_t err;
+  void *hook;
+  op_data_t opd;
+  size_t n;
+
+  TRACE_BEG (DEBUG_CTX, "gpgme_op_keylist_next_n", ctx, "max=%zu", max);
+
+  if (r_count)
+    *r_count = 0;
+  if (!ctx || !keys || !max || !r_count)
+    return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
+
+  err = _gpgme_op_data_lookup (ctx, OPDATA_KEYLIST, &hook, -1, NULL);
+  opd = hook;
+  if (err)
+    return TRACE_ERR (err);
+  if (opd == NULL)
+    return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
+
+  err = wait_for_keys (ctx, opd);
+  if (err)
+    return TRACE_ERR (err);
+
+  for (n = 0; n < max && opd->key_queue_len; n++)
+    keys[n] = key_queue_pop (opd);
+  if (!opd->key_queue_len)
+    opd->key_cond = 0;
+  *r_count = n;
+
+  TRACE_SUC ("count=%zu", n);
+  return 0;
+}
+
+
 /* Terminate a pending keylist operation within CTX.  */
 gpgme_error_t
 gpgme_op_keylist_end (gpgme_ctx_t ctx)
@@ -1262,6 +1346,38 @@ gpgme_op_keylist_end (gpgme_ctx_t ctx)
 }
 
 
+/* Create a new context for listing keys with the protocol, keylist
+   mode and engine of CTX.  */
+static gpgme_error_t
+new_list_context (gpgme_ctx_t ctx, gpgme_ctx_t *r_listctx)
+{
+  gpgme_ctx_t listctx;
+  gpgme_error_t err;
+  gpgme_protocol_t proto;
+  gpgme_engine_info_t info;
+
+  /* FIXME: We use our own context because we have to avoid the user's
+     I/O callback handlers.  */
+  err = gpgme_new (&listctx);
+  if (err)
+    return err;
+
+  /* Clone the relevant state.  */
+  proto = gpgme_get_protocol (ctx);
+  gpgme_set_protocol (listctx, proto);
+  gpgme_set_keylist_mode (listctx, gpgme_get_keylist_mode (ctx));
+  info = gpgme_ctx_get_engine_info (ctx);
+  while (info && info->protocol != proto)
+    info = info->next;
+  if (info)
+    gpgme_ctx_set_engine_info (listctx, proto,
+                               info->file_name, info->home_dir);
+
+  *r_listctx = listctx;
+  return 0;
+}
+
+
 /* Get the key with the fingerprint FPR from the crypto backend.  If
    SECRET is true, get the secret key.  */
 gpgme_error_t
@@ -1271,6 +1387,7 @@ gpgme_get_key (gpgme_ctx_t ctx, const char *fpr, gpgme_key_t *r_key,
   gpgme_ctx_t listctx;
   gpgme_error_t err;
   gpgme_key_t result, key;
+  struct keycache_item_s *cache_item;
 
   TRACE_BEG  (DEBUG_CTX, "gpgme_get_key", ctx,
 	      "fpr=%s, secret=%i", fpr, secret);
@@ -1284,26 +1401,21 @@ gpgme_get_key (gpgme_ctx_t ctx, const char *fpr, gpgme_key_t *r_key,
   if (strlen (fpr) < 8)	/* We have at least a key ID.  */
     return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
 
-  /* FIXME: We use our own context because we have to avoid the user's
-     I/O callback handlers.  */
-  err = gpgme_new (&listctx);
+  err = _gpgme_keycache_get (ctx, fpr, secret, r_key, &cache_item);
   if (err)
     return TRACE_ERR (err);
-  {
-    gpgme_protocol_t proto;
-    gpgme_engine_info_t info;
-
-    /* Clone the relevant state.  */
-    proto = gpgme_get_protocol (ctx);
-    gpgme_set_protocol (listctx, proto);
-    gpgme_set_keylist_mode (listctx, gpgme_get_keylist_mode (ctx));
-    info = gpgme_ctx_get_engine_info (ctx);
-    while (info && info->protocol != proto)
-      info = info->next;
-    if (info)
-      gpgme_ctx_set_engine_info (listctx, proto,
-				 info->file_name, info->home_dir);
-  }
+  if (*r_key)
+    {
+      TRACE_LOG  ("key=%p (cached)", *r_key);
+      return TRACE_ERR (0);
+    }
+
+  err = new_list_context (ctx, &listctx);
+  if (err)
+    {
+      _gpgme_keycache_put (cache_item, NULL);
+      return TRACE_ERR (err);
+    }
 
   err = gpgme_op_keylist_start (listctx, fpr, secret);
   if (!err)
@@ -1340,6 +1452,7 @@ gpgme_get_key (gpgme_ctx_t ctx, const char *fpr, gpgme_key_t *r_key,
 	}
     }
   gpgme_release (listctx);
+  _gpgme_keycache_put (cache_item, err? NULL : result);
   if (! err)
     {
       *r_key = result;
@@ -1349,3 +1462,189 @@ gpgme_get_key (gpgme_ctx_t ctx, const char *fpr, gpgme_key_t *r_key,
     }
   return TRACE_ERR (err);
 }
+
+
+/* Return true if the hex strings A and B of length N are equal
+   ignoring the case.  */
+static int
+hexstr_equal (const char *a, const char *b, size_t n)
+{
+  for (; n; n--, a++, b++)
+    if (*a != *b
+        && !(*a >= 'a' && *a <= 'f' && *a - ('a' - 'A') == *b)
+        && !(*b >= 'a' && *b <= 'f' && *b - ('a' - 'A') == *a))
+      return 0;
+  return 1;
+}
+
+
+/* Return true if KEY has a subkey with the fingerprint or key ID
+   PATTERN.  */
+static int
+key_matches_pattern (gpgme_key_t key, const char *pattern)
+{
+  gpgme_subkey_t subkey;
+  size_t n, len;
+
+  n = strlen (pattern);
+  for (subkey = key->subkeys; subkey; subkey = subkey->next)
+    {
+      if (subkey->fpr && strlen (subkey->fpr) == n
+          && hexstr_equal (subkey->fpr, pattern, n))
+        return 1;
+      if ((n == 8 || n == 16) && subkey->keyid
+          && (len = strlen (subkey->keyid)) >= n
+          && hexstr_equal (subkey->keyid + len - n, pattern, n))
+        return 1;
+    }
+  return 0;
+}
+
+
+/* Return PATTERN without a "0x" prefix if it is a fingerprint or key
+   ID, and NULL otherwise.  */
+static const char *
+fpr_or_keyid_pattern (const char *pattern)
+{
+  size_t n;
+
+  if (pattern[0] == '0' && (pattern[1] == 'x' || pattern[1] == 'X'))
+    pattern += 2;
+  for (n = 0; pattern[n]; n++)
+    if (!strchr ("0123456789ABCDEFabcdef", pattern[n]))
+      return NULL;
+  if (n != 8 && n != 16 && n != 32 && n != 40 && n != 64)
+    return NULL;
+  return pattern;
+}
+
+
+/* Get the keys with the fingerprints or key IDs in the NULL
+   terminated array FPRS from the crypto backend using a single
+   keylist operation.  The key for FPRS[i] is stored at R_KEYS[i] and
+   the status of the lookup at R_ERRS[i]: GPG_ERR_EOF if no key was
+   found, GPG_ERR_AMBIGUOUS_NAME if several keys match and
+   GPG_ERR_INV_VALUE if FPRS[i] is neither a fingerprint nor a key ID.
+   The return value is only set for errors which affect all
+   lookups.  */
+gpgme_error_t
+gpgme_get_keys (gpgme_ctx_t ctx, const char *fprs[], gpgme_key_t *r_keys,
+                gpgme_error_t *r_errs)
+{
+  gpgme_error_t err = 0;
+  gpgme_ctx_t listctx = NULL;
+  gpgme_key_t key;
+  struct {
+    const char *pattern;  /* The pattern if the lookup is pending.  */
+    struct keycache_item_s *cache_item;
+  } *slots = NULL;
+  const char **patterns = NULL;
+  size_t nfprs, npatterns, i;
+
+  TRACE_BEG  (DEBUG_CTX, "gpgme_get_keys", ctx, "");
+
+  if (!ctx || !fprs || !r_keys || !r_errs)
+    return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
+
+  for (nfprs = 0; fprs[nfprs]; nfprs++)
+    {
+      r_keys[nfprs] = NULL;
+      r_errs[nfprs] = 0;
+    }
+  TRACE_LOG  ("count=%zu", nfprs);
+  if (!nfprs)
+    return TRACE_ERR (0);
+
+  slots = calloc (nfprs, sizeof *slots);
+  patterns = calloc (nfprs + 1, sizeof *patterns);
+  if (!slots || !patterns)
+    {
+      err = gpg_error_from_syserror ();
+      goto leave;
+    }
+
+  npatterns = 0;
+  for (i = 0; i < nfprs; i++)
+    {
+      const char *pattern = fpr_or_keyid_pattern (fprs[i]);
+
+      if (!pattern)
+        {
+          r_errs[i] = gpg_error (GPG_ERR_INV_VALUE);
+          continue;
+        }
+      err = _gpgme_keycache_get (ctx, pattern, 0, &r_keys[i],
+                                 &slots[i].cache_item);
+      if (err)
+        goto leave;
+      if (r_keys[i])
+        continue;
+      slots[i].pattern = pattern;
+      patterns[npatterns++] = pattern;
+    }
+
+  if (npatterns)
+    {
+      err = new_list_context (ctx, &listctx);
+      if (!err)
+        err = gpgme_op_keylist_ext_start (listctx, patterns, 0, 0);
+      while (!err && !(err = gpgme_op_keylist_next (listctx, &key)))
+        {
+          for (i = 0; i < nfprs; i++)
+            {
+              if (!slots[i].pattern
+                  || !key_matches_pattern (key, slots[i].pattern))
+                continue;
+              if (!r_keys[i])
+                {
+                  gpgme_key_ref (key);
+                  r_keys[i] = key;
+                }
+              else if (!(r_keys[i]->fpr && key->fpr
+                         && !strcmp (r_keys[i]->fpr, key->fpr)))
+                {
+                  /* Identical fingerprints are not considered
+                     ambiguous; see gpgme_get_key.  */
+                  r_errs[i] = gpg_error (GPG_ERR_AMBIGUOUS_NAME);
+                }
+            }
+          gpgme_key_unref (key);
+        }
+      if (gpgme_err_code (err) == GPG_ERR_EOF)
+        err = 0;
+      if (err)
+        goto leave;
+    }
+
+  for (i = 0; i < nfprs; i++)
+    {
+      if (!slots[i].pattern)
+        continue;
+      if (r_errs[i])
+        {
+          gpgme_key_unref (r_keys[i]);
+          r_keys[i] = NULL;
+        }
+      else if (!r_keys[i])
+        r_errs[i] = gpg_error (GPG_ERR_EOF);
+      _gpgme_keycache_put (slots[i].cache_item, r_keys[i]);
+      slots[i].cache_item = NULL;
+      TRACE_LOG  ("key[%zu]=%p err=%s", i, r_keys[i],
+                  gpg_strerror (r_errs[i]));
+    }
+
+ leave:
+  gpgme_release (listctx);
+  if (slots)
+    for (i = 0; i < nfprs; i++)
+      _gpgme_keycache_put (slots[i].cache_item, NULL);
+  if (err)
+    for (i = 0; i < nfprs; i++)
+      {
+        gpgme_key_unref (r_keys[i]);
+        r_keys[i] = NULL;
+      }
+  free (slots);
+  free (patterns);
+  return TRACE_ERR (err);
+}
@@ -0,0 +1,123 @@
+/* linebuf.c - Split a byte stream into lines.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "linebuf.h"
+
+
+/* The minimum free space we want for a read.  */
+#define MIN_READ_SPACE 256
+
+
+gpgme_error_t
+_gpgme_linebuf_init (linebuf_t lb, size_t size)
+{
+  if (size < 2 * MIN_READ_SPACE)
+    size = 2 * MIN_READ_SPACE;
+  lb->buffer = malloc (size);
+  if (!lb->buffer)
+    return gpg_error_from_syserror ();
+  lb->size = size;
+  lb->start = lb->end = lb->scanpos = 0;
+  return 0;
+}
+
+
+void
+_gpgme_linebuf_release (linebuf_t lb)
+{
+  free (lb->buffer);
+  lb->buffer = NULL;
+  lb->size = lb->start = lb->end = lb->scanpos = 0;
+}
+
+
+char *
+_gpgme_linebuf_space (linebuf_t lb, size_t *r_len)
+{
+  if (lb->start == lb->end)
+    lb->start = lb->end = lb->scanpos = 0;  /* Nothing pending.  */
+
+  if (lb->size - lb->end < MIN_READ_SPACE)
+    {
+      size_t pending = lb->end - lb->start;
+
+      if (lb->start && lb->size - pending >= MIN_READ_SPACE)
+        {
+          /* Move the partial line to the front.  This happens at most
+             once per buffer full of data.  */
+          memmove (lb->buffer, lb->buffer + lb->start, pending);
+        }
+      else
+        {
+          /* The partial line fills the buffer: grow it.  */
+          size_t newsize = 2 * lb->size;
+          char *newbuf;
+
+          if (lb->start)
+            memmove (lb->buffer, lb->buffer + lb->start, pending);
+          newbuf = realloc (lb->buffer, newsize);
+          if (!newbuf)
+            return NULL;
+          lb->buffer = newbuf;
+          lb->size = newsize;
+        }
+      lb->scanpos -= lb->start;
+      lb->start = 0;
+      lb->end = pending;
+    }
+
+  *r_len = lb->size - lb->end;
+  return lb->buffer + lb->end;
+}
+
+
+void
+_gpgme_linebuf_commit (linebuf_t lb, size_t n)
+{
+  lb->end += n;
+}
+
+
+char *
+_gpgme_linebuf_getline (linebuf_t lb, size_t *r_len)
+{
+  char *line, *lf;
+
+  lf = memchr (lb->buffer + lb->scanpos, '\n', lb->end - lb->scanpos);
+  if (!lf)
+    {
+      lb->scanpos = lb->end;
+      return NULL;
+    }
+
+  *lf = 0;
+  line = lb->buffer + lb->start;
+  if (r_len)
+    *r_len = lf - line;
+  lb->start = lb->scanpos = lf - lb->buffer + 1;
+  return line;
+}
@@ -0,0 +1,67 @@
+/* linebuf.h - Split a byte stream into lines.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef LINEBUF_H
+#define LINEBUF_H
+
+#include <stddef.h>
+
+#include "gpgme.h"
+
+/* A buffer to collect lines read from a pipe.  The data is read
+   directly into the buffer and the lines are handed out in place.
+   The buffer only moves data when it runs out of space, thus the cost
+   is linear in the amount of data read.  */
+struct linebuf_s
+{
+  char *buffer;
+  size_t size;     /* Allocated size of BUFFER.  */
+  size_t start;    /* Start of the first unprocessed line.  */
+  size_t end;      /* End of the valid data.  */
+  size_t scanpos;  /* No LF is in the range START..SCANPOS.  */
+};
+typedef struct linebuf_s *linebuf_t;
+
+
+/* Initialize LB with an initial buffer of SIZE bytes.  */
+gpgme_error_t _gpgme_linebuf_init (linebuf_t lb, size_t size);
+
+/* Release the buffer of LB.  */
+void _gpgme_linebuf_release (linebuf_t lb);
+
+/* Return a pointer to free space at the end of LB for reading into
+   and store its length at R_LEN.  The buffer is compacted or grown
+   as needed.  Returns NULL on error.  */
+char *_gpgme_linebuf_space (linebuf_t lb, size_t *r_len);
+
+/* Account for N bytes stored at the pointer returned by
+   _gpgme_linebuf_space.  */
+void _gpgme_linebuf_commit (linebuf_t lb, size_t n);
+
+/* Return the next complete line in LB or NULL if there is none.  The
+   line is terminated by a Nul in place of the LF and its length is
+   stored at R_LEN if that is not NULL.  The line is valid until the
+   next call to _gpgme_linebuf_space.  */
+char *_gpgme_linebuf_getline (linebuf_t lb, size_t *r_len);
+
+/* Return the number of bytes not yet handed out as lines.  */
+#define _gpgme_linebuf_pending(lb) ((lb)->end - (lb)->start)
+
+#endif /*LINEBUF_H*/
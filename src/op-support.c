@@ -122,10 +122,15 @@ _gpgme_op_reset (gpgme_ctx_t ctx, int type)
       if (!info)
 	return gpg_error (GPG_ERR_UNSUPPORTED_PROTOCOL);
 
-      /* Create an engine object.  */
-      err = _gpgme_engine_new (info, &ctx->engine);
-      if (err)
-	return err;
+      /* Take an idle engine from the pool or create a new one.  */
+      ctx->engine = _gpgme_engine_pool_get (info, ctx->lc_ctype,
+                                            ctx->lc_messages);
+      if (!ctx->engine)
+        {
+          err = _gpgme_engine_new (info, &ctx->engine);
+          if (err)
+            return err;
+        }
     }
 
   if (!reuse_engine)
@@ -185,9 +190,9 @@ _gpgme_op_reset (gpgme_ctx_t ctx, int type)
   else if (! ctx->io_cbs.add)
     {
       /* Use global event loop.  */
-      io_cbs.add = _gpgme_add_io_cb;
+      io_cbs.add = _gpgme_wait_global_add_io_cb;
       io_cbs.add_priv = ctx;
-      io_cbs.remove = _gpgme_remove_io_cb;
+      io_cbs.remove = _gpgme_wait_global_remove_io_cb;
       io_cbs.event = _gpgme_wait_global_event_cb;
       io_cbs.event_priv = ctx;
     }
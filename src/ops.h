@@ -140,6 +140,8 @@ gpgme_error_t _gpgme_progress_status_handler (void *priv,
 
 /* From key.c.  */
 gpgme_error_t _gpgme_key_new (gpgme_key_t *r_key);
+void *_gpgme_key_alloc (gpgme_key_t key, size_t size);
+char *_gpgme_key_strdup (gpgme_key_t key, const char *string);
 gpgme_error_t _gpgme_key_add_subkey (gpgme_key_t key,
 				     gpgme_subkey_t *r_subkey);
 gpgme_error_t _gpgme_key_append_name (gpgme_key_t key,
@@ -147,6 +149,15 @@ gpgme_error_t _gpgme_key_append_name (gpgme_key_t key,
 gpgme_key_sig_t _gpgme_key_add_sig (gpgme_key_t key, char *src);
 
 
+/* From keycache.c.  */
+struct keycache_item_s;
+int _gpgme_keycache_set_ttl (const char *value);
+gpgme_error_t _gpgme_keycache_get (gpgme_ctx_t ctx, const char *fpr,
+                                   int secret, gpgme_key_t *r_key,
+                                   struct keycache_item_s **r_item);
+void _gpgme_keycache_put (struct keycache_item_s *item, gpgme_key_t key);
+
+
 
 /* From keylist.c.  */
 void _gpgme_op_keylist_event_cb (void *data, gpgme_event_io_t type,
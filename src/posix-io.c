@@ -28,6 +28,7 @@
 # include <stdint.h>
 #endif
 #include <string.h>
+#include <limits.h>
 #include <assert.h>
 #include <errno.h>
 #include <signal.h>
@@ -47,6 +48,10 @@
 #endif
 #include <ctype.h>
 #include <sys/resource.h>
+#if defined(HAVE_POLL_H) && defined(HAVE_POLL)
+# include <poll.h>
+# define USE_POLL 1
+#endif
 
 #ifdef USE_LINUX_GETDENTS
 # include <sys/syscall.h>
@@ -54,6 +59,20 @@
 # include <dirent.h>
 #endif /*USE_LINUX_GETDENTS*/
 
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
+
+#if defined(USE_LINUX_CLONE_SPAWN) && defined(__hppa__)
+/* The stack grows upwards; we do not handle this.  */
+# undef USE_LINUX_CLONE_SPAWN
+#endif
+#ifdef USE_LINUX_CLONE_SPAWN
+# include <sched.h>
+# include <pthread.h>
+# include <sys/mman.h>
+#endif /*USE_LINUX_CLONE_SPAWN*/
+
 
 #include "util.h"
 #include "priv-io.h"
@@ -347,8 +366,33 @@ _gpgme_io_set_nonblocking (int fd)
 }
 
 
+void
+_gpgme_io_set_pipe_size (int fd, size_t size)
+{
+#ifdef F_SETPIPE_SZ
+  int res;
+
+  if (size > INT_MAX)
+    size = INT_MAX;
+  /* Linux rounds the size up to a power of two number of pages and
+     refuses sizes above /proc/sys/fs/pipe-max-size for unprivileged
+     processes.  In the latter case we keep the default size.  */
+  res = fcntl (fd, F_SETPIPE_SZ, (int)size);
+  TRACE (DEBUG_SYSIO, "_gpgme_io_set_pipe_size", NULL,
+         "fd=%d size=%zu res=%d", fd, size, res);
+#else
+  (void)fd;
+  (void)size;
+#endif
+}
+
+
+/* Return the number of file descriptors to consider when closing all
+ * unused fds.  If NO_TRACE is set the result is not logged; this is
+ * required in a child sharing the memory with the parent because the
+ * debug code takes a lock and allocates memory.  */
 static long int
-get_max_fds (void)
+get_max_fds (int no_trace)
 {
   const char *source = NULL;
   long int fds = -1;
@@ -476,7 +520,9 @@ get_max_fds (void)
     }
 #endif
 
-  TRACE (DEBUG_SYSIO, "gpgme:max_fds", NULL, "max fds=%ld (%s)", fds, source);
+  if (!no_trace)
+    TRACE (DEBUG_SYSIO, "gpgme:max_fds", NULL,
+           "max fds=%ld (%s)", fds, source);
   return fds;
 }
 
@@ -510,6 +556,278 @@ _gpgme_io_waitpid (int pid, int hang, int *r_status, int *r_signal)
 }
 
 
+/* Close all fds not listed in FD_LIST using the close_range(2)
+ * system call.  Returns 0 on success or -1 if this is not supported.
+ * This function must be async-signal-safe and may not allocate
+ * memory.  */
+static int
+close_unlisted_fds_range (struct spawn_fd_item_s *fd_list)
+{
+#if defined(__linux__) && defined(SYS_close_range)
+  unsigned int lo = 0;
+  int next;
+  int i;
+
+  /* FD_LIST is not sorted but short; thus we simply look for the
+   * next fd to keep in each round and close the range below it.  */
+  for (;;)
+    {
+      next = -1;
+      for (i = 0; fd_list[i].fd != -1; i++)
+        if ((unsigned int)fd_list[i].fd >= lo
+            && (next == -1 || fd_list[i].fd < next))
+          next = fd_list[i].fd;
+      if (next == -1)
+        return syscall (SYS_close_range, lo, ~0U, 0)? -1 : 0;
+      if ((unsigned int)next > lo
+          && syscall (SYS_close_range, lo, (unsigned int)next - 1, 0))
+        return -1;
+      lo = (unsigned int)next + 1;
+    }
+#else
+  (void)fd_list;
+  return -1;
+#endif
+}
+
+
+/* The code run in the child process after fork or clone.  Never
+ * returns.  Note that in the clone case the child shares the memory
+ * with the parent and thus everything done here must be
+ * async-signal-safe and may not allocate memory; IN_CLONE is set in
+ * this case.  */
+static void
+spawn_child (const char *path, char *const argv[],
+             struct spawn_fd_item_s *fd_list,
+             void (*atfork) (void *opaque, int reserved),
+             void *atforkvalue, int in_clone)
+{
+  int max_fds = -1;
+  int fd;
+  int i;
+  int seen_stdin = 0;
+  int seen_stdout = 0;
+  int seen_stderr = 0;
+
+  if (atfork)
+    atfork (atforkvalue, 0);
+
+  /* First close all fds which will not be inherited.  If we have
+   * close_range(2) that is all we need to do.  If we have
+   * closefrom(2) we first figure out the highest fd we do not want
+   * to close, then call closefrom, and on success use the regular
+   * code to close all fds up to the start point of closefrom.  Note
+   * that Solaris', FreeBSD's and glibc's closefrom do not return
+   * errors.  */
+  if (!close_unlisted_fds_range (fd_list))
+    max_fds = 0;
+#ifdef HAVE_CLOSEFROM
+  if (max_fds == -1)
+    {
+      fd = -1;
+      for (i = 0; fd_list[i].fd != -1; i++)
+        if (fd_list[i].fd > fd)
+          fd = fd_list[i].fd;
+      fd++;
+#if defined(__sun) || defined(__FreeBSD__) || defined(__GLIBC__)
+      closefrom (fd);
+      max_fds = fd;
+#else /*!__sun */
+      while ((i = closefrom (fd)) && errno == EINTR)
+        ;
+      if (!i || errno == EBADF)
+        max_fds = fd;
+#endif /*!__sun*/
+    }
+#endif /*HAVE_CLOSEFROM*/
+  if (max_fds == -1)
+    max_fds = get_max_fds (in_clone);
+  for (fd = 0; fd < max_fds; fd++)
+    {
+      for (i = 0; fd_list[i].fd != -1; i++)
+        if (fd_list[i].fd == fd)
+          break;
+      if (fd_list[i].fd == -1)
+        close (fd);
+    }
+
+  /* And now dup and close those to be duplicated.  */
+  for (i = 0; fd_list[i].fd != -1; i++)
+    {
+      int child_fd;
+      int res;
+
+      if (fd_list[i].dup_to != -1)
+        child_fd = fd_list[i].dup_to;
+      else
+        child_fd = fd_list[i].fd;
+
+      if (child_fd == 0)
+        seen_stdin = 1;
+      else if (child_fd == 1)
+        seen_stdout = 1;
+      else if (child_fd == 2)
+        seen_stderr = 1;
+
+      if (fd_list[i].dup_to == -1)
+        continue;
+
+      res = dup2 (fd_list[i].fd, fd_list[i].dup_to);
+      if (res < 0)
+        {
+#if 0
+          /* FIXME: The debug file descriptor is not
+             dup'ed anyway, so we can't see this.  */
+          TRACE_LOG  ("dup2 failed in child: %s\n",
+                      strerror (errno));
+#endif
+          _exit (8);
+        }
+
+      close (fd_list[i].fd);
+    }
+
+  if (! seen_stdin || ! seen_stdout || !seen_stderr)
+    {
+      fd = open ("/dev/null", O_RDWR);
+      if (fd == -1)
+        {
+          /* The debug file descriptor is not dup'ed, so we
+             can't do a trace output.  */
+          _exit (8);
+        }
+      /* Make sure that the process has connected stdin.  */
+      if (! seen_stdin && fd != 0)
+        {
+          if (dup2 (fd, 0) == -1)
+            _exit (8);
+        }
+      if (! seen_stdout && fd != 1)
+        {
+          if (dup2 (fd, 1) == -1)
+            _exit (8);
+        }
+      if (! seen_stderr && fd != 2)
+        {
+          if (dup2 (fd, 2) == -1)
+            _exit (8);
+        }
+      if (fd != 0 && fd != 1 && fd != 2)
+        close (fd);
+    }
+
+  execv (path, (char *const *) argv);
+  /* Hmm: in that case we could write a special status code to the
+     status-pipe.  */
+  _exit (8);
+}
+
+
+#ifdef USE_LINUX_CLONE_SPAWN
+/* The size of the stacks used by the clone helpers.  */
+#define CLONE_SPAWN_STACK_SIZE (64 * 1024)
+
+/* The parameters passed to the clone helpers.  */
+struct clone_spawn_s
+{
+  const char *path;
+  char *const *argv;
+  struct spawn_fd_item_s *fd_list;
+
+  /* The signal mask of the caller.  */
+  sigset_t oldset;
+
+  /* The stack for the final child.  */
+  char *stack;
+};
+
+
+/* The final child started by clone_spawn_intermediate.  */
+static int
+clone_spawn_child (void *opaque)
+{
+  struct clone_spawn_s *parm = opaque;
+  struct sigaction sa;
+  int signo;
+
+  /* We share the memory with the parent and thus may not run any
+   * signal handler of the parent.  All signals are still blocked
+   * here; reset the handlers before we restore the signal mask.  */
+  for (signo = 1; signo < NSIG; signo++)
+    {
+      if (sigaction (signo, NULL, &sa))
+        continue;
+      if (sa.sa_handler == SIG_IGN || sa.sa_handler == SIG_DFL)
+        continue;
+      sa.sa_handler = SIG_DFL;
+      sa.sa_flags = 0;
+      sigemptyset (&sa.sa_mask);
+      sigaction (signo, &sa, NULL);
+    }
+  pthread_sigmask (SIG_SETMASK, &parm->oldset, NULL);
+
+  spawn_child (parm->path, parm->argv, parm->fd_list, NULL, NULL, 1);
+  return 8;  /* Not reached.  */
+}
+
+
+/* The intermediate child to prevent zombie processes.  It is the
+ * counterpart to the intermediate fork in the fork based code.
+ * Thanks to CLONE_VFORK it returns only after the final child called
+ * execv or died.  */
+static int
+clone_spawn_intermediate (void *opaque)
+{
+  struct clone_spawn_s *parm = opaque;
+  pid_t pid;
+
+  pid = clone (clone_spawn_child, parm->stack + CLONE_SPAWN_STACK_SIZE,
+               CLONE_VM | CLONE_VFORK | SIGCHLD, parm);
+  _exit (pid == -1? 1 : 0);
+  return 1;  /* Not reached.  */
+}
+
+
+/* Spawn PATH like the fork based code in _gpgme_io_spawn but without
+ * copying the page tables of the process.  Returns the pid of the
+ * intermediate child or -1 on error.  */
+static pid_t
+clone_spawn (const char *path, char *const argv[],
+             struct spawn_fd_item_s *fd_list)
+{
+  struct clone_spawn_s parm;
+  sigset_t allset;
+  char *stacks;
+  pid_t pid;
+  int saved_errno;
+
+  stacks = mmap (NULL, 2 * CLONE_SPAWN_STACK_SIZE, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+  if (stacks == MAP_FAILED)
+    return -1;
+
+  parm.path = path;
+  parm.argv = argv;
+  parm.fd_list = fd_list;
+  parm.stack = stacks + CLONE_SPAWN_STACK_SIZE;
+
+  /* Block all signals so that no signal handler of the parent runs
+   * in the children, which share our memory.  */
+  sigfillset (&allset);
+  pthread_sigmask (SIG_BLOCK, &allset, &parm.oldset);
+
+  pid = clone (clone_spawn_intermediate, stacks + CLONE_SPAWN_STACK_SIZE,
+               CLONE_VM | CLONE_VFORK | SIGCHLD, &parm);
+  saved_errno = errno;
+
+  pthread_sigmask (SIG_SETMASK, &parm.oldset, NULL);
+  munmap (stacks, 2 * CLONE_SPAWN_STACK_SIZE);
+  errno = saved_errno;
+  return pid;
+}
+#endif /*USE_LINUX_CLONE_SPAWN*/
+
+
 /* Returns 0 on success, -1 on error.  */
 int
 _gpgme_io_spawn (const char *path, char *const argv[], unsigned int flags,
@@ -538,135 +856,36 @@ _gpgme_io_spawn (const char *path, char *const argv[], unsigned int flags,
         TRACE_LOG  ("fd[%i] = 0x%x -> 0x%x", i,fd_list[i].fd,fd_list[i].dup_to);
     }
 
-  pid = fork ();
-  if (pid == -1)
-    return TRACE_SYSRES (-1);
-
-  if (!pid)
+#ifdef USE_LINUX_CLONE_SPAWN
+  /* We can't run an arbitrary ATFORK function in a child sharing our
+   * memory; use the fork based code in this case.  */
+  if (!atfork)
     {
-      /* Intermediate child to prevent zombie processes.  */
-      if ((pid = fork ()) == 0)
-	{
-	  /* Child.  */
-          int max_fds = -1;
-          int fd;
-	  int seen_stdin = 0;
-	  int seen_stdout = 0;
-	  int seen_stderr = 0;
-
-	  if (atfork)
-	    atfork (atforkvalue, 0);
-
-          /* First close all fds which will not be inherited.  If we
-           * have closefrom(2) we first figure out the highest fd we
-           * do not want to close, then call closefrom, and on success
-           * use the regular code to close all fds up to the start
-           * point of closefrom.  Note that Solaris' and FreeBSD's closefrom do
-           * not return errors.  */
-#ifdef HAVE_CLOSEFROM
-          {
-            fd = -1;
-            for (i = 0; fd_list[i].fd != -1; i++)
-              if (fd_list[i].fd > fd)
-                fd = fd_list[i].fd;
-            fd++;
-#if defined(__sun) || defined(__FreeBSD__)
-            closefrom (fd);
-            max_fds = fd;
-#else /*!__sun */
-            while ((i = closefrom (fd)) && errno == EINTR)
-              ;
-            if (!i || errno == EBADF)
-              max_fds = fd;
-#endif /*!__sun*/
-          }
-#endif /*HAVE_CLOSEFROM*/
-          if (max_fds == -1)
-            max_fds = get_max_fds ();
-          for (fd = 0; fd < max_fds; fd++)
+      pid = clone_spawn (path, argv, fd_list);
+      if (pid == -1)
+        return TRACE_SYSRES (-1);
+    }
+  else
+#endif /*USE_LINUX_CLONE_SPAWN*/
+    {
+      pid = fork ();
+      if (pid == -1)
+        return TRACE_SYSRES (-1);
+
+      if (!pid)
+        {
+          /* Intermediate child to prevent zombie processes.  */
+          if ((pid = fork ()) == 0)
             {
-              for (i = 0; fd_list[i].fd != -1; i++)
-                if (fd_list[i].fd == fd)
-                  break;
-              if (fd_list[i].fd == -1)
-                close (fd);
+              /* Child.  */
+              spawn_child (path, argv, fd_list, atfork, atforkvalue, 0);
+              /* End child.  */
             }
-
-	  /* And now dup and close those to be duplicated.  */
-	  for (i = 0; fd_list[i].fd != -1; i++)
-	    {
-	      int child_fd;
-	      int res;
-
-	      if (fd_list[i].dup_to != -1)
-		child_fd = fd_list[i].dup_to;
-	      else
-		child_fd = fd_list[i].fd;
-
-	      if (child_fd == 0)
-		seen_stdin = 1;
-	      else if (child_fd == 1)
-		seen_stdout = 1;
-	      else if (child_fd == 2)
-		seen_stderr = 1;
-
-	      if (fd_list[i].dup_to == -1)
-		continue;
-
-	      res = dup2 (fd_list[i].fd, fd_list[i].dup_to);
-	      if (res < 0)
-		{
-#if 0
-		  /* FIXME: The debug file descriptor is not
-		     dup'ed anyway, so we can't see this.  */
-		  TRACE_LOG  ("dup2 failed in child: %s\n",
-			      strerror (errno));
-#endif
-		  _exit (8);
-		}
-
-	      close (fd_list[i].fd);
-	    }
-
-	  if (! seen_stdin || ! seen_stdout || !seen_stderr)
-	    {
-	      fd = open ("/dev/null", O_RDWR);
-	      if (fd == -1)
-		{
-		  /* The debug file descriptor is not dup'ed, so we
-		     can't do a trace output.  */
-		  _exit (8);
-		}
-	      /* Make sure that the process has connected stdin.  */
-	      if (! seen_stdin && fd != 0)
-		{
-		  if (dup2 (fd, 0) == -1)
-                    _exit (8);
-		}
-	      if (! seen_stdout && fd != 1)
-                {
-                  if (dup2 (fd, 1) == -1)
-                    _exit (8);
-                }
-	      if (! seen_stderr && fd != 2)
-                {
-                  if (dup2 (fd, 2) == -1)
-                    _exit (8);
-                }
-	      if (fd != 0 && fd != 1 && fd != 2)
-		close (fd);
-	    }
-
-	  execv (path, (char *const *) argv);
-	  /* Hmm: in that case we could write a special status code to the
-	     status-pipe.  */
-	  _exit (8);
-	  /* End child.  */
-	}
-      if (pid == -1)
-	_exit (1);
-      else
-	_exit (0);
+          if (pid == -1)
+            _exit (1);
+          else
+            _exit (0);
+        }
     }
 
   TRACE_LOG  ("waiting for child process pid=%i", pid);
@@ -689,6 +908,121 @@ _gpgme_io_spawn (const char *path, char *const argv[], unsigned int flags,
 }
 
 
+#ifdef USE_POLL
+/* Number of pollfd items we keep on the stack.  Larger requests are
+   served from the heap.  */
+#define POLL_STACK_FDS 32
+
+/* Select on the list of fds using poll(2).  In contrast to select(2)
+   this does not impose an upper limit on the value of a file
+   descriptor and its cost depends only on the number of active file
+   descriptors.  Returns: -1 = error, 0 = timeout or nothing to
+   select, > 0 = number of signaled fds.  */
+int
+_gpgme_io_select (struct io_select_fd_s *fds, size_t nfds, int nonblock)
+{
+  struct pollfd pfds_buffer[POLL_STACK_FDS];
+  struct pollfd *pfds = pfds_buffer;
+  unsigned int i;
+  nfds_t npfds;
+  nfds_t j;
+  int count;
+  int saved_errno;
+  void *dbg_help = NULL;
+  TRACE_BEG  (DEBUG_SYSIO, "_gpgme_io_select", NULL,
+	      "nfds=%zu, nonblock=%u", nfds, nonblock);
+
+  if (nfds > POLL_STACK_FDS)
+    {
+      pfds = malloc (nfds * sizeof *pfds);
+      if (!pfds)
+        return TRACE_SYSRES (-1);
+    }
+
+  TRACE_SEQ (dbg_help, "poll on [ ");
+
+  npfds = 0;
+  for (i = 0; i < nfds; i++)
+    {
+      if (fds[i].fd == -1)
+	continue;
+      if (fds[i].for_read)
+	{
+          pfds[npfds].fd = fds[i].fd;
+          pfds[npfds].events = POLLIN;
+	  TRACE_ADD1 (dbg_help, "r=%d ", fds[i].fd);
+        }
+      else if (fds[i].for_write)
+	{
+          pfds[npfds].fd = fds[i].fd;
+          pfds[npfds].events = POLLOUT;
+	  TRACE_ADD1 (dbg_help, "w=%d ", fds[i].fd);
+        }
+      else
+        continue;
+      pfds[npfds].revents = 0;
+      npfds++;
+      fds[i].signaled = 0;
+    }
+  TRACE_END (dbg_help, "]");
+  if (!npfds)
+    {
+      if (pfds != pfds_buffer)
+        free (pfds);
+      return TRACE_SYSRES (0);
+    }
+
+  do
+    {
+      /* Use a 1s timeout.  */
+      count = _gpgme_ath_poll (pfds, npfds, nonblock? 0 : 1000);
+    }
+  while (count < 0 && errno == EINTR);
+  if (count < 0)
+    {
+      saved_errno = errno;
+      if (pfds != pfds_buffer)
+        free (pfds);
+      errno = saved_errno;
+      return TRACE_SYSRES (-1);
+    }
+
+  /* Like select(2) we consider an fd as ready if it is in an error
+     or hangup state so that the handler notices the EOF.  An invalid
+     fd is an error, though, to match the EBADF of select(2).  */
+  TRACE_SEQ (dbg_help, "poll OK [ ");
+  count = 0;
+  for (i = 0, j = 0; i < nfds && j < npfds; i++)
+    {
+      if (fds[i].fd == -1 || !(fds[i].for_read || fds[i].for_write))
+	continue;
+      assert (pfds[j].fd == fds[i].fd);
+      if ((pfds[j].revents & POLLNVAL))
+        {
+          TRACE_END (dbg_help, " -BAD- ]");
+          if (pfds != pfds_buffer)
+            free (pfds);
+          gpg_err_set_errno (EBADF);
+          return TRACE_SYSRES (-1);
+        }
+      if ((pfds[j].revents & (pfds[j].events | POLLERR | POLLHUP)))
+        {
+          fds[i].signaled = 1;
+          count++;
+          TRACE_ADD2 (dbg_help, "%c=%d ",
+                      fds[i].for_read? 'r':'w', fds[i].fd);
+        }
+      j++;
+    }
+  TRACE_END (dbg_help, "]");
+
+  if (pfds != pfds_buffer)
+    free (pfds);
+  return TRACE_SYSRES (count);
+}
+
+#else /*!USE_POLL*/
+
 /* Select on the list of fds.  Returns: -1 = error, 0 = timeout or
    nothing to select, > 0 = number of signaled fds.  */
 int
@@ -804,6 +1138,9 @@ _gpgme_io_select (struct io_select_fd_s *fds, size_t nfds, int nonblock)
 }
 
 
+#endif /*!USE_POLL*/
+
+
 int
 _gpgme_io_recvmsg (int fd, struct msghdr *msg, int flags)
 {
@@ -896,6 +1233,32 @@ _gpgme_io_dup (int fd)
   return new_fd;
 }
 
+
+int
+_gpgme_io_splice (int fd_in, int fd_out, size_t count)
+{
+  int res;
+  TRACE_BEG  (DEBUG_SYSIO, "_gpgme_io_splice", NULL,
+	      "fd_in=%d fd_out=%d count=%zu", fd_in, fd_out, count);
+
+#ifdef HAVE_SPLICE
+  if (count > INT_MAX)
+    count = INT_MAX;
+  do
+    res = splice (fd_in, NULL, fd_out, NULL, count,
+                  SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+  while (res == -1 && errno == EINTR);
+#else
+  (void)fd_in;
+  (void)fd_out;
+  (void)count;
+  gpg_err_set_errno (ENOSYS);
+  res = -1;
+#endif
+
+  return TRACE_SYSRES (res);
+}
+
 
 int
 _gpgme_io_socket (int domain, int type, int proto)
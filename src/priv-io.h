@@ -72,6 +72,9 @@ typedef void (*_gpgme_close_notify_handler_t) (int,void*);
 int _gpgme_io_set_close_notify (int fd, _gpgme_close_notify_handler_t handler,
 				void *value);
 int _gpgme_io_set_nonblocking (int fd);
+/* Try to enlarge the kernel buffer of the pipe FD to SIZE bytes.
+   This is only a hint; errors are ignored.  */
+void _gpgme_io_set_pipe_size (int fd, size_t size);
 
 /* Under Windows do not allocate a console.  */
 #define IOSPAWN_FLAG_DETACHED 1
@@ -107,6 +110,10 @@ int _gpgme_io_fd2str (char *buf, int buflen, int fd);
    status output file descriptor shared between GPGME and libassuan
    (in engine-gpgsm.c).  */
 int _gpgme_io_dup (int fd);
+/* Move up to COUNT bytes from FD_IN to FD_OUT without copying them
+   to user space.  One of them must be a pipe.  Returns -1 with errno
+   set to ENOSYS if this is not supported.  */
+int _gpgme_io_splice (int fd_in, int fd_out, size_t count);
 
 #ifndef HAVE_W32_SYSTEM
 int _gpgme_io_recvmsg (int fd, struct msghdr *msg, int flags);
@@ -41,4 +41,22 @@
 
 #define UNLOCK(name) gpgrt_lock_unlock(&name)
 
+/* Reference counters.  REFCOUNT_INC increments the counter at P;
+   REFCOUNT_DEC decrements it and stores the new value in R.  Without
+   atomic builtins the counter is protected by the lock NAME.  The
+   decrement uses acquire-release ordering so that the thread which
+   drops the last reference sees all writes done to the object by the
+   other threads.  */
+#ifdef HAVE_ATOMIC_BUILTINS
+# define REFCOUNT_INC(name, p) \
+  ((void) __atomic_add_fetch ((p), 1, __ATOMIC_RELAXED))
+# define REFCOUNT_DEC(name, p, r) \
+  ((r) = __atomic_sub_fetch ((p), 1, __ATOMIC_ACQ_REL))
+#else
+# define REFCOUNT_INC(name, p) \
+  do { LOCK (name); (*(p))++; UNLOCK (name); } while (0)
+# define REFCOUNT_DEC(name, p, r) \
+  do { LOCK (name); (r) = --(*(p)); UNLOCK (name); } while (0)
+#endif
+
 #endif /* SEMA_H */
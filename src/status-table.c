@@ -29,157 +29,259 @@
 #include "util.h"
 
 struct status_table_s {
-    const char *name;
-    gpgme_status_code_t code;
+  const char *name;
+  size_t namelen;
+  gpgme_status_code_t code;
 };
 
+#define S(a) { #a, sizeof #a - 1, GPGME_STATUS_ ## a }
 
-/* Lexicographically sorted ('_' comes after any letter).  You can use
-   the Emacs command M-x sort-lines.  But don't sweat it, the table is
-   sorted at start up, too.  */
-static struct status_table_s status_table[] =
-{
-  { "ABORT", GPGME_STATUS_ABORT },
-  { "ALREADY_SIGNED", GPGME_STATUS_ALREADY_SIGNED },
-  { "ATTRIBUTE",         GPGME_STATUS_ATTRIBUTE        },
-  { "BACKUP_KEY_CREATED", GPGME_STATUS_BACKUP_KEY_CREATED },
-  { "BADARMOR", GPGME_STATUS_BADARMOR },
-  { "BADMDC", GPGME_STATUS_BADMDC },
-  { "BADSIG", GPGME_STATUS_BADSIG },
-  { "BAD_PASSPHRASE", GPGME_STATUS_BAD_PASSPHRASE },
-  { "BEGIN_DECRYPTION", GPGME_STATUS_BEGIN_DECRYPTION },
-  { "BEGIN_ENCRYPTION", GPGME_STATUS_BEGIN_ENCRYPTION },
-  { "BEGIN_SIGNING",     GPGME_STATUS_BEGIN_SIGNING    },
-  { "BEGIN_STREAM", GPGME_STATUS_BEGIN_STREAM },
-  { "CARDCTRL", GPGME_STATUS_CARDCTRL },
-  { "DECRYPTION_FAILED", GPGME_STATUS_DECRYPTION_FAILED },
-  { "DECRYPTION_INFO",   GPGME_STATUS_DECRYPTION_INFO  },
-  { "DECRYPTION_OKAY", GPGME_STATUS_DECRYPTION_OKAY },
-  { "DELETE_PROBLEM", GPGME_STATUS_DELETE_PROBLEM },
-  { "DECRYPTION_COMPLIANCE_MODE", GPGME_STATUS_DECRYPTION_COMPLIANCE_MODE },
-  { "ENC_TO", GPGME_STATUS_ENC_TO },
-  { "END_DECRYPTION", GPGME_STATUS_END_DECRYPTION },
-  { "END_ENCRYPTION", GPGME_STATUS_END_ENCRYPTION },
-  { "END_STREAM", GPGME_STATUS_END_STREAM },
-  { "ENTER", GPGME_STATUS_ENTER },
-  { "ERRMDC", GPGME_STATUS_ERRMDC },
-  { "ERROR", GPGME_STATUS_ERROR },
-  { "ERRSIG", GPGME_STATUS_ERRSIG },
-  { "EXPKEYSIG", GPGME_STATUS_EXPKEYSIG },
-  { "EXPSIG", GPGME_STATUS_EXPSIG },
-  { "FAILURE", GPGME_STATUS_FAILURE },
-  { "FILE_DONE", GPGME_STATUS_FILE_DONE },
-  { "FILE_ERROR", GPGME_STATUS_FILE_ERROR },
-  { "FILE_START", GPGME_STATUS_FILE_START },
-  { "GET_BOOL", GPGME_STATUS_GET_BOOL },
-  { "GET_HIDDEN", GPGME_STATUS_GET_HIDDEN },
-  { "GET_LINE", GPGME_STATUS_GET_LINE },
-  { "GOODMDC", GPGME_STATUS_GOODMDC },
-  { "GOODSIG", GPGME_STATUS_GOODSIG },
-  { "GOOD_PASSPHRASE", GPGME_STATUS_GOOD_PASSPHRASE },
-  { "GOT_IT", GPGME_STATUS_GOT_IT },
-  { "IMPORTED", GPGME_STATUS_IMPORTED },
-  { "IMPORT_OK", GPGME_STATUS_IMPORT_OK },
-  { "IMPORT_PROBLEM", GPGME_STATUS_IMPORT_PROBLEM },
-  { "IMPORT_RES", GPGME_STATUS_IMPORT_RES },
-  { "INQUIRE_MAXLEN", GPGME_STATUS_INQUIRE_MAXLEN },
-  { "INV_RECP", GPGME_STATUS_INV_RECP },
-  { "INV_SGNR", GPGME_STATUS_INV_SGNR },
-  { "KEYEXPIRED", GPGME_STATUS_KEYEXPIRED },
-  { "KEYREVOKED", GPGME_STATUS_KEYREVOKED },
-  { "KEY_CONSIDERED", GPGME_STATUS_KEY_CONSIDERED },
-  { "KEY_CREATED", GPGME_STATUS_KEY_CREATED },
-  { "KEY_NOT_CREATED",   GPGME_STATUS_KEY_NOT_CREATED  },
-  { "LEAVE", GPGME_STATUS_LEAVE },
-  { "MISSING_PASSPHRASE", GPGME_STATUS_MISSING_PASSPHRASE },
-  { "MOUNTPOINT",        GPGME_STATUS_MOUNTPOINT       },
-  { "NEED_PASSPHRASE", GPGME_STATUS_NEED_PASSPHRASE },
-  { "NEED_PASSPHRASE_PIN", GPGME_STATUS_NEED_PASSPHRASE_PIN },
-  { "NEED_PASSPHRASE_SYM", GPGME_STATUS_NEED_PASSPHRASE_SYM },
-  { "NEWSIG", GPGME_STATUS_NEWSIG },
-  { "NODATA", GPGME_STATUS_NODATA },
-  { "NOTATION_DATA", GPGME_STATUS_NOTATION_DATA },
-  { "NOTATION_FLAGS", GPGME_STATUS_NOTATION_FLAGS },
-  { "NOTATION_NAME", GPGME_STATUS_NOTATION_NAME },
-  { "NO_PUBKEY", GPGME_STATUS_NO_PUBKEY },
-  { "NO_RECP", GPGME_STATUS_NO_RECP },
-  { "NO_SECKEY", GPGME_STATUS_NO_SECKEY },
-  { "NO_SGNR", GPGME_STATUS_NO_SGNR },
-  { "PINENTRY_LAUNCHED", GPGME_STATUS_PINENTRY_LAUNCHED},
-  { "PKA_TRUST_BAD", GPGME_STATUS_PKA_TRUST_BAD },
-  { "PKA_TRUST_GOOD", GPGME_STATUS_PKA_TRUST_GOOD },
-  { "PLAINTEXT", GPGME_STATUS_PLAINTEXT },
-  { "PLAINTEXT_LENGTH",  GPGME_STATUS_PLAINTEXT_LENGTH },
-  { "POLICY_URL", GPGME_STATUS_POLICY_URL },
-  { "PROGRESS", GPGME_STATUS_PROGRESS },
-  { "REVKEYSIG", GPGME_STATUS_REVKEYSIG },
-  { "RSA_OR_IDEA", GPGME_STATUS_RSA_OR_IDEA },
-  { "SC_OP_FAILURE", GPGME_STATUS_SC_OP_FAILURE },
-  { "SC_OP_SUCCESS", GPGME_STATUS_SC_OP_SUCCESS },
-  { "SESSION_KEY", GPGME_STATUS_SESSION_KEY },
-  { "SHM_GET", GPGME_STATUS_SHM_GET },
-  { "SHM_GET_BOOL", GPGME_STATUS_SHM_GET_BOOL },
-  { "SHM_GET_HIDDEN", GPGME_STATUS_SHM_GET_HIDDEN },
-  { "SHM_INFO", GPGME_STATUS_SHM_INFO },
-  { "SIGEXPIRED", GPGME_STATUS_SIGEXPIRED },
-  { "SIG_CREATED", GPGME_STATUS_SIG_CREATED },
-  { "SIG_ID", GPGME_STATUS_SIG_ID },
-  { "SIG_SUBPACKET", GPGME_STATUS_SIG_SUBPACKET },
-  { "SUCCESS", GPGME_STATUS_SUCCESS },
-  { "TOFU_STATS", GPGME_STATUS_TOFU_STATS },
-  { "TOFU_STATS_LONG", GPGME_STATUS_TOFU_STATS_LONG },
-  { "TOFU_USER", GPGME_STATUS_TOFU_USER },
-  { "TRUNCATED", GPGME_STATUS_TRUNCATED },
-  { "TRUST_FULLY", GPGME_STATUS_TRUST_FULLY },
-  { "TRUST_MARGINAL", GPGME_STATUS_TRUST_MARGINAL },
-  { "TRUST_NEVER", GPGME_STATUS_TRUST_NEVER },
-  { "TRUST_ULTIMATE", GPGME_STATUS_TRUST_ULTIMATE },
-  { "TRUST_UNDEFINED", GPGME_STATUS_TRUST_UNDEFINED },
-  { "UNEXPECTED", GPGME_STATUS_UNEXPECTED },
-  { "USERID_HINT", GPGME_STATUS_USERID_HINT },
-  { "VALIDSIG", GPGME_STATUS_VALIDSIG },
-  { "VERIFICATION_COMPLIANCE_MODE", GPGME_STATUS_VERIFICATION_COMPLIANCE_MODE },
-  {NULL, 0}
-};
-
-
-static int
-status_cmp (const void *ap, const void *bp)
-{
-  const struct status_table_s *a = ap;
-  const struct status_table_s *b = bp;
 
-  return strcmp (a->name, b->name);
-}
+/* The status keywords bucketed by their first letter.  Within a
+   bucket the order does not matter; keep them sorted for
+   readability.  A new first letter needs a new bucket and an entry in
+   status_buckets.  */
+static const struct status_table_s status_A[] =
+  {
+    S(ABORT),
+    S(ALREADY_SIGNED),
+    S(ATTRIBUTE),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_B[] =
+  {
+    S(BACKUP_KEY_CREATED),
+    S(BADARMOR),
+    S(BADMDC),
+    S(BADSIG),
+    S(BAD_PASSPHRASE),
+    S(BEGIN_DECRYPTION),
+    S(BEGIN_ENCRYPTION),
+    S(BEGIN_SIGNING),
+    S(BEGIN_STREAM),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_C[] =
+  {
+    S(CARDCTRL),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_D[] =
+  {
+    S(DECRYPTION_COMPLIANCE_MODE),
+    S(DECRYPTION_FAILED),
+    S(DECRYPTION_INFO),
+    S(DECRYPTION_OKAY),
+    S(DELETE_PROBLEM),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_E[] =
+  {
+    S(ENC_TO),
+    S(END_DECRYPTION),
+    S(END_ENCRYPTION),
+    S(END_STREAM),
+    S(ENTER),
+    S(ERRMDC),
+    S(ERROR),
+    S(ERRSIG),
+    S(EXPKEYSIG),
+    S(EXPSIG),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_F[] =
+  {
+    S(FAILURE),
+    S(FILE_DONE),
+    S(FILE_ERROR),
+    S(FILE_START),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_G[] =
+  {
+    S(GET_BOOL),
+    S(GET_HIDDEN),
+    S(GET_LINE),
+    S(GOODMDC),
+    S(GOODSIG),
+    S(GOOD_PASSPHRASE),
+    S(GOT_IT),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_I[] =
+  {
+    S(IMPORTED),
+    S(IMPORT_OK),
+    S(IMPORT_PROBLEM),
+    S(IMPORT_RES),
+    S(INQUIRE_MAXLEN),
+    S(INV_RECP),
+    S(INV_SGNR),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_K[] =
+  {
+    S(KEYEXPIRED),
+    S(KEYREVOKED),
+    S(KEY_CONSIDERED),
+    S(KEY_CREATED),
+    S(KEY_NOT_CREATED),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_L[] =
+  {
+    S(LEAVE),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_M[] =
+  {
+    S(MISSING_PASSPHRASE),
+    S(MOUNTPOINT),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_N[] =
+  {
+    S(NEED_PASSPHRASE),
+    S(NEED_PASSPHRASE_PIN),
+    S(NEED_PASSPHRASE_SYM),
+    S(NEWSIG),
+    S(NODATA),
+    S(NOTATION_DATA),
+    S(NOTATION_FLAGS),
+    S(NOTATION_NAME),
+    S(NO_PUBKEY),
+    S(NO_RECP),
+    S(NO_SECKEY),
+    S(NO_SGNR),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_P[] =
+  {
+    S(PINENTRY_LAUNCHED),
+    S(PKA_TRUST_BAD),
+    S(PKA_TRUST_GOOD),
+    S(PLAINTEXT),
+    S(PLAINTEXT_LENGTH),
+    S(POLICY_URL),
+    S(PROGRESS),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_R[] =
+  {
+    S(REVKEYSIG),
+    S(RSA_OR_IDEA),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_S[] =
+  {
+    S(SC_OP_FAILURE),
+    S(SC_OP_SUCCESS),
+    S(SESSION_KEY),
+    S(SHM_GET),
+    S(SHM_GET_BOOL),
+    S(SHM_GET_HIDDEN),
+    S(SHM_INFO),
+    S(SIGEXPIRED),
+    S(SIG_CREATED),
+    S(SIG_ID),
+    S(SIG_SUBPACKET),
+    S(SUCCESS),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_T[] =
+  {
+    S(TOFU_STATS),
+    S(TOFU_STATS_LONG),
+    S(TOFU_USER),
+    S(TRUNCATED),
+    S(TRUST_FULLY),
+    S(TRUST_MARGINAL),
+    S(TRUST_NEVER),
+    S(TRUST_ULTIMATE),
+    S(TRUST_UNDEFINED),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_U[] =
+  {
+    S(UNEXPECTED),
+    S(USERID_HINT),
+    { NULL, 0, 0 }
+  };
+static const struct status_table_s status_V[] =
+  {
+    S(VALIDSIG),
+    S(VERIFICATION_COMPLIANCE_MODE),
+    { NULL, 0, 0 }
+  };
 
+#undef S
 
-void
-_gpgme_status_init (void)
-{
-  qsort (status_table,
-	 DIM(status_table) - 1, sizeof (status_table[0]),
-	 status_cmp);
-}
+static const struct status_table_s *const status_buckets[26] =
+  {
+    /* A */ status_A,
+    /* B */ status_B,
+    /* C */ status_C,
+    /* D */ status_D,
+    /* E */ status_E,
+    /* F */ status_F,
+    /* G */ status_G,
+    /* H */ NULL,
+    /* I */ status_I,
+    /* J */ NULL,
+    /* K */ status_K,
+    /* L */ status_L,
+    /* M */ status_M,
+    /* N */ status_N,
+    /* O */ NULL,
+    /* P */ status_P,
+    /* Q */ NULL,
+    /* R */ status_R,
+    /* S */ status_S,
+    /* T */ status_T,
+    /* U */ status_U,
+    /* V */ status_V,
+    /* W */ NULL,
+    /* X */ NULL,
+    /* Y */ NULL,
+    /* Z */ NULL
+  };
 
 
+/* Return the code for the status keyword NAME or -1 if it is not
+   known.  This is called for every status line; thus we dispatch on
+   the first letter and compare only keywords of matching length.  No
+   initialization is required.  */
 gpgme_status_code_t
 _gpgme_parse_status (const char *name)
 {
-  struct status_table_s t, *r;
-  t.name = name;
-  r = bsearch (&t, status_table, DIM(status_table) - 1,
-	       sizeof t, status_cmp);
-  return r ? r->code : -1;
+  const struct status_table_s *t;
+  size_t namelen;
+
+  if (*name < 'A' || *name > 'Z')
+    return -1;
+  t = status_buckets[*name - 'A'];
+  if (!t)
+    return -1;
+
+  namelen = strlen (name);
+  for (; t->name; t++)
+    if (t->namelen == namelen && !memcmp (t->name + 1, name + 1, namelen - 1))
+      return t->code;
+  return -1;
 }
 
 
 const char *
 _gpgme_status_to_string (gpgme_status_code_t code)
 {
+  const struct status_table_s *t;
   int i;
 
-  for (i=0; i < DIM(status_table); i++)
-    if (status_table[i].code == code)
-      return status_table[i].name? status_table[i].name : "";
+  if (code == GPGME_STATUS_EOF)
+    return "";
+  for (i=0; i < DIM (status_buckets); i++)
+    for (t = status_buckets[i]; t && t->name; t++)
+      if (t->code == code)
+        return t->name;
   return "status_code_lost";
 }
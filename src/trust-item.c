@@ -33,10 +33,13 @@
 #include "debug.h"
 
 
-/* Protects all reference counters in trust items.  All other accesses
-   to a trust item are either read only or happen before the trust
-   item is available to the user.  */
+/* Protects all reference counters in trust items if the compiler
+   does not provide atomic operations.  All other accesses to a trust
+   item are either read only or happen before the trust item is
+   available to the user.  */
+#ifndef HAVE_ATOMIC_BUILTINS
 DEFINE_STATIC_LOCK (trust_item_ref_lock);
+#endif
 
 
 /* Create a new trust item.  */
@@ -64,9 +67,7 @@ _gpgme_trust_item_new (gpgme_trust_item_t *r_item)
 void
 gpgme_trust_item_ref (gpgme_trust_item_t item)
 {
-  LOCK (trust_item_ref_lock);
-  item->_refs++;
-  UNLOCK (trust_item_ref_lock);
+  REFCOUNT_INC (trust_item_ref_lock, &item->_refs);
 }
 
 
@@ -78,14 +79,12 @@ gpgme_trust_item_ref (gpgme_trust_item_t item)
 void
 gpgme_trust_item_unref (gpgme_trust_item_t item)
 {
-  LOCK (trust_item_ref_lock);
+  unsigned int refs;
+
   assert (item->_refs > 0);
-  if (--item->_refs)
-    {
-      UNLOCK (trust_item_ref_lock);
-      return;
-    }
-  UNLOCK (trust_item_ref_lock);
+  REFCOUNT_DEC (trust_item_ref_lock, &item->_refs, refs);
+  if (refs)
+    return;
 
   if (item->name)
     free (item->name);
@@ -75,50 +75,35 @@ trustlist_colon_handler (void *priv, char *line)
 {
   gpgme_ctx_t ctx = (gpgme_ctx_t) priv;
   gpgme_error_t err;
-  char *p, *pend;
-  int field = 0;
+  char *field[9];
+  int fields;
   gpgme_trust_item_t item = NULL;
 
   if (!line)
     return 0; /* EOF */
 
-  for (p = line; p; p = pend)
+  fields = _gpgme_split_colon_fields (line, field, DIM (field));
+
+  err = _gpgme_trust_item_new (&item);
+  if (err)
+    return err;
+  item->level = atoi (field[0]);              /* level */
+  if (fields >= 2 && strlen (field[1]) == DIM(item->keyid) - 1)
+    strcpy (item->keyid, field[1]);           /* long keyid */
+  if (fields >= 3)
+    item->type = *field[2] == 'K'? 1 : *field[2] == 'U'? 2 : 0; /* type */
+  if (fields >= 5)
+    item->_owner_trust[0] = *field[4];        /* owner trust */
+  if (fields >= 6)
+    item->_validity[0] = *field[5];           /* validity */
+  if (fields >= 9)
     {
-      field++;
-      pend = strchr (p, ':');
-      if (pend)
-	*pend++ = 0;
-
-      switch (field)
-	{
-	case 1: /* level */
-	  err = _gpgme_trust_item_new (&item);
-	  if (err)
-	    return err;
-	  item->level = atoi (p);
-	  break;
-	case 2: /* long keyid */
-	  if (strlen (p) == DIM(item->keyid) - 1)
-	    strcpy (item->keyid, p);
-	  break;
-	case 3: /* type */
-	  item->type = *p == 'K'? 1 : *p == 'U'? 2 : 0;
-	  break;
-	case 5: /* owner trust */
-	  item->_owner_trust[0] = *p;
-	  break;
-	case 6: /* validity */
-	  item->_validity[0] = *p;
-	  break;
-	case 9: /* user ID */
-	  item->name = strdup (p);
-	  if (!item->name)
-	    {
-              int saved_err = gpg_error_from_syserror ();
-	      gpgme_trust_item_unref (item);
-	      return saved_err;
-	    }
-	  break;
+      item->name = strdup (field[8]);         /* user ID */
+      if (!item->name)
+        {
+          int saved_err = gpg_error_from_syserror ();
+          gpgme_trust_item_unref (item);
+          return saved_err;
         }
     }
 
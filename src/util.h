@@ -143,6 +143,35 @@ gpgme_error_t _gpgme_encode_percent_string (const char *src, char **destp,
  * modifies STRING.  The number of parsed fields is returned.  */
 int _gpgme_split_fields (char *string, char **array, int arraysize);
 
+/* Split a colon delimited record as printed by GnuPG with
+ * --with-colons.  A pointer to each field is stored in ARRAY and the
+ * colons are replaced by Nuls.  Stop splitting at ARRAYSIZE fields.
+ * The function modifies STRING.  The number of parsed fields is
+ * returned.  */
+int _gpgme_split_colon_fields (char *string, char **array, int arraysize);
+
+/* Map the record type of a colon line, i.e. its first field, to a
+ * number which can be compared against COLON_RECTYPE in a switch
+ * statement.  Record types longer than 4 characters are mapped to 0,
+ * which never matches a COLON_RECTYPE.  */
+#define COLON_RECTYPE(a,b,c,d)                                  \
+  (((unsigned int)(a) << 24) | ((unsigned int)(b) << 16)        \
+   | ((unsigned int)(c) << 8) | (unsigned int)(d))
+static inline unsigned int
+_gpgme_colon_rectype (const char *field)
+{
+  unsigned int rectype = 0;
+  int i;
+
+  for (i = 0; i < 4; i++)
+    {
+      rectype <<= 8;
+      if (*field)
+        rectype |= *(const unsigned char *)field++;
+    }
+  return *field? 0 : rectype;
+}
+
 /* Convert the field STRING into an unsigned long value.  Check for
  * trailing garbage.  */
 gpgme_error_t _gpgme_strtoul_field (const char *string, unsigned long *result);
@@ -195,7 +224,6 @@ gpgme_error_t _gpgme_getenv (const char *name, char **value);
 
 /*-- status-table.c --*/
 /* Convert a status string to a status code.  */
-void _gpgme_status_init (void);
 gpgme_status_code_t _gpgme_parse_status (const char *name);
 const char *_gpgme_status_to_string (gpgme_status_code_t code);
 
@@ -725,9 +725,13 @@ parse_tofu_user (gpgme_signature_t sig, char *args, gpgme_protocol_t protocol)
       err = _gpgme_key_new (&sig->key);
       if (err)
         goto leave;
-      sig->key->fpr = fpr;
+      sig->key->fpr = _gpgme_key_strdup (sig->key, fpr);
+      if (!sig->key->fpr)
+        {
+          err = gpg_error_from_syserror ();
+          goto leave;
+        }
       sig->key->protocol = protocol;
-      fpr = NULL;
     }
   else if (!sig->key->fpr)
     {
@@ -742,7 +746,7 @@ parse_tofu_user (gpgme_signature_t sig, char *args, gpgme_protocol_t protocol)
   uid = sig->key->_last_uid;
   assert (uid);
 
-  ti = calloc (1, sizeof *ti);
+  ti = _gpgme_key_alloc (sig->key, sizeof *ti);
   if (!ti)
     {
       err = gpg_error_from_syserror ();
@@ -859,6 +863,7 @@ parse_tofu_stats_long (gpgme_signature_t sig, char *args, int raw)
 {
   gpgme_error_t err;
   gpgme_tofu_info_t ti;
+  size_t len;
   char *p;
 
   if (!sig->key || !sig->key->_last_uid || !(ti = sig->key->_last_uid->tofu))
@@ -866,9 +871,14 @@ parse_tofu_stats_long (gpgme_signature_t sig, char *args, int raw)
   if (ti->description)
     return trace_gpg_error (GPG_ERR_INV_ENGINE); /* Already set.  */
 
-  err = _gpgme_decode_percent_string (args, &ti->description, 0, 0);
+  len = strlen (args) + 1;
+  p = _gpgme_key_alloc (sig->key, len);
+  if (!p)
+    return gpg_error_from_syserror ();
+  err = _gpgme_decode_percent_string (args, &p, len, 0);
   if (err)
     return err;
+  ti->description = p;
 
   /* Remove the non-breaking spaces.  */
   if (!raw)
@@ -35,7 +35,7 @@
 #include "debug.h"
 #include "context.h"
 
-/* For _gpgme_sema_subsystem_init and _gpgme_status_init.  */
+/* For _gpgme_sema_subsystem_init.  */
 #include "sema.h"
 #include "util.h"
 
@@ -76,7 +76,6 @@ do_subsystem_inits (void)
 
   _gpgme_debug_subsystem_init ();
   _gpgme_io_subsystem_init ();
-  _gpgme_status_init ();
 
   done = 1;
 }
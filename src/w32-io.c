@@ -1309,6 +1309,15 @@ _gpgme_io_set_nonblocking (int fd)
 }
 
 
+void
+_gpgme_io_set_pipe_size (int fd, size_t size)
+{
+  /* The pipe size is fixed at creation time under Windows.  */
+  (void)fd;
+  (void)size;
+}
+
+
 static char *
 build_commandline (char **argv)
 {
@@ -1873,6 +1882,16 @@ _gpgme_io_dup (int fd)
   return TRACE_SYSRES (newfd);
 }
 
+
+int
+_gpgme_io_splice (int fd_in, int fd_out, size_t count)
+{
+  TRACE (DEBUG_SYSIO, "_gpgme_io_splice", NULL,
+         "fd_in=%d fd_out=%d count=%zu", fd_in, fd_out, count);
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
 
 /* The following interface is only useful for GPGME Glib and Qt.  */
 
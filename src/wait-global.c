@@ -41,21 +41,25 @@
 
    A context sets up its initial I/O callbacks and then sends the
    GPGME_EVENT_START event.  After that, it is added to the global
-   list of active contexts.
+   list of active contexts and its file descriptors are entered into
+   the global fd table.  I/O callbacks added or removed later on are
+   reflected in that table right away, so that gpgme_wait does not
+   need to collect the fds of all active contexts for each round.
 
-   The gpgme_wait function contains a select() loop over all file
-   descriptors in all active contexts.  If an error occurs, it closes
-   all fds in that context and moves the context to the global done
-   list.  Likewise, if a context has removed all I/O callbacks, it is
-   moved to the global done list.
+   The gpgme_wait function contains a select() loop over the global fd
+   table.  If an error occurs, it closes all fds in that context and
+   moves the context to the global done list.  Likewise, if a context
+   has removed all I/O callbacks, it is moved to the finished list and
+   then, by means of the done event, to the global done list.
 
    All contexts in the global done list are eligible for being
    returned by gpgme_wait if requested by the caller.  */
 
-/* The ctx_list_lock protects the list of active and done contexts.
-   Insertion into any of these lists is only allowed when the lock is
-   held.  This allows a muli-threaded program to loop over gpgme_wait
-   and in parallel start asynchronous gpgme operations.
+/* The ctx_list_lock protects the list of active, finished and done
+   contexts as well as the global fd table.  Insertion into any of
+   these lists is only allowed when the lock is held.  This allows a
+   muli-threaded program to loop over gpgme_wait and in parallel start
+   asynchronous gpgme operations.
 
    However, the fd tables in the contexts are not protected by this
    lock.  They are only allowed to change either before the context is
@@ -63,8 +67,15 @@
    or in a callback handler.  */
 DEFINE_STATIC_LOCK (ctx_list_lock);
 
-/* A ctx_list_item is an item in the global list of active or done
-   contexts.  */
+/* The lists a ctx_list_item may be linked into.  */
+typedef enum
+  {
+    CTX_LIST_ACTIVE, CTX_LIST_FINISHED, CTX_LIST_DONE
+  }
+ctx_list_t;
+
+/* A ctx_list_item is an item in the global list of active, finished
+   or done contexts.  */
 struct ctx_list_item
 {
   /* Every ctx_list_item is an element in a doubly linked list.  The
@@ -72,7 +83,14 @@ struct ctx_list_item
   struct ctx_list_item *next;
   struct ctx_list_item *prev;
 
+  /* The list this item is currently linked into.  */
+  ctx_list_t list;
+
   gpgme_ctx_t ctx;
+
+  /* The number of fds of CTX in the global fd table.  */
+  unsigned int nfds;
+
   /* The status is set when the ctx is moved to the done list.  */
   gpgme_error_t status;
   gpgme_error_t op_err;
@@ -83,6 +101,10 @@ struct ctx_list_item
    event.  */
 static struct ctx_list_item *ctx_active_list;
 
+/* The finished list contains all contexts which removed their last
+   I/O callback but did not yet see the done event.  */
+static struct ctx_list_item *ctx_finished_list;
+
 /* The done list contains all contexts that have previously been
    active but now are not active any longer, either because they
    finished successfully or an I/O callback returned an error.  The
@@ -90,23 +112,161 @@ static struct ctx_list_item *ctx_active_list;
    successful).  */
 static struct ctx_list_item *ctx_done_list;
 
-
+/* The global fd table holds the fds of all contexts in the active
+   list without holes.  The global_idx field of the wait item of an
+   entry gives its index so that an fd can be removed in constant
+   time.  The generation counter is bumped with each change.  */
+static struct io_select_fd_s *global_fds;
+static size_t global_fds_used;
+static size_t global_fds_size;
+static unsigned long global_fds_generation;
+
+
+/* Return the head of the list LIST.  */
+static struct ctx_list_item **
+ctx_list_head (ctx_list_t list)
+{
+  switch (list)
+    {
+    case CTX_LIST_ACTIVE:   return &ctx_active_list;
+    case CTX_LIST_FINISHED: return &ctx_finished_list;
+    case CTX_LIST_DONE:     return &ctx_done_list;
+    }
+  assert (!"Unknown context list");
+  return NULL;
+}
+
+
+/* Link LI into the list LIST.  */
+static void
+ctx_list_insert (struct ctx_list_item *li, ctx_list_t list)
+{
+  struct ctx_list_item **head = ctx_list_head (list);
+
+  li->list = list;
+  li->next = *head;
+  li->prev = NULL;
+  if (*head)
+    (*head)->prev = li;
+  *head = li;
+}
+
+
+/* Unlink LI from the list it is in.  */
+static void
+ctx_list_remove (struct ctx_list_item *li)
+{
+  if (li->next)
+    li->next->prev = li->prev;
+  if (li->prev)
+    li->prev->next = li->next;
+  else
+    *ctx_list_head (li->list) = li->next;
+  li->next = li->prev = NULL;
+}
+
+
+/* Enter the fd table entry FDS of the context of LI into the global
+   fd table.  */
+static gpgme_error_t
+global_fds_add (struct ctx_list_item *li, struct io_select_fd_s *fds)
+{
+  struct wait_item_s *item = (struct wait_item_s *) fds->opaque;
+
+  assert (item);
+  assert (item->global_idx == -1);
+
+  if (global_fds_used == global_fds_size)
+    {
+      struct io_select_fd_s *new_fds;
+      size_t new_size = global_fds_size ? 2 * global_fds_size : 16;
+
+      new_fds = realloc (global_fds, new_size * sizeof (*new_fds));
+      if (!new_fds)
+	return gpg_error_from_syserror ();
+      global_fds = new_fds;
+      global_fds_size = new_size;
+    }
+
+  item->global_idx = global_fds_used;
+  global_fds[global_fds_used++] = *fds;
+  li->nfds++;
+  global_fds_generation++;
+  return 0;
+}
+
+
+/* Remove the fd table entry FDS of the context of LI from the global
+   fd table.  Does nothing if the entry is not registered.  */
+static void
+global_fds_remove (struct ctx_list_item *li, struct io_select_fd_s *fds)
+{
+  struct wait_item_s *item = (struct wait_item_s *) fds->opaque;
+  int idx;
+
+  if (!item || item->global_idx == -1)
+    return;
+
+  idx = item->global_idx;
+  assert (idx < global_fds_used);
+  assert (global_fds[idx].opaque == item);
+
+  /* Fill the hole with the last entry.  */
+  global_fds_used--;
+  if (idx != global_fds_used)
+    {
+      global_fds[idx] = global_fds[global_fds_used];
+      ((struct wait_item_s *) global_fds[idx].opaque)->global_idx = idx;
+    }
+  item->global_idx = -1;
+  li->nfds--;
+  global_fds_generation++;
+}
+
+
+/* Remove all fds of the context of LI from the global fd table.  */
+static void
+global_fds_remove_ctx (struct ctx_list_item *li)
+{
+  fd_table_t fdt = &li->ctx->fdt;
+  unsigned int i;
+
+  for (i = 0; i < fdt->size && li->nfds; i++)
+    if (fdt->fds[i].fd != -1)
+      global_fds_remove (li, &fdt->fds[i]);
+}
+
+
 /* Enter the context CTX into the active list.  */
 static gpgme_error_t
 ctx_active (gpgme_ctx_t ctx)
 {
+  gpgme_error_t err = 0;
+  unsigned int i;
   struct ctx_list_item *li = malloc (sizeof (struct ctx_list_item));
   if (!li)
     return gpg_error_from_syserror ();
   li->ctx = ctx;
+  li->nfds = 0;
+  li->status = 0;
+  li->op_err = 0;
 
   LOCK (ctx_list_lock);
-  /* Add LI to active list.  */
-  li->next = ctx_active_list;
-  li->prev = NULL;
-  if (ctx_active_list)
-    ctx_active_list->prev = li;
-  ctx_active_list = li;
+  for (i = 0; i < ctx->fdt.size && !err; i++)
+    if (ctx->fdt.fds[i].fd != -1)
+      err = global_fds_add (li, &ctx->fdt.fds[i]);
+  if (err)
+    {
+      global_fds_remove_ctx (li);
+      UNLOCK (ctx_list_lock);
+      free (li);
+      return err;
+    }
+
+  /* Add LI to active list.  A context without any fds is already
+     finished.  */
+  ctx_list_insert (li, li->nfds ? CTX_LIST_ACTIVE : CTX_LIST_FINISHED);
+  ctx->global_item = li;
   UNLOCK (ctx_list_lock);
   return 0;
 }
@@ -119,28 +279,19 @@ ctx_done (gpgme_ctx_t ctx, gpgme_error_t status, gpgme_error_t op_err)
   struct ctx_list_item *li;
 
   LOCK (ctx_list_lock);
-  li = ctx_active_list;
-  while (li && li->ctx != ctx)
-    li = li->next;
+  li = ctx->global_item;
   assert (li);
+  assert (li->list != CTX_LIST_DONE);
 
-  /* Remove LI from active list.  */
-  if (li->next)
-    li->next->prev = li->prev;
-  if (li->prev)
-    li->prev->next = li->next;
-  else
-    ctx_active_list = li->next;
+  /* Remove LI from active or finished list.  */
+  global_fds_remove_ctx (li);
+  ctx_list_remove (li);
 
   li->status = status;
   li->op_err = op_err;
 
   /* Add LI to done list.  */
-  li->next = ctx_done_list;
-  li->prev = NULL;
-  if (ctx_done_list)
-    ctx_done_list->prev = li;
-  ctx_done_list = li;
+  ctx_list_insert (li, CTX_LIST_DONE);
   UNLOCK (ctx_list_lock);
 }
 
@@ -155,13 +306,15 @@ ctx_wait (gpgme_ctx_t ctx, gpgme_error_t *status, gpgme_error_t *op_err)
   struct ctx_list_item *li;
 
   LOCK (ctx_list_lock);
-  li = ctx_done_list;
   if (ctx)
     {
       /* A specific context is requested.  */
-      while (li && li->ctx != ctx)
-	li = li->next;
+      li = ctx->global_item;
+      if (li && li->list != CTX_LIST_DONE)
+	li = NULL;
     }
+  else
+    li = ctx_done_list;
   if (li)
     {
       ctx = li->ctx;
@@ -171,12 +324,9 @@ ctx_wait (gpgme_ctx_t ctx, gpgme_error_t *status, gpgme_error_t *op_err)
 	*op_err = li->op_err;
 
       /* Remove LI from done list.  */
-      if (li->next)
-	li->next->prev = li->prev;
-      if (li->prev)
-	li->prev->next = li->next;
-      else
-	ctx_done_list = li->next;
+      ctx_list_remove (li);
+      if (ctx->global_item == li)
+	ctx->global_item = NULL;
       free (li);
     }
   else
@@ -185,11 +335,83 @@ ctx_wait (gpgme_ctx_t ctx, gpgme_error_t *status, gpgme_error_t *op_err)
   return ctx;
 }
 
-
+
 /* Internal I/O callback functions.  */
 
-/* The add_io_cb and remove_io_cb handlers are shared with the private
-   event loops.  */
+/* Register the file descriptor FD with the handler FNC (which gets
+   FNC_DATA as its first argument) for the direction DIR.  DATA is the
+   context for which the fd is added.  This is a wrapper around
+   _gpgme_add_io_cb which also enters the fd into the global fd table
+   if the context is already active.  */
+gpgme_error_t
+_gpgme_wait_global_add_io_cb (void *data, int fd, int dir,
+			      gpgme_io_cb_t fnc, void *fnc_data,
+			      void **r_tag)
+{
+  gpgme_ctx_t ctx = (gpgme_ctx_t) data;
+  struct ctx_list_item *li;
+  struct tag *tag;
+  gpgme_error_t err;
+
+  err = _gpgme_add_io_cb (data, fd, dir, fnc, fnc_data, r_tag);
+  if (err)
+    return err;
+  tag = *r_tag;
+
+  /* Fds added before the start event are entered by ctx_active.  */
+  LOCK (ctx_list_lock);
+  li = ctx->global_item;
+  if (li && li->list != CTX_LIST_DONE)
+    {
+      err = global_fds_add (li, &ctx->fdt.fds[tag->idx]);
+      if (!err && li->list == CTX_LIST_FINISHED)
+	{
+	  ctx_list_remove (li);
+	  ctx_list_insert (li, CTX_LIST_ACTIVE);
+	}
+    }
+  UNLOCK (ctx_list_lock);
+
+  if (err)
+    {
+      _gpgme_remove_io_cb (tag);
+      *r_tag = NULL;
+    }
+  return err;
+}
+
+
+/* Remove the I/O callback identified by TAG.  This is a wrapper
+   around _gpgme_remove_io_cb which also removes the fd from the
+   global fd table.  If this was the last fd of an active context, the
+   context is moved to the finished list.  */
+void
+_gpgme_wait_global_remove_io_cb (void *data)
+{
+  struct tag *tag = data;
+  gpgme_ctx_t ctx;
+  struct ctx_list_item *li;
+
+  assert (tag);
+  ctx = tag->ctx;
+  assert (ctx);
+
+  LOCK (ctx_list_lock);
+  li = ctx->global_item;
+  if (li && li->list != CTX_LIST_DONE)
+    {
+      global_fds_remove (li, &ctx->fdt.fds[tag->idx]);
+      if (!li->nfds && li->list == CTX_LIST_ACTIVE)
+	{
+	  ctx_list_remove (li);
+	  ctx_list_insert (li, CTX_LIST_FINISHED);
+	}
+    }
+  UNLOCK (ctx_list_lock);
+
+  _gpgme_remove_io_cb (tag);
+}
+
 
 void
 _gpgme_wait_global_event_cb (void *data, gpgme_event_io_t type,
@@ -255,35 +477,48 @@ gpgme_ctx_t
 gpgme_wait_ext (gpgme_ctx_t ctx, gpgme_error_t *status,
 		gpgme_error_t *op_err, int hang)
 {
+  /* Our private copy of the global fd table.  It is only refreshed if
+     the global fd table has changed.  */
+  struct fd_table fdt = { NULL, 0 };
+  size_t fdt_alloced = 0;
+  unsigned long generation = 0;
+  int have_fdt = 0;
+
   do
     {
-      unsigned int i = 0;
-      struct ctx_list_item *li;
-      struct fd_table fdt;
+      unsigned int i;
       int nr;
 
       /* Collect the active file descriptors.  */
       LOCK (ctx_list_lock);
-      for (li = ctx_active_list; li; li = li->next)
-	i += li->ctx->fdt.size;
-      fdt.fds = malloc (i * sizeof (struct io_select_fd_s));
-      if (!fdt.fds)
-	{
-          int saved_err = gpg_error_from_syserror ();
-	  UNLOCK (ctx_list_lock);
-	  if (status)
-	    *status = saved_err;
-	  if (op_err)
-	    *op_err = 0;
-	  return NULL;
-	}
-      fdt.size = i;
-      i = 0;
-      for (li = ctx_active_list; li; li = li->next)
+      if (!have_fdt || generation != global_fds_generation)
 	{
-	  memcpy (&fdt.fds[i], li->ctx->fdt.fds,
-		  li->ctx->fdt.size * sizeof (struct io_select_fd_s));
-	  i += li->ctx->fdt.size;
+	  if (global_fds_used > fdt_alloced)
+	    {
+	      struct io_select_fd_s *new_fds;
+
+	      new_fds = realloc (fdt.fds,
+				 global_fds_size * sizeof (*new_fds));
+	      if (!new_fds)
+		{
+		  int saved_err = gpg_error_from_syserror ();
+		  UNLOCK (ctx_list_lock);
+		  free (fdt.fds);
+		  if (status)
+		    *status = saved_err;
+		  if (op_err)
+		    *op_err = 0;
+		  return NULL;
+		}
+	      fdt.fds = new_fds;
+	      fdt_alloced = global_fds_size;
+	    }
+	  if (global_fds_used)
+	    memcpy (fdt.fds, global_fds,
+		    global_fds_used * sizeof (struct io_select_fd_s));
+	  fdt.size = global_fds_used;
+	  generation = global_fds_generation;
+	  have_fdt = 1;
 	}
       UNLOCK (ctx_list_lock);
 
@@ -307,6 +542,7 @@ gpgme_wait_ext (gpgme_ctx_t ctx, gpgme_error_t *status,
 	      gpgme_error_t err = 0;
 	      gpgme_error_t local_op_err = 0;
 	      struct wait_item_s *item;
+	      int changed;
 
 	      assert (nr);
 	      nr--;
@@ -316,10 +552,10 @@ gpgme_wait_ext (gpgme_ctx_t ctx, gpgme_error_t *status,
 	      ictx = item->ctx;
 	      assert (ictx);
 
-	      LOCK (ctx->lock);
-	      if (ctx->canceled)
+	      LOCK (ictx->lock);
+	      if (ictx->canceled)
 		err = gpg_error (GPG_ERR_CANCELED);
-	      UNLOCK (ctx->lock);
+	      UNLOCK (ictx->lock);
 
 	      if (!err)
 		err = _gpgme_run_io_cb (&fdt.fds[i], 0, &local_op_err);
@@ -334,39 +570,35 @@ gpgme_wait_ext (gpgme_ctx_t ctx, gpgme_error_t *status,
 		     gone.  */
 		  break;
 		}
+
+	      /* If the handler added or removed fds, the remaining
+		 entries of our copy may be stale.  The fds not yet
+		 processed are still ready and will be picked up by
+		 the next select().  */
+	      LOCK (ctx_list_lock);
+	      changed = (generation != global_fds_generation);
+	      UNLOCK (ctx_list_lock);
+	      if (changed)
+		break;
 	    }
 	}
-      free (fdt.fds);
 
-      /* Now some contexts might have finished successfully.  */
+      /* Now some contexts might have finished successfully.  The
+	 done event handler moves them from the finished list to the
+	 done list.  */
       LOCK (ctx_list_lock);
-    retry:
-      for (li = ctx_active_list; li; li = li->next)
+      while (ctx_finished_list)
 	{
-	  gpgme_ctx_t actx = li->ctx;
+	  gpgme_ctx_t actx = ctx_finished_list->ctx;
+	  struct gpgme_io_event_done_data data;
+	  data.err = 0;
+	  data.op_err = 0;
 
-	  for (i = 0; i < actx->fdt.size; i++)
-	    if (actx->fdt.fds[i].fd != -1)
-	      break;
-	  if (i == actx->fdt.size)
-	    {
-	      struct gpgme_io_event_done_data data;
-	      data.err = 0;
-	      data.op_err = 0;
-
-	      /* FIXME: This does not perform too well.  We have to
-		 release the lock because the I/O event handler
-		 acquires it to remove the context from the active
-		 list.  Two alternative strategies are worth
-		 considering: Either implement the DONE event handler
-		 here in a lock-free manner, or save a list of all
-		 contexts to be released and call the DONE events
-		 afterwards.  */
-	      UNLOCK (ctx_list_lock);
-	      _gpgme_engine_io_event (actx->engine, GPGME_EVENT_DONE, &data);
-	      LOCK (ctx_list_lock);
-	      goto retry;
-	    }
+	  /* We have to release the lock because the I/O event handler
+	     acquires it to move the context to the done list.  */
+	  UNLOCK (ctx_list_lock);
+	  _gpgme_engine_io_event (actx->engine, GPGME_EVENT_DONE, &data);
+	  LOCK (ctx_list_lock);
 	}
       UNLOCK (ctx_list_lock);
 
@@ -390,6 +622,7 @@ gpgme_wait_ext (gpgme_ctx_t ctx, gpgme_error_t *status,
     }
   while (hang);
 
+  free (fdt.fds);
   return ctx;
 }
 
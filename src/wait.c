@@ -127,6 +127,7 @@ _gpgme_add_io_cb (void *data, int fd, int dir, gpgme_io_cb_t fnc,
   item->dir = dir;
   item->handler = fnc;
   item->handler_value = fnc_data;
+  item->global_idx = -1;
 
   err = fd_table_put (fdt, fd, dir, item, &tag->idx);
   if (err)
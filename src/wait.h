@@ -40,6 +40,10 @@ struct wait_item_s
   gpgme_io_cb_t handler;
   void *handler_value;
   int dir;
+
+  /* The index into the fd table of the global event loop or -1 if
+     the fd is not registered there.  */
+  int global_idx;
 };
 
 /* A registered fd handler is removed later using the tag that
@@ -68,6 +72,11 @@ void _gpgme_wait_private_event_cb (void *data, gpgme_event_io_t type,
 void _gpgme_wait_global_event_cb (void *data, gpgme_event_io_t type,
 				  void *type_data);
 
+gpgme_error_t _gpgme_wait_global_add_io_cb (void *data, int fd, int dir,
+					    gpgme_io_cb_t fnc, void *fnc_data,
+					    void **r_tag);
+void _gpgme_wait_global_remove_io_cb (void *tag);
+
 gpgme_error_t _gpgme_wait_user_add_io_cb (void *data, int fd, int dir,
 					  gpgme_io_cb_t fnc, void *fnc_data,
 					  void **r_tag);
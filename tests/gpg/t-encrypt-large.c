@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include <gpgme.h>
 
@@ -80,9 +81,22 @@ progress_cb (void *opaque, const char *what, int type, int current, int total)
 }
 
 
+static double
+now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
 
 
 
+/* Usage: t-encrypt-large [NBYTES [IO-BUFFER-SIZE]]
+ *
+ * With the optional arguments this can be used as a benchmark for
+ * the data transfer between GPGME and gpg.  */
 int
 main (int argc, char *argv[])
 {
@@ -94,11 +108,15 @@ main (int argc, char *argv[])
   gpgme_encrypt_result_t result;
   size_t nbytes;
   struct cb_parms parms;
+  const char *io_buffer_size = NULL;
+  double start, elapsed;
 
   if (argc > 1)
     nbytes = atoi (argv[1]);
   else
     nbytes = 100000;
+  if (argc > 2)
+    io_buffer_size = argv[2];
 
   init_gpgme (GPGME_PROTOCOL_OpenPGP);
 
@@ -111,6 +129,11 @@ main (int argc, char *argv[])
   err = gpgme_new (&ctx);
   fail_if_err (err);
   gpgme_set_armor (ctx, 0);
+  if (io_buffer_size)
+    {
+      err = gpgme_set_ctx_flag (ctx, "io-buffer-size", io_buffer_size);
+      fail_if_err (err);
+    }
 
   /* Install a progress handler to enforce a bit of more work to the
      gpgme i/o system. */
@@ -129,8 +152,10 @@ main (int argc, char *argv[])
 		       &key[1], 0);
   fail_if_err (err);
 
+  start = now ();
   err = gpgme_op_encrypt (ctx, key, GPGME_ENCRYPT_ALWAYS_TRUST, in, out);
   fail_if_err (err);
+  elapsed = now () - start;
   result = gpgme_op_encrypt_result (ctx);
   if (result->invalid_recipients)
     {
@@ -140,6 +165,10 @@ main (int argc, char *argv[])
     }
   printf ("plaintext=%u bytes, ciphertext=%u bytes\n",
           (unsigned int)nbytes, (unsigned int)parms.bytes_received);
+  if (io_buffer_size)
+    printf ("io-buffer-size=%s time=%.3fs throughput=%.1f MiB/s\n",
+            io_buffer_size, elapsed,
+            elapsed > 0 ? nbytes / elapsed / (1024 * 1024) : 0.0);
 
   gpgme_key_unref (key[0]);
   gpgme_key_unref (key[1]);
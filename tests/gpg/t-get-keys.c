@@ -0,0 +1,110 @@
+/* t-get-keys.c - Regression test for gpgme_get_keys.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <gpgme.h>
+
+#include "t-support.h"
+
+
+#define ALPHA_FPR "A0FF4590BB6122EDEF6E3C542D727CC768697734"
+#define BOB_FPR   "D695676BDCEDCC2CDD6152BCFE180B1DA9E3B0B2"
+
+static struct
+{
+  const char *pattern;
+  const char *fpr;
+  gpg_err_code_t code;
+} lookups[] =
+  {
+    { ALPHA_FPR, ALPHA_FPR, GPG_ERR_NO_ERROR },
+    { "0xd695676bdcedcc2cdd6152bcfe180b1da9e3b0b2", BOB_FPR,
+      GPG_ERR_NO_ERROR },
+    { "2D727CC768697734", ALPHA_FPR, GPG_ERR_NO_ERROR },
+    { "0000000000000000000000000000000000000000", NULL, GPG_ERR_EOF },
+    { "alpha@example.net", NULL, GPG_ERR_INV_VALUE },
+    { ALPHA_FPR, ALPHA_FPR, GPG_ERR_NO_ERROR }
+  };
+#define NLOOKUPS (sizeof lookups / sizeof lookups[0])
+
+
+int
+main (int argc, char **argv)
+{
+  gpgme_ctx_t ctx;
+  gpgme_error_t err;
+  const char *fprs[NLOOKUPS + 1];
+  gpgme_key_t keys[NLOOKUPS];
+  gpgme_error_t errs[NLOOKUPS];
+  int i;
+
+  (void)argc;
+  (void)argv;
+
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+
+  for (i = 0; i < NLOOKUPS; i++)
+    fprs[i] = lookups[i].pattern;
+  fprs[i] = NULL;
+
+  err = gpgme_get_keys (ctx, fprs, keys, errs);
+  fail_if_err (err);
+
+  for (i = 0; i < NLOOKUPS; i++)
+    {
+      if (gpgme_err_code (errs[i]) != lookups[i].code)
+        {
+          fprintf (stderr, "%s:%i: %s: unexpected result: %s\n",
+                   __FILE__, __LINE__, lookups[i].pattern,
+                   gpgme_strerror (errs[i]));
+          exit (1);
+        }
+      if (lookups[i].fpr
+          ? (!keys[i] || !keys[i]->fpr || strcmp (keys[i]->fpr,
+                                                  lookups[i].fpr))
+          : !!keys[i])
+        {
+          fprintf (stderr, "%s:%i: %s: wrong key returned\n",
+                   __FILE__, __LINE__, lookups[i].pattern);
+          exit (1);
+        }
+      gpgme_key_unref (keys[i]);
+    }
+
+  /* An empty list is not an error.  */
+  fprs[0] = NULL;
+  err = gpgme_get_keys (ctx, fprs, keys, errs);
+  fail_if_err (err);
+
+  gpgme_release (ctx);
+  return 0;
+}
@@ -0,0 +1,180 @@
+/* t-keycache.c - Regression test for the key cache.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <utime.h>
+
+#include <gpgme.h>
+
+#include "t-support.h"
+
+
+#define ALPHA_FPR "A0FF4590BB6122EDEF6E3C542D727CC768697734"
+
+
+static void
+check_stats (unsigned long hits, unsigned long misses, int line)
+{
+  unsigned long h, m;
+
+  gpgme_key_cache_stats (&h, &m);
+  if (h != hits || m != misses)
+    {
+      fprintf (stderr, "%s:%i: hits=%lu (want %lu), misses=%lu (want %lu)\n",
+               __FILE__, line, h, hits, m, misses);
+      exit (1);
+    }
+}
+
+
+static gpgme_key_t
+get_key (gpgme_ctx_t ctx, const char *fpr, int secret)
+{
+  gpgme_error_t err;
+  gpgme_key_t key;
+
+  err = gpgme_get_key (ctx, fpr, &key, secret);
+  fail_if_err (err);
+  if (!key->fpr || strcmp (key->fpr, ALPHA_FPR))
+    {
+      fprintf (stderr, "%s:%i: wrong key returned\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  return key;
+}
+
+
+/* Set the modification time of the keyring into the past.  */
+static void
+touch_keyring (void)
+{
+  const char *names[] = { "pubring.kbx", "pubring.gpg" };
+  struct utimbuf ut;
+  char fname[1024];
+  const char *home;
+  int i, any = 0;
+
+  home = getenv ("GNUPGHOME");
+  if (!home)
+    home = ".";
+  ut.actime = ut.modtime = time (NULL) - 3600;
+  for (i = 0; i < 2; i++)
+    {
+      snprintf (fname, sizeof fname, "%s/%s", home, names[i]);
+      if (!utime (fname, &ut))
+        any = 1;
+    }
+  if (!any)
+    {
+      fprintf (stderr, "%s:%i: no keyring found\n", __FILE__, __LINE__);
+      exit (1);
+    }
+}
+
+
+int
+main (int argc, char **argv)
+{
+  gpgme_ctx_t ctx;
+  gpgme_error_t err;
+  gpgme_key_t key1, key2;
+
+  (void)argc;
+  (void)argv;
+
+  if (gpgme_set_global_flag ("key-cache", "600"))
+    {
+      fprintf (stderr, "%s:%i: setting key-cache failed\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+
+  check_stats (0, 0, __LINE__);
+  key1 = get_key (ctx, ALPHA_FPR, 0);
+  check_stats (0, 1, __LINE__);
+  key2 = get_key (ctx, ALPHA_FPR, 0);
+  check_stats (1, 1, __LINE__);
+  if (key1 != key2)
+    {
+      fprintf (stderr, "%s:%i: key not taken from the cache\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+  gpgme_key_unref (key2);
+
+  /* The case of the fingerprint does not matter.  */
+  key2 = get_key (ctx, "a0ff4590bb6122edef6e3c542d727cc768697734", 0);
+  check_stats (2, 1, __LINE__);
+  gpgme_key_unref (key2);
+
+  /* Secret keys and other keylist modes are cached separately.  */
+  key2 = get_key (ctx, ALPHA_FPR, 1);
+  check_stats (2, 2, __LINE__);
+  gpgme_key_unref (key2);
+  gpgme_set_keylist_mode (ctx, GPGME_KEYLIST_MODE_LOCAL
+                          | GPGME_KEYLIST_MODE_SIGS);
+  key2 = get_key (ctx, ALPHA_FPR, 0);
+  check_stats (2, 3, __LINE__);
+  gpgme_key_unref (key2);
+  gpgme_set_keylist_mode (ctx, GPGME_KEYLIST_MODE_LOCAL);
+
+  /* Key IDs are not cached.  */
+  key2 = get_key (ctx, "2D727CC768697734", 0);
+  check_stats (2, 3, __LINE__);
+  gpgme_key_unref (key2);
+
+  /* A change of the keyring invalidates the cache.  */
+  touch_keyring ();
+  key2 = get_key (ctx, ALPHA_FPR, 0);
+  check_stats (2, 4, __LINE__);
+  if (key1 == key2)
+    {
+      fprintf (stderr, "%s:%i: outdated key taken from the cache\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+  gpgme_key_unref (key2);
+  key2 = get_key (ctx, ALPHA_FPR, 0);
+  check_stats (3, 4, __LINE__);
+  gpgme_key_unref (key2);
+
+  /* Disabling the cache.  */
+  gpgme_set_global_flag ("key-cache", "0");
+  key2 = get_key (ctx, ALPHA_FPR, 0);
+  check_stats (3, 4, __LINE__);
+  gpgme_key_unref (key2);
+
+  gpgme_key_unref (key1);
+  gpgme_release (ctx);
+  return 0;
+}
@@ -573,6 +573,61 @@ main (int argc, char **argv)
       exit (1);
     }
 
+  /* List again in batches and check that the same keys are returned
+     in the same order.  */
+  err = gpgme_op_keylist_start (ctx, NULL, 0);
+  fail_if_err (err);
+
+  i = 0;
+  for (;;)
+    {
+      gpgme_key_t batch[3];
+      size_t count, k;
+
+      err = gpgme_op_keylist_next_n (ctx, batch, DIM (batch), &count);
+      if (err)
+        {
+          if (count)
+            {
+              fprintf (stderr, "Keys returned along with an error\n");
+              exit (1);
+            }
+          break;
+        }
+      if (!count || count > DIM (batch))
+        {
+          fprintf (stderr, "Invalid number of keys (%d) in batch\n",
+                   (int)count);
+          exit (1);
+        }
+      for (k = 0; k < count; k++, i++)
+        {
+          if (!keys[i].fpr)
+            {
+              fprintf (stderr, "More keys returned than expected in batch\n");
+              exit (1);
+            }
+          if (strcmp (batch[k]->subkeys->fpr, keys[i].fpr))
+            {
+              fprintf (stderr, "Batch key %d has wrong fingerprint: %s\n",
+                       i, batch[k]->subkeys->fpr);
+              exit (1);
+            }
+          gpgme_key_unref (batch[k]);
+        }
+    }
+  if (gpgme_err_code (err) != GPG_ERR_EOF)
+    fail_if_err (err);
+  err = gpgme_op_keylist_end (ctx);
+  fail_if_err (err);
+
+  if (keys[i].fpr)
+    {
+      fprintf (stderr, "Less keys (%d) returned in batches than expected\n",
+	       i);
+      exit (1);
+    }
+
   gpgme_release (ctx);
   return 0;
 }
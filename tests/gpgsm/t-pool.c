@@ -0,0 +1,195 @@
+/* t-pool.c - Regression test for the engine pool.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gpgme.h>
+
+#include "t-support.h"
+
+
+#define TEST_FPR "3CF405464F66ED4A7DF45BBDD1E4282E33BDB76E"
+
+
+static gpgme_ctx_t
+new_context (const char *lc_messages)
+{
+  gpgme_ctx_t ctx;
+  gpgme_error_t err;
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+  err = gpgme_set_protocol (ctx, GPGME_PROTOCOL_CMS);
+  fail_if_err (err);
+  if (lc_messages)
+    {
+      err = gpgme_set_locale (ctx, LC_MESSAGES, lc_messages);
+      fail_if_err (err);
+    }
+  return ctx;
+}
+
+
+/* Return the number of certificates.  */
+static int
+count_keys (gpgme_ctx_t ctx)
+{
+  gpgme_error_t err;
+  gpgme_key_t key;
+  int count = 0;
+
+  err = gpgme_op_keylist_start (ctx, NULL, 0);
+  fail_if_err (err);
+  while (!(err = gpgme_op_keylist_next (ctx, &key)))
+    {
+      count++;
+      gpgme_key_unref (key);
+    }
+  if (gpgme_err_code (err) != GPG_ERR_EOF)
+    fail_if_err (err);
+  return count;
+}
+
+
+/* Sign and encrypt in CTX to make sure that the signer of this
+   context is not passed on with the engine.  */
+static void
+sign_and_encrypt (gpgme_ctx_t ctx, int with_signer)
+{
+  gpgme_error_t err;
+  gpgme_data_t in, out;
+  gpgme_key_t key[] = { NULL, NULL };
+  gpgme_encrypt_result_t result;
+
+  err = gpgme_get_key (ctx, TEST_FPR, &key[0], 0);
+  fail_if_err (err);
+  if (with_signer)
+    {
+      err = gpgme_signers_add (ctx, key[0]);
+      fail_if_err (err);
+    }
+
+  err = gpgme_data_new_from_mem (&in, "Hallo Leute\n", 12, 0);
+  fail_if_err (err);
+  err = gpgme_data_new (&out);
+  fail_if_err (err);
+
+  err = gpgme_op_encrypt (ctx, key, 0, in, out);
+  fail_if_err (err);
+  result = gpgme_op_encrypt_result (ctx);
+  if (result->invalid_recipients)
+    {
+      fprintf (stderr, "%s:%i: invalid recipient encountered: %s\n",
+               __FILE__, __LINE__, result->invalid_recipients->fpr);
+      exit (1);
+    }
+
+  gpgme_key_unref (key[0]);
+  gpgme_data_release (in);
+  gpgme_data_release (out);
+}
+
+
+int
+main (void)
+{
+  gpgme_ctx_t ctx, ctx2;
+  int count, i;
+
+  if (gpgme_set_global_flag ("engine-pool", "2"))
+    {
+      fprintf (stderr, "%s:%i: setting engine-pool failed\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+  init_gpgme (GPGME_PROTOCOL_CMS);
+
+  ctx = new_context (NULL);
+  count = count_keys (ctx);
+  if (!count)
+    {
+      fprintf (stderr, "%s:%i: no keys found\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  sign_and_encrypt (ctx, 1);
+  gpgme_release (ctx);
+
+  /* The following contexts may get the engine of the former ones.  */
+  for (i = 0; i < 3; i++)
+    {
+      ctx = new_context (NULL);
+      ctx2 = new_context (NULL);
+      sign_and_encrypt (ctx, 0);
+      if (count_keys (ctx) != count || count_keys (ctx2) != count)
+        {
+          fprintf (stderr, "%s:%i: wrong number of keys\n",
+                   __FILE__, __LINE__);
+          exit (1);
+        }
+      gpgme_release (ctx2);
+      gpgme_release (ctx);
+    }
+
+  /* The request origin of a context must not be passed on.  */
+  ctx = new_context (NULL);
+  fail_if_err (gpgme_set_ctx_flag (ctx, "request-origin", "remote"));
+  if (count_keys (ctx) != count)
+    {
+      fprintf (stderr, "%s:%i: wrong number of keys\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  gpgme_release (ctx);
+  ctx = new_context (NULL);
+  sign_and_encrypt (ctx, 1);
+  gpgme_release (ctx);
+
+  /* A different locale needs another engine.  */
+  ctx = new_context ("C");
+  if (count_keys (ctx) != count)
+    {
+      fprintf (stderr, "%s:%i: wrong number of keys\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  gpgme_release (ctx);
+
+  /* Disabling the pool releases the idle engines.  */
+  if (gpgme_set_global_flag ("engine-pool", "0"))
+    {
+      fprintf (stderr, "%s:%i: disabling engine-pool failed\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+  ctx = new_context (NULL);
+  if (count_keys (ctx) != count)
+    {
+      fprintf (stderr, "%s:%i: wrong number of keys\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  gpgme_release (ctx);
+  return 0;
+}
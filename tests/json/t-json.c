@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <stdint.h>
 #include <sys/stat.h>
 
 #include <gpgme.h>
@@ -46,6 +47,12 @@ static const char*tests[] = { "t-config", "t-version",
     "t-delete", "t-import",
     NULL };
 
+/* Tests which are also run together in Native Messaging mode, where
+ * requests with an id may be answered in any order.  */
+static const char*concurrent_tests[] = { "t-version", "t-keylist",
+    "t-decrypt", "t-encrypt", "t-sign", "t-verify", "t-decrypt-verify",
+    "t-chunking", NULL };
+
 static int verbose = 0;
 
 
@@ -465,6 +472,460 @@ run_test (const char *test, const char *gpgme_json)
   return rc;
 }
 
+/* Run the CONCURRENT_TESTS as one batch of requests with an id in
+   Native Messaging mode and check that each request gets its
+   response.  */
+int
+run_concurrent_test (const char *gpgme_json)
+{
+  gpgme_ctx_t ctx;
+  gpgme_data_t json_stdin = NULL;
+  gpgme_data_t json_stdout = NULL;
+  gpgme_data_t json_stderr = NULL;
+  const char *argv[2];
+  const char *top_srcdir = getenv ("top_srcdir");
+  char *expected[DIM (concurrent_tests)];
+  int seen[DIM (concurrent_tests)];
+  char *fname, *buffer, *request, *response;
+  cjson_t json, j_id;
+  size_t response_size, off;
+  uint32_t n;
+  int ntests = DIM (concurrent_tests) - 1;
+  int i, count = 0;
+  int rc = 0;
+
+  printf ("Running concurrent requests...\n");
+
+  fail_if_err (gpgme_new (&ctx));
+  gpgme_set_protocol (ctx, GPGME_PROTOCOL_SPAWN);
+  fail_if_err (gpgme_data_new (&json_stdin));
+  fail_if_err (gpgme_data_new (&json_stdout));
+  fail_if_err (gpgme_data_new (&json_stderr));
+
+  /* Send all requests with their index as id.  */
+  for (i = 0; concurrent_tests[i]; i++)
+    {
+      gpgrt_asprintf (&fname, "%s/tests/json/%s.in.json",
+                      top_srcdir, concurrent_tests[i]);
+      buffer = get_file (fname);
+      test (buffer);
+      json = cJSON_Parse (buffer, NULL);
+      test (json);
+      cJSON_AddNumberToObject (json, "id", i);
+      request = cJSON_PrintUnformatted (json);
+      n = strlen (request);
+      test (gpgme_data_write (json_stdin, &n, sizeof n) == sizeof n);
+      test (gpgme_data_write (json_stdin, request, n) == n);
+      free (request);
+      cJSON_Delete (json);
+      free (buffer);
+      free (fname);
+
+      gpgrt_asprintf (&fname, "%s/tests/json/%s.out.json",
+                      top_srcdir, concurrent_tests[i]);
+      expected[i] = get_file (fname);
+      test (expected[i]);
+      free (fname);
+      seen[i] = 0;
+    }
+  gpgme_data_seek (json_stdin, 0, SEEK_SET);
+
+  argv[0] = gpgme_json;
+  argv[1] = NULL;
+  fail_if_err (gpgme_op_spawn (ctx, gpgme_json, argv,
+                               json_stdin, json_stdout, json_stderr, 0));
+  response = gpgme_data_release_and_get_mem (json_stdout, &response_size);
+
+  /* Match the responses to the requests.  Chunked responses are not
+     retrieved because the getmore requests would need to be sent
+     after the first chunk; the first chunk must carry the id.  */
+  for (off = 0; !rc && off + sizeof n <= response_size; off += n)
+    {
+      memcpy (&n, response + off, sizeof n);
+      off += sizeof n;
+      if (off + n > response_size)
+        break;
+      buffer = malloc (n + 1);
+      test (buffer);
+      memcpy (buffer, response + off, n);
+      buffer[n] = 0;
+      json = cJSON_Parse (buffer, NULL);
+      j_id = json? cJSON_GetObjectItem (json, "id") : NULL;
+      if (!j_id || !cjson_is_number (j_id)
+          || j_id->valueint < 0 || j_id->valueint >= ntests
+          || seen[j_id->valueint]++)
+        {
+          fprintf (stderr, "Unexpected response: %s\n", buffer);
+          rc = 1;
+        }
+      else if (!cJSON_GetObjectItem (json, "more"))
+        rc = check_response (buffer, expected[j_id->valueint]);
+      cJSON_Delete (json);
+      free (buffer);
+      count++;
+    }
+  if (!rc && count != ntests)
+    {
+      fprintf (stderr, "Got %d responses for %d requests\n", count, ntests);
+      rc = 1;
+    }
+
+  if (!rc)
+    {
+      printf (" success\n");
+      gpgme_data_release (json_stderr);
+    }
+  else
+    {
+      buffer = gpgme_data_release_and_get_mem (json_stderr, &response_size);
+      printf (" failed\n");
+      if (response_size)
+        printf ("gpgme-json stderr:\n%.*s\n", (int)response_size, buffer);
+      free (buffer);
+    }
+
+  for (i = 0; concurrent_tests[i]; i++)
+    free (expected[i]);
+  free (response);
+  gpgme_data_release (json_stdin);
+  gpgme_release (ctx);
+
+  return rc;
+}
+
+/* Write the framed request JSON to DATA and release JSON.  */
+static void
+write_request (gpgme_data_t data, cjson_t json)
+{
+  char *request;
+  uint32_t n;
+
+  request = cJSON_PrintUnformatted (json);
+  test (request);
+  n = strlen (request);
+  test (gpgme_data_write (data, &n, sizeof n) == sizeof n);
+  test (gpgme_data_write (data, request, n) == n);
+  free (request);
+  cJSON_Delete (json);
+}
+
+
+/* Write a streaming request for OP with ID to DATA followed by the
+   base64 encoded INPUT split into putdata requests of CHUNKLEN
+   characters.  Returns the number of putdata requests.  */
+static int
+write_stream_request (gpgme_data_t data, cjson_t json, const char *id,
+                      const char *input, size_t chunklen)
+{
+  cjson_t j_put;
+  size_t len = strlen (input);
+  size_t off, n;
+  char *chunk;
+  int count = 0;
+
+  cJSON_AddStringToObject (json, "id", id);
+  cJSON_AddBoolToObject (json, "stream", 1);
+  write_request (data, json);
+
+  for (off = 0; off < len; off += n)
+    {
+      n = len - off > chunklen? chunklen : len - off;
+      chunk = strndup (input + off, n);
+      test (chunk);
+      j_put = cJSON_CreateObject ();
+      cJSON_AddStringToObject (j_put, "op", "putdata");
+      cJSON_AddStringToObject (j_put, "id", id);
+      cJSON_AddStringToObject (j_put, "data", chunk);
+      cJSON_AddBoolToObject (j_put, "more", off + n < len);
+      write_request (data, j_put);
+      free (chunk);
+      count++;
+    }
+  return count;
+}
+
+
+/* Append the base64 encoded DATA to the buffer at R_BUFFER of length
+   R_LENGTH.  */
+static void
+append_base64 (char **r_buffer, size_t *r_length, const char *data)
+{
+  gpgrt_b64state_t state;
+  char *buffer;
+  size_t n;
+
+  buffer = strdup (data);
+  test (buffer);
+  state = gpgrt_b64dec_start (NULL);
+  test (state);
+  test (!gpgrt_b64dec_proc (state, buffer, strlen (buffer), &n));
+  test (!gpgrt_b64dec_finish (state));
+  *r_buffer = realloc (*r_buffer, *r_length + n + 1);
+  test (*r_buffer);
+  memcpy (*r_buffer + *r_length, buffer, n);
+  *r_length += n;
+  (*r_buffer)[*r_length] = 0;
+  free (buffer);
+}
+
+
+/* Run a streaming encrypt and decrypt in Native Messaging mode.  The
+   input is sent in several chunks and the output is collected from
+   the partial responses.  */
+static int
+run_stream_test (const char *gpgme_json)
+{
+  static const char *ids[] = { "enc", "dec" };
+  gpgme_ctx_t ctx;
+  gpgme_data_t json_stdin = NULL;
+  gpgme_data_t json_stdout = NULL;
+  gpgme_data_t json_stderr = NULL;
+  const char *argv[2];
+  const char *top_srcdir = getenv ("top_srcdir");
+  char *output[DIM (ids)] = { NULL, NULL };
+  size_t outlen[DIM (ids)] = { 0, 0 };
+  int nput[DIM (ids)], nack[DIM (ids)], done[DIM (ids)];
+  char *fname, *buffer, *response;
+  cjson_t json, j_tmp, j_id;
+  size_t response_size, off;
+  uint32_t n;
+  int i;
+  int rc = 0;
+
+  printf ("Running streaming requests...\n");
+
+  fail_if_err (gpgme_new (&ctx));
+  gpgme_set_protocol (ctx, GPGME_PROTOCOL_SPAWN);
+  fail_if_err (gpgme_data_new (&json_stdin));
+  fail_if_err (gpgme_data_new (&json_stdout));
+  fail_if_err (gpgme_data_new (&json_stderr));
+
+  /* Encrypt "Hello\n" with a small chunksize to get several chunks
+     of armored output.  */
+  json = cJSON_CreateObject ();
+  cJSON_AddStringToObject (json, "op", "encrypt");
+  cJSON_AddStringToObject (json, "keys", "alpha@example.net");
+  cJSON_AddBoolToObject (json, "armor", 1);
+  cJSON_AddBoolToObject (json, "always-trust", 1);
+  cJSON_AddNumberToObject (json, "chunksize", 200);
+  nput[0] = write_stream_request (json_stdin, json, ids[0], "SGVsbG8K", 4);
+
+  /* Decrypt the message of t-decrypt.  */
+  gpgrt_asprintf (&fname, "%s/tests/json/t-decrypt.in.json", top_srcdir);
+  buffer = get_file (fname);
+  test (buffer);
+  free (fname);
+  json = cJSON_Parse (buffer, NULL);
+  test (json);
+  free (buffer);
+  j_tmp = cJSON_GetObjectItem (json, "data");
+  test (j_tmp && cjson_is_string (j_tmp));
+  buffer = strdup (j_tmp->valuestring);
+  test (buffer);
+  cJSON_Delete (json);
+  json = cJSON_CreateObject ();
+  cJSON_AddStringToObject (json, "op", "decrypt");
+  nput[1] = write_stream_request (json_stdin, json, ids[1], buffer, 64);
+  free (buffer);
+  gpgme_data_seek (json_stdin, 0, SEEK_SET);
+
+  argv[0] = gpgme_json;
+  argv[1] = NULL;
+  fail_if_err (gpgme_op_spawn (ctx, gpgme_json, argv,
+                               json_stdin, json_stdout, json_stderr, 0));
+  response = gpgme_data_release_and_get_mem (json_stdout, &response_size);
+
+  for (i = 0; i < DIM (ids); i++)
+    nack[i] = done[i] = 0;
+  for (off = 0; !rc && off + sizeof n <= response_size; off += n)
+    {
+      memcpy (&n, response + off, sizeof n);
+      off += sizeof n;
+      if (off + n > response_size)
+        break;
+      buffer = malloc (n + 1);
+      test (buffer);
+      memcpy (buffer, response + off, n);
+      buffer[n] = 0;
+      json = cJSON_Parse (buffer, NULL);
+      j_id = json? cJSON_GetObjectItem (json, "id") : NULL;
+      j_tmp = json? cJSON_GetObjectItem (json, "type") : NULL;
+      for (i = 0; j_id && cjson_is_string (j_id) && i < DIM (ids); i++)
+        if (!strcmp (j_id->valuestring, ids[i]))
+          break;
+      if (!j_id || !cjson_is_string (j_id) || i == DIM (ids) || done[i])
+        {
+          fprintf (stderr, "Unexpected response: %s\n", buffer);
+          rc = 1;
+        }
+      else if (cJSON_GetObjectItem (json, "response"))
+        {
+          /* Due to the chunksize the final response is sent in the
+             getmore format.  */
+          done[i] = 1;
+        }
+      else if (!j_tmp || !cjson_is_string (j_tmp)
+               || !strcmp (j_tmp->valuestring, "error"))
+        {
+          fprintf (stderr, "Unexpected response: %s\n", buffer);
+          rc = 1;
+        }
+      else if (!strcmp (j_tmp->valuestring, "putdata"))
+        nack[i]++;
+      else if (cJSON_GetObjectItem (json, "partial"))
+        {
+          j_tmp = cJSON_GetObjectItem (json, "data");
+          test (j_tmp && cjson_is_string (j_tmp));
+          append_base64 (&output[i], &outlen[i], j_tmp->valuestring);
+        }
+      else
+        done[i] = 1;
+      cJSON_Delete (json);
+      free (buffer);
+    }
+
+  for (i = 0; !rc && i < DIM (ids); i++)
+    if (!done[i] || nack[i] != nput[i] || !output[i])
+      {
+        fprintf (stderr, "Stream %s: %s, %d of %d chunks acknowledged\n",
+                 ids[i], done[i]? "done" : "not done", nack[i], nput[i]);
+        rc = 1;
+      }
+  if (!rc && strncmp (output[0], "-----BEGIN PGP MESSAGE-----", 27))
+    {
+      fprintf (stderr, "Stream %s: unexpected output: %s\n",
+               ids[0], output[0]);
+      rc = 1;
+    }
+  if (!rc && strcmp (output[1], "Hello\n"))
+    {
+      fprintf (stderr, "Stream %s: unexpected output: %s\n",
+               ids[1], output[1]);
+      rc = 1;
+    }
+
+  if (!rc)
+    {
+      printf (" success\n");
+      gpgme_data_release (json_stderr);
+    }
+  else
+    {
+      buffer = gpgme_data_release_and_get_mem (json_stderr, &response_size);
+      printf (" failed\n");
+      if (response_size)
+        printf ("gpgme-json stderr:\n%.*s\n", (int)response_size, buffer);
+      free (buffer);
+    }
+
+  for (i = 0; i < DIM (ids); i++)
+    free (output[i]);
+  free (response);
+  gpgme_data_release (json_stdin);
+  gpgme_release (ctx);
+
+  return rc;
+}
+
+/* Close the connection while a streaming encrypt still waits for
+   input.  gpgme-json must terminate and must not encrypt the
+   truncated input.  */
+static int
+run_stream_abort_test (const char *gpgme_json)
+{
+  gpgme_ctx_t ctx;
+  gpgme_data_t json_stdin = NULL;
+  gpgme_data_t json_stdout = NULL;
+  gpgme_data_t json_stderr = NULL;
+  const char *argv[2];
+  char *buffer, *response;
+  cjson_t json, j_tmp;
+  size_t response_size, off;
+  uint32_t n;
+  int nerrors = 0;
+  int rc = 0;
+
+  printf ("Running an aborted streaming request...\n");
+
+  fail_if_err (gpgme_new (&ctx));
+  gpgme_set_protocol (ctx, GPGME_PROTOCOL_SPAWN);
+  fail_if_err (gpgme_data_new (&json_stdin));
+  fail_if_err (gpgme_data_new (&json_stdout));
+  fail_if_err (gpgme_data_new (&json_stderr));
+
+  json = cJSON_CreateObject ();
+  cJSON_AddStringToObject (json, "op", "encrypt");
+  cJSON_AddStringToObject (json, "keys", "alpha@example.net");
+  cJSON_AddBoolToObject (json, "always-trust", 1);
+  cJSON_AddStringToObject (json, "id", "abort");
+  cJSON_AddBoolToObject (json, "stream", 1);
+  write_request (json_stdin, json);
+  json = cJSON_CreateObject ();
+  cJSON_AddStringToObject (json, "op", "putdata");
+  cJSON_AddStringToObject (json, "id", "abort");
+  cJSON_AddStringToObject (json, "data", "SGVsbG8K");
+  cJSON_AddBoolToObject (json, "more", 1);
+  write_request (json_stdin, json);
+  gpgme_data_seek (json_stdin, 0, SEEK_SET);
+
+  argv[0] = gpgme_json;
+  argv[1] = NULL;
+  fail_if_err (gpgme_op_spawn (ctx, gpgme_json, argv,
+                               json_stdin, json_stdout, json_stderr, 0));
+  response = gpgme_data_release_and_get_mem (json_stdout, &response_size);
+
+  /* Only the acknowledgement and an error are expected.  */
+  for (off = 0; !rc && off + sizeof n <= response_size; off += n)
+    {
+      memcpy (&n, response + off, sizeof n);
+      off += sizeof n;
+      if (off + n > response_size)
+        break;
+      buffer = malloc (n + 1);
+      test (buffer);
+      memcpy (buffer, response + off, n);
+      buffer[n] = 0;
+      json = cJSON_Parse (buffer, NULL);
+      j_tmp = json? cJSON_GetObjectItem (json, "type") : NULL;
+      if (j_tmp && cjson_is_string (j_tmp)
+          && !strcmp (j_tmp->valuestring, "error"))
+        nerrors++;
+      else if (!j_tmp || !cjson_is_string (j_tmp)
+               || strcmp (j_tmp->valuestring, "putdata"))
+        {
+          fprintf (stderr, "Unexpected response: %s\n", buffer);
+          rc = 1;
+        }
+      cJSON_Delete (json);
+      free (buffer);
+    }
+  if (!rc && nerrors != 1)
+    {
+      fprintf (stderr, "Got %d errors instead of 1\n", nerrors);
+      rc = 1;
+    }
+
+  if (!rc)
+    {
+      printf (" success\n");
+      gpgme_data_release (json_stderr);
+    }
+  else
+    {
+      buffer = gpgme_data_release_and_get_mem (json_stderr, &response_size);
+      printf (" failed\n");
+      if (response_size)
+        printf ("gpgme-json stderr:\n%.*s\n", (int)response_size, buffer);
+      free (buffer);
+    }
+
+  free (response);
+  gpgme_data_release (json_stdin);
+  gpgme_release (ctx);
+
+  return rc;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -503,5 +964,11 @@ main (int argc, char *argv[])
           exit(1);
         }
     }
+  if (run_concurrent_test (gpgme_json))
+    exit (1);
+  if (run_stream_test (gpgme_json))
+    exit (1);
+  if (run_stream_abort_test (gpgme_json))
+    exit (1);
   return 0;
 }
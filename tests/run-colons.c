@@ -0,0 +1,221 @@
+/* run-colons.c  - Helper to measure the speed of the colon parser
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This is not a unit test but a tool to measure how many lines of
+ * recorded "gpg --with-colons" output the keylist parser of gpgme
+ * processes per second.  To replay the recording this program
+ * registers itself as the OpenPGP engine; when started by gpgme it
+ * only prints a version line or the recorded listing.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#include <gpgme.h>
+
+#define PGM "run-colons"
+
+#include "run-support.h"
+
+/* The environment variable used to pass the recording to the engine
+ * process.  */
+#define COLONS_ENVVAR "GPGME_RUN_COLONS_FILE"
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options] FILE\n\n"
+         "Replay the output of \"gpg --with-colons --list-sigs\" recorded\n"
+         "in FILE through the keylist parser and print the throughput.\n\n"
+         "Options:\n"
+         "  --count N        list N times (default: 5)\n"
+         "  --sigs           list in the sigs keylist mode\n"
+         , stderr);
+  exit (ex);
+}
+
+
+static double
+now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+/* Act as a gpg which only knows --version and the key listing
+ * commands.  Returns only if ARGV is not such an invocation.  */
+static void
+fake_engine (int argc, char **argv)
+{
+  const char *fname = getenv (COLONS_ENVVAR);
+  FILE *fp;
+  char buffer[65536];
+  size_t n;
+  int i;
+
+  if (!fname)
+    return;
+  for (i = 1; i < argc; i++)
+    {
+      if (!strcmp (argv[i], "--version"))
+        {
+          puts ("gpg (GnuPG) 2.2.20");
+          exit (0);
+        }
+      if (!strcmp (argv[i], "--list-keys")
+          || !strcmp (argv[i], "--list-sigs")
+          || !strcmp (argv[i], "--check-sigs"))
+        {
+          fp = fopen (fname, "rb");
+          if (!fp)
+            exit (2);
+          while ((n = fread (buffer, 1, sizeof buffer, fp)))
+            fwrite (buffer, 1, n, stdout);
+          fclose (fp);
+          exit (0);
+        }
+    }
+  exit (2);
+}
+
+
+static unsigned long
+count_lines (const char *fname)
+{
+  FILE *fp;
+  unsigned long lines = 0;
+  int c;
+
+  fp = fopen (fname, "rb");
+  if (!fp)
+    {
+      fprintf (stderr, PGM ": can't open '%s'\n", fname);
+      exit (1);
+    }
+  while ((c = getc (fp)) != EOF)
+    if (c == '\n')
+      lines++;
+  fclose (fp);
+  return lines;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  gpgme_error_t err;
+  gpgme_ctx_t ctx;
+  gpgme_key_t key;
+  char self[PATH_MAX];
+  unsigned long count = 5;
+  unsigned long lines, nkeys, n;
+  int sigs = 0;
+  double start, elapsed, best = 0;
+
+  fake_engine (argc, argv);
+  if (!realpath (argv[0], self))
+    {
+      fprintf (stderr, PGM ": can't locate myself\n");
+      exit (1);
+    }
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--count"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          count = strtoul (*argv, NULL, 0);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--sigs"))
+        {
+          sigs = 1;
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+
+  if (argc != 1 || !count)
+    show_usage (1);
+
+  lines = count_lines (*argv);
+  setenv (COLONS_ENVVAR, *argv, 1);
+
+  gpgme_check_version (NULL);
+  err = gpgme_set_engine_info (GPGME_PROTOCOL_OpenPGP, self, NULL);
+  fail_if_err (err);
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+  if (sigs)
+    {
+      err = gpgme_set_keylist_mode (ctx, (GPGME_KEYLIST_MODE_LOCAL
+                                          | GPGME_KEYLIST_MODE_SIGS));
+      fail_if_err (err);
+    }
+
+  for (n = 0; n < count; n++)
+    {
+      nkeys = 0;
+      start = now ();
+      err = gpgme_op_keylist_start (ctx, NULL, 0);
+      fail_if_err (err);
+      while (!(err = gpgme_op_keylist_next (ctx, &key)))
+        {
+          nkeys++;
+          gpgme_key_unref (key);
+        }
+      if (gpgme_err_code (err) != GPG_ERR_EOF)
+        fail_if_err (err);
+      elapsed = now () - start;
+      if (!n || elapsed < best)
+        best = elapsed;
+    }
+
+  printf ("lines=%lu keys=%lu best=%.3fs lines/s=%.0f\n",
+          lines, nkeys, best, lines / best);
+
+  gpgme_release (ctx);
+  return 0;
+}
@@ -0,0 +1,258 @@
+/* run-linebuf.c  - Benchmark for the line splitter of the gpg engine
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <gpgme.h>
+#include "linebuf.h"
+
+#define PGM "run-linebuf"
+
+
+static int verbose;
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options] FILE\n\n"
+         "Feed FILE, for example the output of gpg --with-colons\n"
+         "--list-keys, through the line splitter used for the status\n"
+         "and colon lines of gpg and print the throughput.\n\n"
+         "Options:\n"
+         "  --verbose        run in verbose mode\n"
+         "  --repeat N       feed FILE N times (default: 10)\n"
+         "  --chunk N        read at most N bytes at once (default: 4096)\n"
+         "  --old            use the previous memmove based splitter\n"
+         , stderr);
+  exit (ex);
+}
+
+
+static double
+now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+/* Count the lines in DATA of size DATALEN which are read in chunks
+   of up to CHUNK bytes using the line buffer.  */
+static unsigned long
+split_linebuf (const char *data, size_t datalen, size_t chunk)
+{
+  struct linebuf_s lb;
+  unsigned long count = 0;
+  char *buffer;
+  size_t len;
+
+  if (_gpgme_linebuf_init (&lb, 4096))
+    exit (1);
+  while (datalen)
+    {
+      buffer = _gpgme_linebuf_space (&lb, &len);
+      if (!buffer)
+        exit (1);
+      if (len > chunk)
+        len = chunk;
+      if (len > datalen)
+        len = datalen;
+      memcpy (buffer, data, len);
+      data += len;
+      datalen -= len;
+      _gpgme_linebuf_commit (&lb, len);
+
+      while ((buffer = _gpgme_linebuf_getline (&lb, NULL)))
+        if (*buffer && strchr (buffer, ':'))
+          count++;
+    }
+  _gpgme_linebuf_release (&lb);
+  return count;
+}
+
+
+/* The same using the algorithm formerly used by read_colon_line.  */
+static unsigned long
+split_old (const char *data, size_t datalen, size_t chunk)
+{
+  unsigned long count = 0;
+  size_t bufsize = 1024;
+  char *buffer = malloc (bufsize);
+  size_t readpos = 0;
+  size_t len;
+  char *p;
+  int nread;
+
+  if (!buffer)
+    exit (1);
+  while (datalen)
+    {
+      if (bufsize - readpos < 256)
+        {
+          bufsize += 1024;
+          buffer = realloc (buffer, bufsize);
+          if (!buffer)
+            exit (1);
+        }
+      len = bufsize - readpos;
+      if (len > chunk)
+        len = chunk;
+      if (len > datalen)
+        len = datalen;
+      memcpy (buffer + readpos, data, len);
+      data += len;
+      datalen -= len;
+
+      nread = len;
+      while (nread > 0)
+        {
+          for (p = buffer + readpos; nread; nread--, p++)
+            {
+              if (*p == '\n')
+                {
+                  *p = 0;
+                  if (*buffer && strchr (buffer, ':'))
+                    count++;
+                  nread--; p++;
+                  if (nread)
+                    memmove (buffer, p, nread);
+                  readpos = 0;
+                  break;
+                }
+              else
+                readpos++;
+            }
+        }
+    }
+  free (buffer);
+  return count;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  unsigned long repeat = 10;
+  size_t chunk = 4096;
+  int use_old = 0;
+  FILE *fp;
+  char *data;
+  size_t datalen, datasize;
+  unsigned long n, lines = 0;
+  double start, elapsed;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--verbose"))
+        {
+          verbose = 1;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--repeat"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          repeat = strtoul (*argv, NULL, 0);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--chunk"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          chunk = strtoul (*argv, NULL, 0);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--old"))
+        {
+          use_old = 1;
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+
+  if (argc != 1 || !chunk)
+    show_usage (1);
+
+  fp = fopen (*argv, "rb");
+  if (!fp)
+    {
+      fprintf (stderr, PGM ": can't open '%s'\n", *argv);
+      exit (1);
+    }
+  datalen = 0;
+  datasize = 65536;
+  data = malloc (datasize);
+  while (data)
+    {
+      datalen += fread (data + datalen, 1, datasize - datalen, fp);
+      if (datalen < datasize)
+        break;
+      datasize *= 2;
+      data = realloc (data, datasize);
+    }
+  if (!data || ferror (fp))
+    {
+      fprintf (stderr, PGM ": error reading '%s'\n", *argv);
+      exit (1);
+    }
+  fclose (fp);
+
+  start = now ();
+  for (n = 0; n < repeat; n++)
+    lines += (use_old? split_old : split_linebuf) (data, datalen, chunk);
+  elapsed = now () - start;
+
+  if (verbose)
+    fprintf (stderr, PGM ": %lu colon lines per pass\n", lines / repeat);
+  printf ("%s: bytes=%lu lines=%lu time=%.3fs throughput=%.1f MiB/s\n",
+          use_old? "old" : "linebuf",
+          (unsigned long)datalen * repeat, lines, elapsed,
+          elapsed > 0? datalen * repeat / elapsed / (1024 * 1024) : 0.0);
+
+  free (data);
+  return 0;
+}
@@ -0,0 +1,176 @@
+/* run-parse-status.c  - Benchmark for the status keyword lookup
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <gpgme.h>
+
+#define PGM "run-parse-status"
+
+#define DIM(v) (sizeof(v)/sizeof((v)[0]))
+
+/* Internal functions from src/status-table.c.  */
+gpgme_status_code_t _gpgme_parse_status (const char *name);
+const char *_gpgme_status_to_string (gpgme_status_code_t code);
+
+
+/* The keywords of a typical verify operation plus an unknown one.  */
+static const char *sample[] =
+  {
+    "NEWSIG", "KEY_CONSIDERED", "SIG_ID", "KEY_CONSIDERED", "GOODSIG",
+    "VALIDSIG", "TRUST_UNDEFINED", "PLAINTEXT", "PLAINTEXT_LENGTH",
+    "DECRYPTION_INFO", "DECRYPTION_OKAY", "GOODMDC", "END_DECRYPTION",
+    "PROGRESS", "PROGRESS", "NOTATION_NAME", "NOTATION_DATA",
+    "VERIFICATION_COMPLIANCE_MODE", "NO_SUCH_KEYWORD"
+  };
+
+
+/* A sorted copy of the keyword table for the old lookup.  */
+struct entry_s
+{
+  const char *name;
+  gpgme_status_code_t code;
+};
+static struct entry_s *table;
+static size_t tablelen;
+
+
+static int
+entry_cmp (const void *ap, const void *bp)
+{
+  const struct entry_s *a = ap;
+  const struct entry_s *b = bp;
+
+  return strcmp (a->name, b->name);
+}
+
+
+/* The former implementation of _gpgme_parse_status.  */
+static gpgme_status_code_t
+parse_status_bsearch (const char *name)
+{
+  struct entry_s t, *r;
+
+  t.name = name;
+  r = bsearch (&t, table, tablelen, sizeof t, entry_cmp);
+  return r ? r->code : -1;
+}
+
+
+static void
+build_table (void)
+{
+  gpgme_status_code_t code;
+  const char *name;
+
+  table = calloc (500, sizeof *table);
+  if (!table)
+    exit (1);
+  for (code = 1; code < 500; code++)
+    {
+      name = _gpgme_status_to_string (code);
+      if (!strcmp (name, "status_code_lost"))
+        continue;
+      table[tablelen].name = name;
+      table[tablelen].code = code;
+      tablelen++;
+    }
+  qsort (table, tablelen, sizeof *table, entry_cmp);
+}
+
+
+static double
+now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static double
+run (gpgme_status_code_t (*parse) (const char *), unsigned long count,
+     unsigned long *r_check)
+{
+  unsigned long n, check = 0;
+  double start;
+  int i;
+
+  start = now ();
+  for (n = 0; n < count; n++)
+    for (i = 0; i < DIM (sample); i++)
+      check += parse (sample[i]);
+  *r_check = check;
+  return now () - start;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  unsigned long count = 1000000;
+  unsigned long check_old, check_new;
+  double t_old, t_new;
+  size_t i;
+
+  if (argc > 1)
+    count = strtoul (argv[1], NULL, 0);
+  if (!count)
+    {
+      fputs ("usage: " PGM " [COUNT]\n", stderr);
+      exit (1);
+    }
+
+  build_table ();
+
+  /* Both lookups must agree on all keywords.  */
+  for (i = 0; i < tablelen; i++)
+    if (_gpgme_parse_status (table[i].name) != table[i].code)
+      {
+        fprintf (stderr, PGM ": lookup of %s failed\n", table[i].name);
+        exit (1);
+      }
+
+  t_old = run (parse_status_bsearch, count, &check_old);
+  t_new = run (_gpgme_parse_status, count, &check_new);
+  if (check_old != check_new)
+    {
+      fprintf (stderr, PGM ": lookups differ\n");
+      exit (1);
+    }
+
+  printf ("keywords=%u lookups=%lu bsearch=%.1fns new=%.1fns per lookup\n",
+          (unsigned int)tablelen, count * DIM (sample),
+          t_old * 1e9 / (count * DIM (sample)),
+          t_new * 1e9 / (count * DIM (sample)));
+
+  free (table);
+  return 0;
+}
@@ -0,0 +1,390 @@
+/* run-recipients.c  - Helper to measure the cost of many recipients
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This is not a unit test but a tool to measure how long it takes to
+ * hand a large number of recipients to the CMS engine.  To leave out
+ * the actual crypto this program registers itself as gpgsm; when
+ * started by gpgme it acts as a stub Assuan server which accepts all
+ * commands, lists made up certificates and rejects the recipients
+ * whose number is a multiple of the --reject value with an INV_RECP
+ * status and a NO_PUBKEY error.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/time.h>
+
+#include <gpgme.h>
+
+#define PGM "run-recipients"
+
+#include "run-support.h"
+
+/* The environment variable used to tell the engine process that it
+ * shall act as a stub and which recipients to reject.  */
+#define STUB_ENVVAR "GPGME_RUN_RECIPIENTS_REJECT"
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options]\n\n"
+         "Encrypt to many recipients using a stub gpgsm and print the\n"
+         "time taken per operation.\n\n"
+         "Options:\n"
+         "  --recipients N   use N recipients (default: 200)\n"
+         "  --count N        encrypt N times (default: 20)\n"
+         "  --reject N       let the stub reject every Nth recipient\n"
+         "  --string         pass the recipients as a string\n"
+         , stderr);
+  exit (ex);
+}
+
+
+static double
+now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static void
+stub_write (int fd, const char *buffer)
+{
+  size_t n = strlen (buffer);
+  ssize_t nwritten;
+
+  while (n)
+    {
+      nwritten = write (fd, buffer, n);
+      if (nwritten < 0 && errno == EINTR)
+        continue;
+      if (nwritten <= 0)
+        exit (2);
+      buffer += nwritten;
+      n -= nwritten;
+    }
+}
+
+
+/* Return the number of the made up recipient NAME, which is either a
+ * fingerprint as listed by the stub or of the form "stub-N".  */
+static unsigned long
+recipient_number (const char *name)
+{
+  if (!strncmp (name, "stub-", 5))
+    return strtoul (name + 5, NULL, 10);
+  return strtoul (name, NULL, 16);
+}
+
+
+/* Process one command LINE of the stub server and write the response
+ * to FD.  */
+static void
+stub_command (int fd, char *line, unsigned long reject)
+{
+  char buffer[1024];
+  unsigned long n, i;
+
+  if (!strncmp (line, "RECIPIENT ", 10))
+    {
+      if (reject && !(recipient_number (line + 10) % reject))
+        {
+          snprintf (buffer, sizeof buffer,
+                    "S INV_RECP 0 %s\nERR %u No public key\n", line + 10,
+                    gpgme_err_make (GPG_ERR_SOURCE_GPGSM, GPG_ERR_NO_PUBKEY));
+          stub_write (fd, buffer);
+        }
+      else
+        stub_write (fd, "OK\n");
+    }
+  else if (!strncmp (line, "LISTKEYS ", 9))
+    {
+      /* The pattern is the number of certificates to list.  */
+      n = strtoul (line + 9, NULL, 10);
+      for (i = 1; i <= n; i++)
+        {
+          snprintf (buffer, sizeof buffer,
+                    "D crt:u:2048:1:%016lX:1577836800:::::::esc:::::%%0A\n"
+                    "D fpr:::::::::%040lX:%%0A\n"
+                    "D uid:u::::::::CN=stub-%lu:%%0A\n"
+                    , i, i, i);
+          stub_write (fd, buffer);
+        }
+      stub_write (fd, "OK\n");
+    }
+  else if (!strncmp (line, "OPTION list-to-output", 21))
+    {
+      /* The stub only sends listings as D lines.  */
+      snprintf (buffer, sizeof buffer, "ERR %u Unknown option\n",
+                gpgme_err_make (GPG_ERR_SOURCE_GPGSM,
+                                GPG_ERR_UNKNOWN_OPTION));
+      stub_write (fd, buffer);
+    }
+  else if (!strcmp (line, "BYE"))
+    {
+      stub_write (fd, "OK closing connection\n");
+      exit (0);
+    }
+  else
+    stub_write (fd, "OK\n");
+}
+
+
+/* Act as a gpgsm which only knows --version and the server mode.
+ * Returns only if this is not the engine process.  */
+static void
+fake_engine (int argc, char **argv)
+{
+  const char *s = getenv (STUB_ENVVAR);
+  unsigned long reject;
+  char buffer[65536];
+  size_t buflen = 0;
+  ssize_t nread;
+  char *p, *line;
+  int infd = 0;
+  int outfd = 1;
+  int i;
+
+  if (!s)
+    return;
+  reject = strtoul (s, NULL, 10);
+  for (i = 1; i < argc; i++)
+    if (!strcmp (argv[i], "--version"))
+      {
+        puts ("gpgsm (GnuPG) 2.2.20");
+        exit (0);
+      }
+    else if (!strcmp (argv[i], "--server"))
+      break;
+  if (i == argc)
+    exit (2);
+
+  /* With descriptor passing the connection is a socket.  */
+  s = getenv ("_assuan_connection_fd");
+  if (s)
+    infd = outfd = atoi (s);
+
+  stub_write (outfd, "OK Pleased to meet you\n");
+  for (;;)
+    {
+      nread = read (infd, buffer + buflen, sizeof buffer - buflen);
+      if (nread < 0 && errno == EINTR)
+        continue;
+      if (nread <= 0)
+        exit (0);
+      buflen += nread;
+
+      line = buffer;
+      while ((p = memchr (line, '\n', buffer + buflen - line)))
+        {
+          *p = 0;
+          /* Comments are for example sent along with a descriptor.  */
+          if (*line && *line != '#')
+            stub_command (outfd, line, reject);
+          line = p + 1;
+        }
+      buflen -= line - buffer;
+      memmove (buffer, line, buflen);
+      if (buflen == sizeof buffer)
+        exit (2);
+    }
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  gpgme_error_t err;
+  gpgme_ctx_t ctx;
+  gpgme_key_t *keys;
+  gpgme_data_t in, out;
+  gpgme_encrypt_result_t result;
+  gpgme_invalid_key_t invkey;
+  char self[PATH_MAX];
+  char pattern[32];
+  char *recpstring, *p;
+  unsigned long nrecp = 200;
+  unsigned long count = 20;
+  unsigned long reject = 0;
+  unsigned long ninvalid, n, i;
+  int use_string = 0;
+  double start, elapsed, best = 0;
+
+  fake_engine (argc, argv);
+  if (!realpath (argv[0], self))
+    {
+      fprintf (stderr, PGM ": can't locate myself\n");
+      exit (1);
+    }
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--recipients"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          nrecp = strtoul (*argv, NULL, 0);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--count"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          count = strtoul (*argv, NULL, 0);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--reject"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          reject = strtoul (*argv, NULL, 0);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--string"))
+        {
+          use_string = 1;
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+
+  if (argc || !nrecp || !count)
+    show_usage (1);
+
+  snprintf (pattern, sizeof pattern, "%lu", reject);
+  setenv (STUB_ENVVAR, pattern, 1);
+
+  gpgme_check_version (NULL);
+  err = gpgme_set_engine_info (GPGME_PROTOCOL_CMS, self, NULL);
+  fail_if_err (err);
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+  err = gpgme_set_protocol (ctx, GPGME_PROTOCOL_CMS);
+  fail_if_err (err);
+
+  /* Get the made up certificates or build the recipient string.  */
+  keys = calloc (nrecp + 1, sizeof *keys);
+  recpstring = malloc (nrecp * 32 + 1);
+  if (!keys || !recpstring)
+    {
+      fprintf (stderr, PGM ": out of core\n");
+      exit (1);
+    }
+  snprintf (pattern, sizeof pattern, "%lu", nrecp);
+  err = gpgme_op_keylist_start (ctx, pattern, 0);
+  fail_if_err (err);
+  for (i = 0; i < nrecp; i++)
+    {
+      err = gpgme_op_keylist_next (ctx, &keys[i]);
+      fail_if_err (err);
+    }
+  err = gpgme_op_keylist_end (ctx);
+  fail_if_err (err);
+  for (p = recpstring, i = 1; i <= nrecp; i++)
+    p += sprintf (p, "stub-%lu\n", i);
+
+  for (n = 0; n < count; n++)
+    {
+      err = gpgme_data_new_from_mem (&in, "Hallo Leute\n", 12, 0);
+      fail_if_err (err);
+      err = gpgme_data_new (&out);
+      fail_if_err (err);
+
+      start = now ();
+      if (use_string)
+        err = gpgme_op_encrypt_ext (ctx, NULL, recpstring, 0, in, out);
+      else
+        err = gpgme_op_encrypt (ctx, keys, 0, in, out);
+      elapsed = now () - start;
+      if (!reject)
+        fail_if_err (err);
+      else if (gpgme_err_code (err) != (use_string ? GPG_ERR_NO_PUBKEY
+                                        : GPG_ERR_UNUSABLE_PUBKEY))
+        {
+          fprintf (stderr, PGM ": unexpected error: %s\n",
+                   gpgme_strerror (err));
+          exit (1);
+        }
+
+      /* Check that all rejected recipients and only those are
+       * reported.  */
+      result = gpgme_op_encrypt_result (ctx);
+      ninvalid = 0;
+      for (invkey = result->invalid_recipients; invkey; invkey = invkey->next)
+        {
+          if (!invkey->fpr || !reject
+              || recipient_number (invkey->fpr) % reject)
+            {
+              fprintf (stderr, PGM ": wrong invalid recipient '%s'\n",
+                       invkey->fpr ? invkey->fpr : "[none]");
+              exit (1);
+            }
+          ninvalid++;
+        }
+      if (ninvalid != (reject ? nrecp / reject : 0))
+        {
+          fprintf (stderr, PGM ": %lu invalid recipients reported\n",
+                   ninvalid);
+          exit (1);
+        }
+
+      gpgme_data_release (in);
+      gpgme_data_release (out);
+      if (!n || elapsed < best)
+        best = elapsed;
+    }
+
+  printf ("recipients=%lu invalid=%lu best=%.3fms per-recipient=%.1fus\n",
+          nrecp, ninvalid, best * 1000, best * 1000000 / nrecp);
+
+  for (i = 0; i < nrecp; i++)
+    gpgme_key_unref (keys[i]);
+  free (keys);
+  free (recpstring);
+  gpgme_release (ctx);
+  return 0;
+}
@@ -0,0 +1,214 @@
+/* run-refcount.c  - Helper to measure reference counting under threads
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This is not a unit test but a tool to measure the throughput of
+ * gpgme_key_ref/gpgme_key_unref and gpgme_result_ref/gpgme_result_unref
+ * on a shared object depending on the number of threads.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include <gpgme.h>
+
+#define PGM "run-refcount"
+
+#include "run-support.h"
+
+
+static gpgme_key_t shared_key;
+static void *shared_result;
+static unsigned long count = 1000000;
+static pthread_barrier_t start_barrier;
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options] [USERID]\n\n"
+         "Take the first key matching USERID and let an increasing\n"
+         "number of threads concurrently take and release references\n"
+         "to it and to a keylist result.  Print the throughput.\n\n"
+         "Options:\n"
+         "  --threads N      use up to N threads (default: 8)\n"
+         "  --count N        do N ref/unref pairs per thread\n"
+         , stderr);
+  exit (ex);
+}
+
+
+static double
+now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static void *
+key_worker (void *arg)
+{
+  unsigned long n;
+
+  (void)arg;
+  pthread_barrier_wait (&start_barrier);
+  for (n = 0; n < count; n++)
+    {
+      gpgme_key_ref (shared_key);
+      gpgme_key_unref (shared_key);
+    }
+  return NULL;
+}
+
+
+static void *
+result_worker (void *arg)
+{
+  unsigned long n;
+
+  (void)arg;
+  pthread_barrier_wait (&start_barrier);
+  for (n = 0; n < count; n++)
+    {
+      gpgme_result_ref (shared_result);
+      gpgme_result_unref (shared_result);
+    }
+  return NULL;
+}
+
+
+/* Run NTHREADS threads of FUNC and return the elapsed time.  */
+static double
+run_threads (void *(*func) (void *), int nthreads)
+{
+  pthread_t *threads;
+  double start;
+  int i;
+
+  threads = calloc (nthreads, sizeof *threads);
+  if (!threads)
+    {
+      fprintf (stderr, PGM ": out of core\n");
+      exit (1);
+    }
+  pthread_barrier_init (&start_barrier, NULL, nthreads + 1);
+  for (i = 0; i < nthreads; i++)
+    if (pthread_create (&threads[i], NULL, func, NULL))
+      {
+        fprintf (stderr, PGM ": failed to create thread\n");
+        exit (1);
+      }
+  start = now ();
+  pthread_barrier_wait (&start_barrier);
+  for (i = 0; i < nthreads; i++)
+    pthread_join (threads[i], NULL);
+  start = now () - start;
+  pthread_barrier_destroy (&start_barrier);
+  free (threads);
+  return start;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  gpgme_error_t err;
+  gpgme_ctx_t ctx;
+  gpgme_key_t key;
+  const char *pattern = NULL;
+  int max_threads = 8;
+  int nthreads;
+  double key_time, result_time;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--threads"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          max_threads = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--count"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          count = strtoul (*argv, NULL, 0);
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+
+  if (argc > 1 || max_threads < 1 || !count)
+    show_usage (1);
+  if (argc)
+    pattern = *argv;
+
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+  err = gpgme_op_keylist_start (ctx, pattern, 0);
+  fail_if_err (err);
+  err = gpgme_op_keylist_next (ctx, &shared_key);
+  fail_if_err (err);
+  while (!gpgme_op_keylist_next (ctx, &key))
+    gpgme_key_unref (key);
+  shared_result = gpgme_op_keylist_result (ctx);
+  gpgme_result_ref (shared_result);
+  gpgme_release (ctx);
+
+  printf ("threads  key-ref/unref     result-ref/unref\n");
+  for (nthreads = 1; nthreads <= max_threads; nthreads *= 2)
+    {
+      key_time = run_threads (key_worker, nthreads);
+      result_time = run_threads (result_worker, nthreads);
+      printf ("%7d  %8.2f Mops/s     %8.2f Mops/s\n", nthreads,
+              nthreads * count / key_time / 1000000.0,
+              nthreads * count / result_time / 1000000.0);
+    }
+
+  gpgme_result_unref (shared_result);
+  gpgme_key_unref (shared_key);
+  return 0;
+}
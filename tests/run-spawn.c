@@ -0,0 +1,166 @@
+/* run-spawn.c  - Helper to measure the process spawn latency
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include <gpgme.h>
+
+#define PGM "run-spawn"
+
+#include "run-support.h"
+
+
+static int verbose;
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options] [PROGRAM [ARGS]]\n\n"
+         "Spawn PROGRAM (default: /bin/true) repeatedly via the spawn\n"
+         "engine and print the average latency.  Use --rss with several\n"
+         "sizes to see how the latency depends on the size of the\n"
+         "calling process.\n\n"
+         "Options:\n"
+         "  --verbose        run in verbose mode\n"
+         "  --count N        spawn N times (default: 100)\n"
+         "  --rss MIB        allocate and touch MIB MiB of memory first\n"
+         , stderr);
+  exit (ex);
+}
+
+
+static double
+now (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  gpgme_error_t err;
+  gpgme_ctx_t ctx;
+  const char *default_argv[] = { "true", NULL };
+  const char *pgm = "/bin/true";
+  const char **pgm_argv = default_argv;
+  unsigned long count = 100;
+  unsigned long rss_mib = 0;
+  unsigned long n;
+  char *ballast = NULL;
+  double start, elapsed;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--verbose"))
+        {
+          verbose = 1;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--count"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          count = strtoul (*argv, NULL, 0);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--rss"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          rss_mib = strtoul (*argv, NULL, 0);
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+
+  if (argc)
+    {
+      pgm = argv[0];
+      pgm_argv = (const char **)argv;
+    }
+  if (!count)
+    show_usage (1);
+
+  if (rss_mib)
+    {
+      /* Touch every page so that it is actually mapped.  */
+      ballast = malloc (rss_mib * 1024 * 1024);
+      if (!ballast)
+        {
+          fprintf (stderr, PGM ": error allocating %lu MiB\n", rss_mib);
+          exit (1);
+        }
+      memset (ballast, 0x55, rss_mib * 1024 * 1024);
+    }
+
+  init_gpgme (GPGME_PROTOCOL_SPAWN);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+  err = gpgme_set_protocol (ctx, GPGME_PROTOCOL_SPAWN);
+  fail_if_err (err);
+
+  start = now ();
+  for (n = 0; n < count; n++)
+    {
+      err = gpgme_op_spawn (ctx, pgm, pgm_argv, NULL, NULL, NULL, 0);
+      fail_if_err (err);
+      if (verbose)
+        fprintf (stderr, PGM ": spawned %s (%lu)\n", pgm, n);
+    }
+  elapsed = now () - start;
+
+  printf ("rss=%luMiB count=%lu total=%.3fs per-spawn=%.1fus\n",
+          rss_mib, count, elapsed, elapsed * 1000000.0 / count);
+
+  gpgme_release (ctx);
+  free (ballast);
+  return 0;
+}
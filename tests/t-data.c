@@ -54,6 +54,8 @@ typedef enum
     TEST_INOUT_MEM_FROM_FILE_PART_BY_NAME,
     TEST_INOUT_MEM_FROM_INEXISTANT_FILE_PART,
     TEST_INOUT_MEM_FROM_FILE_PART_BY_FP,
+    TEST_IN_MMAP_FROM_FILE,
+    TEST_IN_MMAP_FROM_INEXISTANT_FILE,
     TEST_END
   } round_t;
 
@@ -254,6 +256,18 @@ main (void)
 						strlen (text), strlen (text));
 	  }
 	  break;
+	case TEST_IN_MMAP_FROM_FILE:
+	  err = gpgme_data_new_from_mmap (&data, text_filename);
+	  break;
+	case TEST_IN_MMAP_FROM_INEXISTANT_FILE:
+	  err = gpgme_data_new_from_mmap (&data, missing_filename);
+	  if (!err)
+	    {
+	      fprintf (stderr, "%s:%d: gpgme_data_new_from_mmap on inexistant "
+		       "file succeeded unexpectedly\n", __FILE__, __LINE__);
+	      exit (1);
+	    }
+	  continue;
 	case TEST_END:
 	  goto out;
 	case TEST_INITIALIZER:
@@ -264,7 +278,18 @@ main (void)
       fail_if_err (err);
 
       read_test (round, data);
-      write_test (round, data);
+      if (round == TEST_IN_MMAP_FROM_FILE)
+	{
+	  /* Mapped files are read-only.  */
+	  if (gpgme_data_write (data, text, strlen (text)) != -1)
+	    {
+	      fprintf (stderr, "%s:%d: (%i) gpgme_data_write succeeded "
+		       "unexpectedly\n", __FILE__, __LINE__, round);
+	      exit (1);
+	    }
+	}
+      else
+	write_test (round, data);
       gpgme_data_release (data);
     }
  out: